@@ -0,0 +1,73 @@
+#include <iostream>
+#include <sstream>
+#include <cmath>
+#include <future>
+#include <vector>
+#include "benchmark_common.h"
+
+//request handler's own work before inference(decode, resize, normalize), a few passes over the image
+static void preprocess(std::shared_ptr<EasyCNN::DataBucket> image, const size_t passes)
+{
+	float* data = image->getData().get();
+	const size_t size = image->getSize().totalSize();
+	for (size_t pass = 0; pass < passes; pass++)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			data[i] = std::sqrt(data[i] * data[i] + 0.25f) - 0.5f;
+		}
+	}
+}
+
+//handler which preprocesses a request then infers it : testBatch one after another,
+//vs submit and preprocess the next request while network runs
+void async_benchmark()
+{
+	std::cout << "==== async ====" << std::endl;
+	const size_t batches[] = { 1, 8 };
+	const size_t requests = 200;
+	EasyCNN::set_thread_num(2);
+	for (const size_t batch : batches)
+	{
+		EasyCNN::NetWork network;
+		benchmark_build_mnist_net(network, batch);
+		network.finalize();
+		network.setMaxPending(4);
+		//two images : one is preprocessed while the other is inferred
+		std::shared_ptr<EasyCNN::DataBucket> images[2];
+		for (auto& image : images)
+		{
+			image = std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 1, 28, 28));
+			benchmark_fill_random(image);
+		}
+		const size_t passes = 64;
+
+		const double syncMs = benchmark_run(0, 1, [&](){
+			for (size_t i = 0; i < requests; i++)
+			{
+				preprocess(images[0], passes);
+				network.testBatch(images[0]);
+			}
+		});
+		const double asyncMs = benchmark_run(0, 1, [&](){
+			std::future<std::shared_ptr<EasyCNN::DataBucket>> inflight;
+			for (size_t i = 0; i < requests; i++)
+			{
+				preprocess(images[i % 2], passes);
+				//one request in flight, its image is reused by the request after next
+				if (inflight.valid())
+				{
+					inflight.get();
+				}
+				inflight = network.submit(images[i % 2]);
+			}
+			inflight.get();
+		});
+
+		std::stringstream ss;
+		ss << "batch " << batch << ", per request";
+		benchmark_report("preprocess + testBatch, " + ss.str(), syncMs / requests);
+		benchmark_report("preprocess + submit, " + ss.str(), asyncMs / requests);
+	}
+	EasyCNN::set_thread_num(1);
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <future>
+#include "benchmark_common.h"
+
+static const char* parallel_backend_name(const EasyCNN::ParallelBackend backend)
+{
+	switch (backend)
+	{
+	case EasyCNN::ParallelBackend::OpenMP:
+		return "openmp";
+	case EasyCNN::ParallelBackend::Serial:
+		return "serial";
+	case EasyCNN::ParallelBackend::Custom:
+		return "custom(queue pool)";
+	default:
+		return "native";
+	}
+}
+
+//executor of an embedding application : its own queue pool takes ranges, caller takes the first one
+static void queue_pool_executor(const size_t begin, const size_t end, const size_t grain, EasyCNN::TaskFunc func, void* context)
+{
+	EasyCNN::ThreadPool& pool = EasyCNN::ThreadPool::instance();
+	std::vector<std::future<void>> futures;
+	for (size_t start = begin + grain; start < end; start += grain)
+	{
+		futures.push_back(pool.enqueue(func, context, start, std::min(end, start + grain)));
+	}
+	func(context, begin, std::min(end, begin + grain));
+	for (auto& future : futures)
+	{
+		future.wait();
+	}
+}
+
+//mnist network on every backend with the same number of threads
+void backend_benchmark()
+{
+	std::cout << "==== parallel backend ====" << std::endl;
+	const EasyCNN::ParallelBackend backends[] = { EasyCNN::ParallelBackend::Native, EasyCNN::ParallelBackend::OpenMP,
+		EasyCNN::ParallelBackend::Serial, EasyCNN::ParallelBackend::Custom };
+	const size_t threads = 4;
+	const size_t batches[] = { 1, 64 };
+	EasyCNN::set_thread_num(threads);
+	EasyCNN::ThreadPool::instance().resize(threads - 1);
+	for (const EasyCNN::ParallelBackend backend : backends)
+	{
+		if (backend == EasyCNN::ParallelBackend::Custom)
+		{
+			EasyCNN::set_parallel_executor(queue_pool_executor, threads);
+		}
+		else if (!EasyCNN::set_parallel_backend(backend))
+		{
+			std::cout << parallel_backend_name(backend) << " is not compiled in" << std::endl;
+			continue;
+		}
+		for (const size_t batch : batches)
+		{
+			EasyCNN::NetWork network;
+			benchmark_build_mnist_net(network, batch);
+			std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 1, 28, 28)));
+			std::shared_ptr<EasyCNN::DataBucket> label(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 10, 1, 1)));
+			benchmark_fill_random(input);
+			benchmark_fill_label(label);
+			const double trainMs = benchmark_run(2, 10, [&](){ network.trainBatch(input, label); });
+			network.finalize();
+			const double testMs = benchmark_run(2, 20, [&](){ network.testBatch(input); });
+
+			std::stringstream ss;
+			ss << ", batch " << batch << ", " << parallel_backend_name(backend);
+			benchmark_report("mnist train" + ss.str(), trainMs);
+			benchmark_report("mnist test" + ss.str(), testMs);
+		}
+	}
+	EasyCNN::set_parallel_backend(EasyCNN::ParallelBackend::Native);
+	EasyCNN::ThreadPool::instance().resize(1);
+}
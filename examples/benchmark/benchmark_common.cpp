@@ -0,0 +1,91 @@
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include "benchmark_common.h"
+
+double benchmark_now_ms()
+{
+	const auto now = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(now.time_since_epoch()).count();
+}
+double benchmark_run(const size_t warmup, const size_t iterations, const std::function<void()>& func)
+{
+	for (size_t i = 0; i < warmup; i++)
+	{
+		func();
+	}
+	const double start = benchmark_now_ms();
+	for (size_t i = 0; i < iterations; i++)
+	{
+		func();
+	}
+	const double stop = benchmark_now_ms();
+	return (stop - start) / (double)(iterations > 0 ? iterations : 1);
+}
+void benchmark_fill_random(std::shared_ptr<EasyCNN::DataBucket> bucket)
+{
+	static std::mt19937 engine(1234);
+	std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+	float* data = bucket->getData().get();
+	for (size_t i = 0; i < bucket->getSize().totalSize(); i++)
+	{
+		data[i] = distribution(engine);
+	}
+}
+void benchmark_fill_label(std::shared_ptr<EasyCNN::DataBucket> bucket)
+{
+	const EasyCNN::DataSize size = bucket->getSize();
+	bucket->fillData(0.0f);
+	float* data = bucket->getData().get();
+	for (size_t n = 0; n < size.number; n++)
+	{
+		data[n*size._3DSize() + n % size._3DSize()] = 1.0f;
+	}
+}
+void benchmark_build_mnist_net(EasyCNN::NetWork& network, const size_t batch)
+{
+	const size_t classes = 10;
+	network.setInputSize(EasyCNN::DataSize(batch, 1, 28, 28));
+	network.addayer(std::make_shared<EasyCNN::InputLayer>());
+	//convolution layer
+	std::shared_ptr<EasyCNN::ConvolutionLayer> conv1(std::make_shared<EasyCNN::ConvolutionLayer>());
+	conv1->setParamaters(EasyCNN::ParamSize(6, 1, 3, 3), 1, 1, true, EasyCNN::ConvolutionLayer::SAME);
+	network.addayer(conv1);
+	network.addayer(std::make_shared<EasyCNN::ReluLayer>());
+	//pooling layer
+	std::shared_ptr<EasyCNN::PoolingLayer> pool1(std::make_shared<EasyCNN::PoolingLayer>());
+	pool1->setParamaters(EasyCNN::PoolingLayer::PoolingType::MaxPooling, EasyCNN::ParamSize(1, 6, 2, 2), 2, 2, EasyCNN::PoolingLayer::SAME);
+	network.addayer(pool1);
+	//convolution layer
+	std::shared_ptr<EasyCNN::ConvolutionLayer> conv2(std::make_shared<EasyCNN::ConvolutionLayer>());
+	conv2->setParamaters(EasyCNN::ParamSize(12, 6, 3, 3), 1, 1, true, EasyCNN::ConvolutionLayer::SAME);
+	network.addayer(conv2);
+	network.addayer(std::make_shared<EasyCNN::ReluLayer>());
+	//pooling layer
+	std::shared_ptr<EasyCNN::PoolingLayer> pool2(std::make_shared<EasyCNN::PoolingLayer>());
+	pool2->setParamaters(EasyCNN::PoolingLayer::PoolingType::MaxPooling, EasyCNN::ParamSize(1, 12, 2, 2), 2, 2, EasyCNN::PoolingLayer::SAME);
+	network.addayer(pool2);
+	//full connect layer
+	std::shared_ptr<EasyCNN::FullconnectLayer> fc1(std::make_shared<EasyCNN::FullconnectLayer>());
+	fc1->setParamaters(EasyCNN::ParamSize(1, 512, 1, 1), true);
+	network.addayer(fc1);
+	network.addayer(std::make_shared<EasyCNN::ReluLayer>());
+	//full connect layer
+	std::shared_ptr<EasyCNN::FullconnectLayer> fc2(std::make_shared<EasyCNN::FullconnectLayer>());
+	fc2->setParamaters(EasyCNN::ParamSize(1, classes, 1, 1), true);
+	network.addayer(fc2);
+	//soft max layer
+	network.addayer(std::make_shared<EasyCNN::SoftmaxLayer>());
+	network.setLossFunctor(std::make_shared<EasyCNN::CrossEntropyFunctor>());
+	network.setOptimizer(std::make_shared<EasyCNN::SGD>(0.01f));
+}
+void benchmark_report(const std::string& name, const double ms, const std::string& extra)
+{
+	std::cout << std::left << std::setw(48) << name << std::right << std::setw(12) << std::fixed << std::setprecision(3) << ms << " ms";
+	if (!extra.empty())
+	{
+		std::cout << "    " << extra;
+	}
+	std::cout << std::endl;
+}
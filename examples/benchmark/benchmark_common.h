@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include <functional>
+#include <memory>
+#include "EasyCNN/EasyCNN.h"
+
+//wall clock in milliseconds
+double benchmark_now_ms();
+//run func warmup+iterations times, return average milliseconds of one iteration
+double benchmark_run(const size_t warmup, const size_t iterations, const std::function<void()>& func);
+//fill bucket with uniform random value in [0,1)
+void benchmark_fill_random(std::shared_ptr<EasyCNN::DataBucket> bucket);
+//one-hot label for every sample
+void benchmark_fill_label(std::shared_ptr<EasyCNN::DataBucket> bucket);
+//same topology as mnist example convnet, input is 1x28x28, output is 10 classes
+void benchmark_build_mnist_net(EasyCNN::NetWork& network, const size_t batch);
+void benchmark_report(const std::string& name, const double ms, const std::string& extra = "");
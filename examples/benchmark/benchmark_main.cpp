@@ -0,0 +1,72 @@
+#include <iostream>
+#include <string>
+#include "benchmark_common.h"
+
+extern void zero_fill_benchmark();
+extern void huge_page_benchmark();
+extern void dispatch_benchmark();
+extern void numa_benchmark();
+extern void backend_benchmark();
+extern void cost_model_benchmark();
+extern void pipeline_benchmark();
+extern void async_benchmark();
+extern void gemm_benchmark();
+extern void convolution_benchmark();
+extern void pooling_benchmark();
+extern void layout_benchmark();
+
+//usage: benchmark [name], run all benchmarks without name
+int benchmark_main(int argc, char* argv[])
+{
+	EasyCNN::setLogLevel(EasyCNN::EASYCNN_LOG_LEVEL_CRITICAL);
+	const std::string which = argc > 1 ? argv[1] : "";
+	if (which.empty() || which == "zero_fill")
+	{
+		zero_fill_benchmark();
+	}
+	if (which.empty() || which == "huge_page")
+	{
+		huge_page_benchmark();
+	}
+	if (which.empty() || which == "dispatch")
+	{
+		dispatch_benchmark();
+	}
+	if (which.empty() || which == "numa")
+	{
+		numa_benchmark();
+	}
+	if (which.empty() || which == "backend")
+	{
+		backend_benchmark();
+	}
+	if (which.empty() || which == "cost_model")
+	{
+		cost_model_benchmark();
+	}
+	if (which.empty() || which == "pipeline")
+	{
+		pipeline_benchmark();
+	}
+	if (which.empty() || which == "async")
+	{
+		async_benchmark();
+	}
+	if (which.empty() || which == "gemm")
+	{
+		gemm_benchmark();
+	}
+	if (which.empty() || which == "convolution")
+	{
+		convolution_benchmark();
+	}
+	if (which.empty() || which == "pooling")
+	{
+		pooling_benchmark();
+	}
+	if (which.empty() || which == "layout")
+	{
+		layout_benchmark();
+	}
+	return 0;
+}
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <sstream>
+#include "benchmark_common.h"
+
+//forward of one convolution layer with every algorithm the shape allows, and the one auto picks.
+//network is finalized, so blocked one includes conversions of layout around the layer.
+void convolution_benchmark()
+{
+	std::cout << "==== convolution ====" << std::endl;
+	struct Shape
+	{
+		size_t batch, channels, size, kernels, kernel, step;
+		EasyCNN::ConvolutionLayer::PaddingType padding;
+		const char* name;
+	};
+	const Shape shapes[] = {
+		{ 16, 1, 28, 6, 3, 1, EasyCNN::ConvolutionLayer::SAME, "mnist conv1" },
+		{ 16, 6, 14, 12, 3, 1, EasyCNN::ConvolutionLayer::SAME, "mnist conv2" },
+		{ 1, 32, 56, 32, 3, 1, EasyCNN::ConvolutionLayer::SAME, "3x3" },
+		{ 1, 64, 28, 64, 3, 1, EasyCNN::ConvolutionLayer::SAME, "3x3" },
+		{ 1, 128, 14, 128, 3, 1, EasyCNN::ConvolutionLayer::SAME, "3x3" },
+		{ 1, 256, 7, 256, 3, 1, EasyCNN::ConvolutionLayer::SAME, "3x3" },
+		{ 8, 64, 30, 64, 3, 1, EasyCNN::ConvolutionLayer::VALID, "3x3 valid" },
+		{ 1, 32, 56, 64, 5, 2, EasyCNN::ConvolutionLayer::VALID, "5x5 step 2" },
+		{ 1, 128, 28, 64, 1, 1, EasyCNN::ConvolutionLayer::VALID, "1x1" },
+	};
+	const EasyCNN::ConvolutionLayer::Algorithm algorithms[] = { EasyCNN::ConvolutionLayer::DIRECT, EasyCNN::ConvolutionLayer::GEMM,
+		EasyCNN::ConvolutionLayer::WINOGRAD_2X2, EasyCNN::ConvolutionLayer::WINOGRAD_4X4, EasyCNN::ConvolutionLayer::BLOCKED,
+		EasyCNN::ConvolutionLayer::AUTO };
+	const char* algorithmNames[] = { "direct", "gemm", "winograd 2x2", "winograd 4x4", "blocked", "auto" };
+	for (const Shape& shape : shapes)
+	{
+		const EasyCNN::DataSize inputSize(shape.batch, shape.channels, shape.size, shape.size);
+		std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(inputSize));
+		benchmark_fill_random(input);
+		for (size_t i = 0; i < 6; i++)
+		{
+			const bool winograd = (algorithms[i] == EasyCNN::ConvolutionLayer::WINOGRAD_2X2 || algorithms[i] == EasyCNN::ConvolutionLayer::WINOGRAD_4X4);
+			if (winograd && (shape.kernel != 3 || shape.step != 1))
+			{
+				continue;
+			}
+			EasyCNN::NetWork network;
+			network.setInputSize(inputSize);
+			network.addayer(std::make_shared<EasyCNN::InputLayer>());
+			std::shared_ptr<EasyCNN::ConvolutionLayer> conv(std::make_shared<EasyCNN::ConvolutionLayer>());
+			conv->setParamaters(EasyCNN::ParamSize(shape.kernels, shape.channels, shape.kernel, shape.kernel),
+				shape.step, shape.step, true, shape.padding);
+			conv->setAlgorithm(algorithms[i]);
+			network.addayer(conv);
+			network.finalize();
+			const double ms = benchmark_run(1, 5, [&](){ network.testBatch(input); });
+			std::stringstream ss;
+			ss << shape.name << ", batch " << shape.batch << ", " << algorithmNames[i];
+			benchmark_report(ss.str(), ms);
+		}
+	}
+}
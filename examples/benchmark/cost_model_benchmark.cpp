@@ -0,0 +1,51 @@
+#include <iostream>
+#include <sstream>
+#include "benchmark_common.h"
+
+//mnist network when every region fans out to all threads(free fork-join), with default host model,
+//and with model calibrated on this host. small batches are where serial layers win.
+void cost_model_benchmark()
+{
+	std::cout << "==== cost model ====" << std::endl;
+	const size_t threads = 4;
+	const size_t batches[] = { 1, 8, 64 };
+	EasyCNN::set_thread_num(threads);
+	const EasyCNN::ParallelCostModel defaultModel = EasyCNN::get_parallel_cost_model();
+	EasyCNN::ParallelCostModel fanOutModel = defaultModel;
+	fanOutModel.forkJoinNanoseconds = 0.0;
+	fanOutModel.perThreadNanoseconds = 0.0;
+	const EasyCNN::ParallelCostModel calibratedModel = EasyCNN::calibrate_parallel_cost();
+	std::cout << "calibrated : fork-join " << calibratedModel.forkJoinNanoseconds << " ns + "
+		<< calibratedModel.perThreadNanoseconds << " ns per thread, "
+		<< calibratedModel.flopsPerNanosecond << " flops/ns, "
+		<< calibratedModel.bytesPerNanosecond << " bytes/ns" << std::endl;
+	const EasyCNN::ParallelCostModel models[] = { fanOutModel, defaultModel, calibratedModel };
+	const char* names[] = { "always fan out", "default model", "calibrated model" };
+	for (const size_t batch : batches)
+	{
+		EasyCNN::NetWork network;
+		benchmark_build_mnist_net(network, batch);
+		std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 1, 28, 28)));
+		std::shared_ptr<EasyCNN::DataBucket> label(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 10, 1, 1)));
+		benchmark_fill_random(input);
+		benchmark_fill_label(label);
+		for (size_t i = 0; i < 3; i++)
+		{
+			EasyCNN::set_parallel_cost_model(models[i]);
+			const double trainMs = benchmark_run(2, 10, [&](){ network.trainBatch(input, label); });
+			std::stringstream ss;
+			ss << "mnist train, batch " << batch << ", " << names[i];
+			benchmark_report(ss.str(), trainMs);
+		}
+		network.finalize();
+		for (size_t i = 0; i < 3; i++)
+		{
+			EasyCNN::set_parallel_cost_model(models[i]);
+			const double testMs = benchmark_run(2, 20, [&](){ network.testBatch(input); });
+			std::stringstream ss;
+			ss << "mnist test, batch " << batch << ", " << names[i];
+			benchmark_report(ss.str(), testMs);
+		}
+	}
+	EasyCNN::set_parallel_cost_model(defaultModel);
+}
@@ -0,0 +1,69 @@
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <future>
+#include "benchmark_common.h"
+
+//dispatch of the queue pool : one packaged task and future per chunk, caller waits
+static void queue_pool_dispatch(const std::function<void(const size_t, const size_t)>& func, const size_t number)
+{
+	EasyCNN::ThreadPool& pool = EasyCNN::ThreadPool::instance();
+	const size_t threads = pool.size();
+	const size_t payload = number / threads;
+	const size_t remainder = number - payload*threads;
+	std::vector<std::future<void>> futures;
+	size_t start = 0;
+	for (size_t i = 0; i < threads && start < number; i++)
+	{
+		const size_t stop = start + payload + (i < remainder ? 1 : 0);
+		futures.push_back(pool.enqueue(func, start, stop));
+		start = stop;
+	}
+	for (auto& future : futures)
+	{
+		future.wait();
+	}
+}
+
+//latency of one dispatch of tiny work (like a small layer at batch 1..64) : queue pool vs work-stealing scheduler,
+//whose workers spin for the next dispatch or sleep at once. spin needs more cores than threads.
+void dispatch_benchmark()
+{
+	std::cout << "==== dispatch ====" << std::endl;
+	const size_t threadNums[] = { 2, 4 };
+	const size_t numbers[] = { 4, 64 };
+	const size_t iterations = 20000;
+	std::vector<float> data(64 * 256, 1.0f);
+	for (const size_t threads : threadNums)
+	{
+		EasyCNN::ThreadPool::instance().resize(threads);
+		EasyCNN::set_thread_num(threads);
+		for (const size_t number : numbers)
+		{
+			//256 floats per item
+			auto work = [&](const size_t start, const size_t stop){
+				for (size_t i = start; i < stop; i++)
+				{
+					float* item = &data[i * 256];
+					for (size_t j = 0; j < 256; j++)
+					{
+						item[j] = item[j] * 0.5f + 0.5f;
+					}
+				}
+			};
+			const double queueMs = benchmark_run(100, iterations, [&](){ queue_pool_dispatch(work, number); });
+			//workers sleep at once : every dispatch wakes them up
+			EasyCNN::set_spin_time(0);
+			const double sleepMs = benchmark_run(100, iterations, [&](){ EasyCNN::parallel_for(0, number, 0, work); });
+			EasyCNN::set_spin_time(EasyCNN::TaskScheduler::DEFAULT_SPIN_MICROSECONDS);
+			const double stealMs = benchmark_run(100, iterations, [&](){ EasyCNN::parallel_for(0, number, 0, work); });
+
+			std::stringstream ss;
+			ss << "threads " << threads << ", items " << number << ", 1000 dispatches";
+			benchmark_report("queue pool, " + ss.str(), queueMs * 1000.0);
+			benchmark_report("work stealing without spin, " + ss.str(), sleepMs * 1000.0);
+			benchmark_report("work stealing, " + ss.str(), stealMs * 1000.0);
+		}
+	}
+	EasyCNN::ThreadPool::instance().resize(1);
+}
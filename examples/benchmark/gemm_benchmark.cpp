@@ -0,0 +1,79 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "benchmark_common.h"
+
+//c(m,n) = a(m,k) * b(n,k)^T, loop of old fullconnect
+static void naive_gemm(const size_t m, const size_t n, const size_t k, const float* a, const float* b, float* c)
+{
+	for (size_t i = 0; i < m; i++)
+	{
+		for (size_t j = 0; j < n; j++)
+		{
+			float sum = 0.0f;
+			for (size_t p = 0; p < k; p++)
+			{
+				sum += a[i*k + p] * b[j*k + p];
+			}
+			c[i*n + j] = sum;
+		}
+	}
+}
+
+//c = a * b^T as fullconnect does it : naive loop, blocked sgemm with scalar and simd microkernel, parallel sgemm
+void gemm_benchmark()
+{
+	std::cout << "==== gemm ====" << std::endl;
+	struct Shape { size_t m, n, k; const char* name; };
+	const Shape shapes[] = {
+		{ 256, 256, 256, "square" },
+		{ 512, 512, 512, "square" },
+		{ 1024, 1024, 1024, "square" },
+		{ 1, 1024, 4096, "fullconnect batch" },
+		{ 64, 1024, 4096, "fullconnect batch" },
+	};
+	const size_t threads = std::max<size_t>(std::min<size_t>(std::thread::hardware_concurrency(), 8), 1);
+	for (const Shape& shape : shapes)
+	{
+		const size_t m = shape.m, n = shape.n, k = shape.k;
+		std::shared_ptr<EasyCNN::DataBucket> a(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(1, 1, m, k)));
+		std::shared_ptr<EasyCNN::DataBucket> b(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(1, 1, n, k)));
+		std::vector<float> c(m*n);
+		benchmark_fill_random(a);
+		benchmark_fill_random(b);
+		const float* aData = a->getData().get();
+		const float* bData = b->getData().get();
+		EasyCNN::reserve_workspace(EasyCNN::sgemm_workspace_size(m, n, k));
+		EasyCNN::prepare_workspace();
+		const double flops = 2.0*m*n*k;
+		//about a second of naive loop at most
+		const size_t iterations = std::max<size_t>(1, (size_t)(1e9 / flops));
+		auto report = [&](const std::string& name, const double ms){
+			std::stringstream ss;
+			ss << shape.name << " " << m << "x" << n << "x" << k << ", " << name;
+			std::stringstream extra;
+			extra << flops / ms * 1e-6 << " GFLOP/s";
+			benchmark_report(ss.str(), ms, extra.str());
+		};
+
+		report("naive", benchmark_run(1, iterations, [&](){ naive_gemm(m, n, k, aData, bData, &c[0]); }));
+		EasyCNN::set_sgemm_simd(false);
+		report(std::string("sgemm ") + EasyCNN::get_sgemm_kernel(), benchmark_run(1, iterations, [&](){
+			EasyCNN::sgemm(false, true, m, n, k, 1.0f, aData, k, bData, k, 0.0f, &c[0], n);
+		}));
+		if (EasyCNN::set_sgemm_simd(true))
+		{
+			report(std::string("sgemm ") + EasyCNN::get_sgemm_kernel(), benchmark_run(1, iterations, [&](){
+				EasyCNN::sgemm(false, true, m, n, k, 1.0f, aData, k, bData, k, 0.0f, &c[0], n);
+			}));
+		}
+		EasyCNN::set_thread_num(threads);
+		std::stringstream ss;
+		ss << "parallel sgemm " << EasyCNN::get_sgemm_kernel() << ", " << threads << " threads";
+		report(ss.str(), benchmark_run(1, iterations, [&](){
+			EasyCNN::parallel_sgemm(false, true, m, n, k, 1.0f, aData, k, bData, k, 0.0f, &c[0], n);
+		}));
+		EasyCNN::set_thread_num(1);
+	}
+}
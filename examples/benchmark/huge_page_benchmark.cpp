@@ -0,0 +1,63 @@
+#include <iostream>
+#include <sstream>
+#include "benchmark_common.h"
+
+static const char* huge_page_mode_name(const EasyCNN::HugePageMode mode)
+{
+	switch (mode)
+	{
+	case EasyCNN::HugePageMode::Transparent:
+		return "transparent";
+	case EasyCNN::HugePageMode::Explicit:
+		return "explicit";
+	default:
+		return "disabled";
+	}
+}
+
+//fullconnect and convolution2d on buffers from a pool of each huge page policy.
+//big weights are where tlb misses show up, so sizes are larger than mnist net.
+void huge_page_benchmark()
+{
+	std::cout << "==== huge page ====" << std::endl;
+	const EasyCNN::HugePageMode modes[] = { EasyCNN::HugePageMode::Disabled, EasyCNN::HugePageMode::Transparent, EasyCNN::HugePageMode::Explicit };
+	const size_t batch = 64;
+	for (const EasyCNN::HugePageMode mode : modes)
+	{
+		std::shared_ptr<EasyCNN::MemoryPool> pool(std::make_shared<EasyCNN::MemoryPool>());
+		pool->setHugePagePolicy(mode);
+
+		//fullconnect : 4096 -> 1024, weight is 16MB
+		const size_t fcIn = 4096;
+		const size_t fcOut = 1024;
+		std::shared_ptr<EasyCNN::DataBucket> fcInput(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, fcIn, 1, 1), pool));
+		std::shared_ptr<EasyCNN::DataBucket> fcWeight(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(1, fcIn*fcOut, 1, 1), pool));
+		std::shared_ptr<EasyCNN::DataBucket> fcBias(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(1, fcOut, 1, 1), pool));
+		std::shared_ptr<EasyCNN::DataBucket> fcOutput(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, fcOut, 1, 1), pool));
+		benchmark_fill_random(fcInput);
+		benchmark_fill_random(fcWeight);
+		benchmark_fill_random(fcBias);
+		const double fcMs = benchmark_run(1, 5, [&](){
+			EasyCNN::fullconnect(fcInput->getView(), fcWeight->getData().get(), fcBias->getData().get(), fcOutput->getView());
+		});
+
+		//convolution2d : 16x56x56 -> 32x56x56, 3x3 same
+		const EasyCNN::DataSize convInputSize(batch / 16, 16, 56, 56);
+		const EasyCNN::DataSize kernelSize(32, 16, 3, 3);
+		const EasyCNN::DataSize convOutputSize(batch / 16, 32, 56, 56);
+		std::shared_ptr<EasyCNN::DataBucket> convInput(std::make_shared<EasyCNN::DataBucket>(convInputSize, pool));
+		std::shared_ptr<EasyCNN::DataBucket> kernel(std::make_shared<EasyCNN::DataBucket>(kernelSize, pool));
+		std::shared_ptr<EasyCNN::DataBucket> convOutput(std::make_shared<EasyCNN::DataBucket>(convOutputSize, pool));
+		benchmark_fill_random(convInput);
+		benchmark_fill_random(kernel);
+		const double convMs = benchmark_run(1, 3, [&](){
+			EasyCNN::convolution2d(convInput->getView(), kernel->getView(), nullptr, convOutput->getView(), 1, 1, 1);
+		});
+
+		std::stringstream extra;
+		extra << (pool->getHugePageBytes() / 1024 / 1024) << " MB on huge pages";
+		const std::string name = huge_page_mode_name(mode);
+		benchmark_report("fullconnect 4096x1024, batch 64, " + name, fcMs, extra.str());
+		benchmark_report("convolution2d 16x56x56 -> 32, batch 4, " + name, convMs, extra.str());
+	}
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <sstream>
+#include "benchmark_common.h"
+
+//3 channel image features : convolutions, poolings and a 1x1 convolution
+static void build_image_net(EasyCNN::NetWork& network, const size_t batch)
+{
+	network.setInputSize(EasyCNN::DataSize(batch, 3, 64, 64));
+	network.addayer(std::make_shared<EasyCNN::InputLayer>());
+	const size_t kernels[] = { 32, 64 };
+	size_t channels = 3;
+	for (const size_t kernel : kernels)
+	{
+		std::shared_ptr<EasyCNN::ConvolutionLayer> conv(std::make_shared<EasyCNN::ConvolutionLayer>());
+		conv->setParamaters(EasyCNN::ParamSize(kernel, channels, 3, 3), 1, 1, true, EasyCNN::ConvolutionLayer::SAME);
+		network.addayer(conv);
+		network.addayer(std::make_shared<EasyCNN::ReluLayer>());
+		std::shared_ptr<EasyCNN::PoolingLayer> pool(std::make_shared<EasyCNN::PoolingLayer>());
+		pool->setParamaters(EasyCNN::PoolingLayer::MaxPooling, EasyCNN::ParamSize(1, kernel, 2, 2), 2, 2, EasyCNN::PoolingLayer::SAME);
+		network.addayer(pool);
+		channels = kernel;
+	}
+	std::shared_ptr<EasyCNN::ConvolutionLayer> pointwise(std::make_shared<EasyCNN::ConvolutionLayer>());
+	pointwise->setParamaters(EasyCNN::ParamSize(64, channels, 1, 1), 1, 1, true, EasyCNN::ConvolutionLayer::VALID);
+	network.addayer(pointwise);
+	network.addayer(std::make_shared<EasyCNN::ReluLayer>());
+}
+
+//finalized mnist network on NCHW layout and with convolutions and poolings on channel blocked layout(conversions included).
+//image network on NCHW input, on NHWC input converted at once, and on NHWC input end to end.
+void layout_benchmark()
+{
+	std::cout << "==== layout ====" << std::endl;
+	const size_t batches[] = { 1, 16, 64 };
+	for (const size_t batch : batches)
+	{
+		EasyCNN::NetWork network;
+		benchmark_build_mnist_net(network, batch);
+		network.finalize();
+		std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 1, 28, 28)));
+		benchmark_fill_random(input);
+		for (const bool blocked : { false, true })
+		{
+			network.setBlockedLayout(blocked);
+			const double ms = benchmark_run(2, 20, [&](){ network.testBatch(input); });
+			std::stringstream ss;
+			ss << "mnist test, batch " << batch << ", " << (blocked ? "blocked" : "nchw");
+			benchmark_report(ss.str(), ms);
+		}
+	}
+	const size_t imageBatches[] = { 1, 8 };
+	for (const size_t batch : imageBatches)
+	{
+		EasyCNN::NetWork network;
+		build_image_net(network, batch);
+		network.finalize();
+		std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 3, 64, 64)));
+		benchmark_fill_random(input);
+		std::shared_ptr<EasyCNN::DataBucket> nhwcInput(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 3, 64, 64)));
+		benchmark_fill_random(nhwcInput);
+		nhwcInput->setLayout(EasyCNN::Layout::NHWC);
+		const double nchwMs = benchmark_run(2, 10, [&](){ network.testBatch(input); });
+		network.setNHWCLayout(false);
+		const double convertedMs = benchmark_run(2, 10, [&](){ network.testBatch(nhwcInput); });
+		network.setNHWCLayout(true);
+		const double nhwcMs = benchmark_run(2, 10, [&](){ network.testBatch(nhwcInput); });
+		std::stringstream ss;
+		ss << "image test, batch " << batch << ", ";
+		benchmark_report(ss.str() + "nchw input", nchwMs);
+		benchmark_report(ss.str() + "nhwc input converted", convertedMs);
+		benchmark_report(ss.str() + "nhwc input end to end", nhwcMs);
+	}
+}
@@ -0,0 +1,53 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "benchmark_common.h"
+
+static const char* affinity_policy_name(const EasyCNN::AffinityPolicy policy)
+{
+	switch (policy)
+	{
+	case EasyCNN::AffinityPolicy::Compact:
+		return "compact";
+	case EasyCNN::AffinityPolicy::Scatter:
+		return "scatter";
+	default:
+		return "none";
+	}
+}
+
+//all cores, workers float or pinned by each policy. network and bucket are built on its scheduler,
+//so storage is first touched by the threads(nodes) which process it.
+//scaling beyond one socket shows up on streaming fill and the batch 256 mnist forward.
+void numa_benchmark()
+{
+	std::cout << "==== numa ====" << std::endl;
+	const EasyCNN::AffinityPolicy policies[] = { EasyCNN::AffinityPolicy::None, EasyCNN::AffinityPolicy::Compact, EasyCNN::AffinityPolicy::Scatter };
+	const size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	const size_t batch = 256;
+	std::cout << EasyCNN::get_numa_node_count() << " numa nodes, " << threads << " threads" << std::endl;
+	for (const EasyCNN::AffinityPolicy policy : policies)
+	{
+		std::shared_ptr<EasyCNN::TaskScheduler> scheduler(std::make_shared<EasyCNN::TaskScheduler>(threads));
+		scheduler->setAffinity(policy);
+		const EasyCNN::SchedulerScope scope(scheduler.get());
+
+		//streaming fill : 64MB, bound by memory bandwidth of nodes
+		std::shared_ptr<EasyCNN::DataBucket> bucket(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(16, 1024, 1024, 1)));
+		const double fillMs = benchmark_run(2, 20, [&](){ bucket->fillData(1.0f); });
+
+		EasyCNN::NetWork network;
+		network.setScheduler(scheduler);
+		benchmark_build_mnist_net(network, batch);
+		network.finalize();
+		std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 1, 28, 28)));
+		benchmark_fill_random(input);
+		const double forwardMs = benchmark_run(2, 10, [&](){ network.testBatch(input); });
+
+		std::stringstream extra;
+		extra << "split over " << scheduler->getNodeCount() << " nodes";
+		const std::string name = affinity_policy_name(policy);
+		benchmark_report("fill 64MB, " + name, fillMs, extra.str());
+		benchmark_report("mnist forward, batch 256, " + name, forwardMs, extra.str());
+	}
+}
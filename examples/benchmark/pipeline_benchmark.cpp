@@ -0,0 +1,69 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "benchmark_common.h"
+
+//stream of mnist frames : one forward after another on all threads, vs layer stages on core groups.
+//every run uses the same number of threads. latency is from push to pop of a frame, producer pushes
+//as fast as it can, so it includes waiting for a free frame.
+void pipeline_benchmark()
+{
+	std::cout << "==== pipeline ====" << std::endl;
+	const size_t threads = std::max<size_t>(std::min<size_t>(std::thread::hardware_concurrency(), 8), 2);
+	const size_t stageCounts[] = { 2, 4 };
+	const size_t batches[] = { 1, 8 };
+	const size_t frames = 400;
+	for (const size_t batch : batches)
+	{
+		EasyCNN::NetWork network;
+		benchmark_build_mnist_net(network, batch);
+		network.finalize();
+		std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 1, 28, 28)));
+		benchmark_fill_random(input);
+
+		EasyCNN::set_thread_num(threads);
+		const double forwardMs = benchmark_run(10, frames, [&](){ network.testBatch(input); });
+		std::stringstream ss;
+		ss << "batch " << batch << ", " << threads << " threads";
+		benchmark_report("forward one by one, " + ss.str(), forwardMs, "latency = time of frame");
+
+		for (const size_t stages : stageCounts)
+		{
+			if (stages > threads)
+			{
+				continue;
+			}
+			EasyCNN::StreamPipeline pipeline(network, batch, stages, threads / stages, 2 * stages);
+			std::vector<double> pushTimes(frames);
+			double latency = 0.0;
+			const double begin = benchmark_now_ms();
+			std::thread producer([&](){
+				for (size_t i = 0; i < frames; i++)
+				{
+					pushTimes[i] = benchmark_now_ms();
+					pipeline.push(input);
+				}
+				pipeline.close();
+			});
+			std::shared_ptr<EasyCNN::DataBucket> output;
+			for (size_t i = 0; pipeline.pop(output); i++)
+			{
+				latency += benchmark_now_ms() - pushTimes[i];
+			}
+			const double totalMs = benchmark_now_ms() - begin;
+			producer.join();
+
+			std::stringstream extra;
+			extra << "latency " << latency / frames << " ms, layers of stages";
+			for (const size_t layers : pipeline.getStageLayers())
+			{
+				extra << " " << layers;
+			}
+			std::stringstream name;
+			name << stages << " stages, " << ss.str();
+			benchmark_report(name.str(), totalMs / frames, extra.str());
+		}
+	}
+	EasyCNN::set_thread_num(1);
+}
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include "benchmark_common.h"
+
+static void build_pooling_net(EasyCNN::NetWork& network, const EasyCNN::DataSize inputSize, const EasyCNN::PoolingLayer::PoolingType poolingType)
+{
+	network.setInputSize(inputSize);
+	network.addayer(std::make_shared<EasyCNN::InputLayer>());
+	std::shared_ptr<EasyCNN::PoolingLayer> pool(std::make_shared<EasyCNN::PoolingLayer>());
+	pool->setParamaters(poolingType, EasyCNN::ParamSize(1, inputSize.channels, 2, 2), 2, 2, EasyCNN::PoolingLayer::VALID);
+	network.addayer(pool);
+}
+//largest difference between mean pooling of network and the one computed here, for every sample of batch.
+//samples differ, so pooling all of them from the first one(as it once did) is caught.
+static float mean_pooling_error(const size_t batch)
+{
+	const EasyCNN::DataSize inputSize(batch, 3, 8, 6);
+	EasyCNN::NetWork network;
+	build_pooling_net(network, inputSize, EasyCNN::PoolingLayer::MeanPooling);
+	std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(inputSize));
+	benchmark_fill_random(input);
+	const std::shared_ptr<EasyCNN::DataBucket> output = network.testBatch(input);
+	const EasyCNN::DataSize outputSize = output->getSize();
+	const float* inputData = input->getData().get();
+	const float* outputData = output->getData().get();
+	float error = 0.0f;
+	for (size_t n = 0; n < outputSize.number; n++)
+	{
+		for (size_t c = 0; c < outputSize.channels; c++)
+		{
+			for (size_t y = 0; y < outputSize.height; y++)
+			{
+				for (size_t x = 0; x < outputSize.width; x++)
+				{
+					float sum = 0.0f;
+					for (size_t ky = 0; ky < 2; ky++)
+					{
+						for (size_t kx = 0; kx < 2; kx++)
+						{
+							sum += inputData[((n*inputSize.channels + c)*inputSize.height + y * 2 + ky)*inputSize.width + x * 2 + kx];
+						}
+					}
+					const float result = outputData[((n*outputSize.channels + c)*outputSize.height + y)*outputSize.width + x];
+					error = std::max(error, std::fabs(result - sum / 4.0f));
+				}
+			}
+		}
+	}
+	return error;
+}
+
+//forward of max and mean pooling 2x2, mean pooling of a batch is checked against a plain loop
+void pooling_benchmark()
+{
+	std::cout << "==== pooling ====" << std::endl;
+	const float error = mean_pooling_error(4);
+	const EasyCNN::DataSize inputSize(32, 16, 28, 28);
+	std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(inputSize));
+	benchmark_fill_random(input);
+	const EasyCNN::PoolingLayer::PoolingType types[] = { EasyCNN::PoolingLayer::MaxPooling, EasyCNN::PoolingLayer::MeanPooling };
+	for (const auto poolingType : types)
+	{
+		EasyCNN::NetWork network;
+		build_pooling_net(network, inputSize, poolingType);
+		const double ms = benchmark_run(2, 20, [&](){ network.testBatch(input); });
+		const bool mean = (poolingType == EasyCNN::PoolingLayer::MeanPooling);
+		std::stringstream extra;
+		if (mean)
+		{
+			extra << "max error of batch " << error << (error < 1e-5f ? " ok" : " WRONG");
+		}
+		benchmark_report(std::string(mean ? "mean" : "max") + " pooling 16x28x28, batch 32", ms, extra.str());
+	}
+}
@@ -0,0 +1,171 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include "benchmark_common.h"
+
+//layer of mnist net which can ask executor to clear all its buffers, as executor did before write modes
+class ZeroFillSwitch
+{
+public:
+	virtual ~ZeroFillSwitch(){}
+	void setClearAll(const bool _clearAll){ clearAll = _clearAll; }
+	virtual void initParams() = 0;
+	virtual std::vector<std::shared_ptr<EasyCNN::ParamBucket>> getGradients() const = 0;
+protected:
+	bool clearAll = false;
+};
+template<typename LayerType>
+class ZeroFillLayer : public LayerType, public ZeroFillSwitch
+{
+public:
+	//deterministic small weights, so both nets start the same and stay finite
+	virtual void initParams() override
+	{
+		for (const auto& param : this->getParamData())
+		{
+			float* data = param->getData().get();
+			for (size_t i = 0; i < param->getSize().totalSize(); i++)
+			{
+				data[i] = 0.02f*(float)((int)((i * 7) % 11) - 5);
+			}
+		}
+	}
+	virtual std::vector<std::shared_ptr<EasyCNN::ParamBucket>> getGradients() const override
+	{
+		return this->getDiffData();
+	}
+protected:
+	virtual EasyCNN::WriteMode getOutputWriteMode() const override
+	{
+		return clearAll ? EasyCNN::WriteMode::Accumulate : LayerType::getOutputWriteMode();
+	}
+	virtual EasyCNN::WriteMode getDiffWriteMode() const override
+	{
+		return clearAll ? EasyCNN::WriteMode::Accumulate : LayerType::getDiffWriteMode();
+	}
+	virtual EasyCNN::WriteMode getGradientWriteMode() const override
+	{
+		return clearAll ? EasyCNN::WriteMode::Accumulate : LayerType::getGradientWriteMode();
+	}
+};
+
+//same topology as benchmark_build_mnist_net
+static std::vector<std::shared_ptr<ZeroFillSwitch>> build_net(EasyCNN::NetWork& network, const size_t batch, const bool clearAll)
+{
+	std::vector<std::shared_ptr<ZeroFillSwitch>> layers;
+	auto add = [&](const std::shared_ptr<EasyCNN::Layer>& layer, const std::shared_ptr<ZeroFillSwitch>& zeroFill){
+		zeroFill->setClearAll(clearAll);
+		network.addayer(layer);
+		zeroFill->initParams();
+		layers.push_back(zeroFill);
+	};
+	auto relu = [&](){
+		std::shared_ptr<ZeroFillLayer<EasyCNN::ReluLayer>> layer(std::make_shared<ZeroFillLayer<EasyCNN::ReluLayer>>());
+		add(layer, layer);
+	};
+	auto conv = [&](const EasyCNN::ParamSize& kernelSize){
+		std::shared_ptr<ZeroFillLayer<EasyCNN::ConvolutionLayer>> layer(std::make_shared<ZeroFillLayer<EasyCNN::ConvolutionLayer>>());
+		layer->setParamaters(kernelSize, 1, 1, true, EasyCNN::ConvolutionLayer::SAME);
+		add(layer, layer);
+	};
+	auto pool = [&](const size_t channels){
+		std::shared_ptr<ZeroFillLayer<EasyCNN::PoolingLayer>> layer(std::make_shared<ZeroFillLayer<EasyCNN::PoolingLayer>>());
+		layer->setParamaters(EasyCNN::PoolingLayer::MaxPooling, EasyCNN::ParamSize(1, channels, 2, 2), 2, 2, EasyCNN::PoolingLayer::SAME);
+		add(layer, layer);
+	};
+	auto fc = [&](const size_t outputs){
+		std::shared_ptr<ZeroFillLayer<EasyCNN::FullconnectLayer>> layer(std::make_shared<ZeroFillLayer<EasyCNN::FullconnectLayer>>());
+		layer->setParamaters(EasyCNN::ParamSize(1, outputs, 1, 1), true);
+		add(layer, layer);
+	};
+	network.setInputSize(EasyCNN::DataSize(batch, 1, 28, 28));
+	network.addayer(std::make_shared<EasyCNN::InputLayer>());
+	conv(EasyCNN::ParamSize(6, 1, 3, 3));
+	relu();
+	pool(6);
+	conv(EasyCNN::ParamSize(12, 6, 3, 3));
+	relu();
+	pool(12);
+	fc(512);
+	relu();
+	fc(10);
+	std::shared_ptr<ZeroFillLayer<EasyCNN::SoftmaxLayer>> softmax(std::make_shared<ZeroFillLayer<EasyCNN::SoftmaxLayer>>());
+	add(softmax, softmax);
+	network.setLossFunctor(std::make_shared<EasyCNN::CrossEntropyFunctor>());
+	network.setOptimizer(std::make_shared<EasyCNN::SGD>(0.01f));
+	return layers;
+}
+//gradients of one train step must not depend on the clears skipped
+static bool same_gradients(const std::vector<std::shared_ptr<ZeroFillSwitch>>& skip, const std::vector<std::shared_ptr<ZeroFillSwitch>>& clear)
+{
+	for (size_t i = 0; i < skip.size(); i++)
+	{
+		const auto skipGradients = skip[i]->getGradients();
+		const auto clearGradients = clear[i]->getGradients();
+		if (skipGradients.size() != clearGradients.size())
+		{
+			return false;
+		}
+		for (size_t j = 0; j < skipGradients.size(); j++)
+		{
+			const size_t len = skipGradients[j]->getSize().totalSize();
+			const float* skipData = skipGradients[j]->getData().get();
+			const float* clearData = clearGradients[j]->getData().get();
+			for (size_t k = 0; k < len; k++)
+			{
+				if (!std::isfinite(skipData[k]))
+				{
+					return false;
+				}
+			}
+			if (len != clearGradients[j]->getSize().totalSize() || memcmp(skipData, clearData, len*sizeof(float)) != 0)
+			{
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//train/test step of mnist net, with clears of overwriting layers skipped and with executor clearing every buffer as before
+void zero_fill_benchmark()
+{
+	std::cout << "==== zero fill ====" << std::endl;
+	const size_t batches[] = { 1, 16, 64 };
+	for (const size_t batch : batches)
+	{
+		EasyCNN::NetWork skipNetwork;
+		EasyCNN::NetWork clearNetwork;
+		const auto skipLayers = build_net(skipNetwork, batch, false);
+		const auto clearLayers = build_net(clearNetwork, batch, true);
+		std::shared_ptr<EasyCNN::DataBucket> input(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 1, 28, 28)));
+		std::shared_ptr<EasyCNN::DataBucket> label(std::make_shared<EasyCNN::DataBucket>(EasyCNN::DataSize(batch, 10, 1, 1)));
+		benchmark_fill_random(input);
+		benchmark_fill_label(label);
+
+		//second step : buffers whose clear is skipped hold values of first one
+		skipNetwork.trainBatch(input, label);
+		clearNetwork.trainBatch(input, label);
+		const float skipLoss = skipNetwork.trainBatch(input, label);
+		const float clearLoss = clearNetwork.trainBatch(input, label);
+		const bool same = std::isfinite(skipLoss) && skipLoss == clearLoss && same_gradients(skipLayers, clearLayers);
+
+		const double skipTrainMs = benchmark_run(2, 20, [&](){ skipNetwork.trainBatch(input, label); });
+		const double clearTrainMs = benchmark_run(2, 20, [&](){ clearNetwork.trainBatch(input, label); });
+		skipNetwork.finalize();
+		clearNetwork.finalize();
+		const double skipTestMs = benchmark_run(2, 100, [&](){ skipNetwork.testBatch(input); });
+		const double clearTestMs = benchmark_run(2, 100, [&](){ clearNetwork.testBatch(input); });
+
+		std::stringstream ss;
+		ss << "batch " << batch;
+		std::stringstream extra;
+		extra << "gradients " << (same ? "identical" : "DIFFER");
+		benchmark_report("train step, clears skipped, " + ss.str(), skipTrainMs, extra.str());
+		benchmark_report("train step, all cleared, " + ss.str(), clearTrainMs);
+		benchmark_report("test step, clears skipped, " + ss.str(), skipTestMs);
+		benchmark_report("test step, all cleared, " + ss.str(), clearTestMs);
+	}
+}
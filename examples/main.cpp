@@ -1,8 +1,17 @@
+#include <string>
+
 //////////////////////////////////////////////////////////////////////////
 //mnist
 extern int mnist_main(int argc, char* argv[]);
+//////////////////////////////////////////////////////////////////////////
+//benchmark : run as "<program> benchmark [name]"
+extern int benchmark_main(int argc, char* argv[]);
 
 int main(int argc, char* argv[])
 {
+	if (argc > 1 && std::string(argv[1]) == "benchmark")
+	{
+		return benchmark_main(argc - 1, argv + 1);
+	}
 	return mnist_main(argc, argv);
 }
\ No newline at end of file
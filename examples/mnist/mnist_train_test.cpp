@@ -26,11 +26,21 @@ static bool fetch_data(const std::vector<image_t>& images,std::shared_ptr<EasyCN
 		auto inputDataSize = inputDataBucket->getSize();
 		inputDataSize.number = images.size() - offset;
 		actualEndPos = offset + inputDataSize.number;
-		inputDataBucket.reset(new EasyCNN::DataBucket(inputDataSize));
+		inputDataBucket->reshape(inputDataSize);
 		//label data
 		auto labelDataSize = labelDataBucket->getSize();
 		labelDataSize.number = inputDataSize.number;
-		labelDataBucket.reset(new EasyCNN::DataBucket(inputDataSize));
+		labelDataBucket->reshape(labelDataSize);
+	}
+	else if (inputDataBucket->getSize().number != length)
+	{
+		//restore full batch after the last partial one, storage comes back from pool
+		auto inputDataSize = inputDataBucket->getSize();
+		inputDataSize.number = length;
+		inputDataBucket->reshape(inputDataSize);
+		auto labelDataSize = labelDataBucket->getSize();
+		labelDataSize.number = length;
+		labelDataBucket->reshape(labelDataSize);
 	}
 	//copy
 	const size_t sizePerImage = inputDataBucket->getSize()._3DSize();
@@ -368,6 +378,8 @@ static void train(const std::string& mnist_train_images_file,
 	network.setLossFunctor(std::make_shared<EasyCNN::CrossEntropyFunctor>());
 	network.setOptimizer(std::make_shared<EasyCNN::SGD>(learningRate));
 	network.setLearningRate(learningRate);
+	//last partial batch only changes shape
+	network.reserve(batch);
 	EasyCNN::logCritical("construct network done.");
 
 	float val_accuracy = 0.0f;
@@ -455,8 +467,10 @@ static void test(const std::string& mnist_test_images_file,
 
 	EasyCNN::logCritical("construct network begin...");
 	EasyCNN::NetWork network;
+	network.setInferenceOnly();
 	success = network.loadModel(modelFilePath);
 	assert(success);
+	network.reserve(batch);
 	EasyCNN::logCritical("construct network done.");
 
 	//train
@@ -502,6 +516,7 @@ static void test_single(const std::vector<std::pair<int, cv::Mat>>& samples, con
 
 	EasyCNN::logCritical("construct network begin...");
 	EasyCNN::NetWork network;
+	network.setInferenceOnly();
 	success = network.loadModel(modelFilePath);
 	assert(success);
 	EasyCNN::logCritical("construct network done.");
@@ -6,6 +6,17 @@ namespace EasyCNN
 {
 	class ActivationLayer : public Layer
 	{
+	protected:
+		virtual bool supportInplace() const override{ return true; }
+		virtual bool needOutputForBackward() const override{ return true; }
+		virtual WriteMode getOutputWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getDiffWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getGradientWriteMode() const override{ return WriteMode::Overwrite; }
+		//next and nextDiff read, prevDiff written
+		virtual LayerCost getBackwardCost(const size_t number) const override{
+			const double elements = (double)number*outputSize._3DSize();
+			return LayerCost(2.0*elements, 3.0*sizeof(float)*elements);
+		}
 	};
 
 	class SigmodLayer : public ActivationLayer
@@ -17,9 +28,9 @@ namespace EasyCNN
 	protected:
 		DECLARE_LAYER_TYPE;
 		virtual std::string getLayerType() const override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
 	};
 
 	class TanhLayer : public ActivationLayer
@@ -31,9 +42,9 @@ namespace EasyCNN
 	protected:
 		DECLARE_LAYER_TYPE;
 		virtual std::string getLayerType() const override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
 	};
 
 	class ReluLayer : public ActivationLayer
@@ -45,8 +56,8 @@ namespace EasyCNN
 	protected:
 		DECLARE_LAYER_TYPE;
 		virtual std::string getLayerType() const override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
 	};
 }
\ No newline at end of file
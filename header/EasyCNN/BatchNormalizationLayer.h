@@ -18,9 +18,9 @@ namespace EasyCNN
 		virtual void serializeFromString(const std::string content) override;		
 		virtual std::string getLayerType() const override;
 		virtual void solveInnerParams() override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
 	private:
 		
 	};
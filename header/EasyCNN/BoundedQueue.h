@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include "EasyCNN/Configure.h"
+
+namespace EasyCNN
+{
+	//ring of fixed capacity between one producer thread and one consumer thread, no lock.
+	//producer owns tail and consumer owns head, each reads the other's index only.
+	template<typename T>
+	class BoundedQueue
+	{
+	public:
+		explicit BoundedQueue(const size_t capacity)
+			:slots(capacity + 1), items(new T[capacity + 1]){}
+		//producer only, false when full
+		bool tryPush(const T& item)
+		{
+			const size_t tail = tailIdx.load(std::memory_order_relaxed);
+			const size_t next = (tail + 1) % slots;
+			if (next == headIdx.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			items[tail] = item;
+			tailIdx.store(next, std::memory_order_release);
+			return true;
+		}
+		//consumer only, false when empty
+		bool tryPop(T& item)
+		{
+			const size_t head = headIdx.load(std::memory_order_relaxed);
+			if (head == tailIdx.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			item = items[head];
+			headIdx.store((head + 1) % slots, std::memory_order_release);
+			return true;
+		}
+		size_t capacity() const
+		{
+			return slots - 1;
+		}
+	private:
+		BoundedQueue(const BoundedQueue&) = delete;
+		BoundedQueue& operator=(const BoundedQueue&) = delete;
+	private:
+		const size_t slots;
+		std::unique_ptr<T[]> items;
+		//indexes a cache line apart, producer and consumer don't invalidate each other
+		std::atomic<size_t> headIdx{ 0 };
+		char padding[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> tailIdx{ 0 };
+	};
+}
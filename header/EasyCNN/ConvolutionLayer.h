@@ -13,20 +13,57 @@ namespace EasyCNN
 			VALID = 0,
 			SAME = 1
 		};
+		//how forward is computed, results are the same
+		enum Algorithm
+		{
+			//loop over every output and kernel tap
+			DIRECT = 0,
+			//gemm of kernel and columns of input(im2col, or input itself for 1x1 and step 1)
+			GEMM = 1,
+			//3x3 kernels of step 1 only, kernel is transformed when weights change
+			WINOGRAD_2X2 = 2,
+			WINOGRAD_4X4 = 3,
+			//picked from shape when layer is solved
+			AUTO = 4,
+			//direct loops on channel blocked layout(NCHWc), a tile of outputs stays in registers.
+			//it runs in test phase of a finalized network which converts layout around it, GEMM elsewhere.
+			BLOCKED = 5
+		};
 	public:
 		ConvolutionLayer();
 		virtual ~ConvolutionLayer();	
 		void setParamaters(const ParamSize _kernelSize, const size_t _widthStep, const size_t _heightStep, 
 			const bool _enabledBias, const PaddingType _padddingType);
+		//set it before layer is added to network, which reserves workspace of algorithm
+		void setAlgorithm(const Algorithm _algorithm);
+		Algorithm getAlgorithm() const;
 	protected:
 		DECLARE_LAYER_TYPE;
 		virtual std::string serializeToString() const override;
 		virtual void serializeFromString(const std::string content) override;		
 		virtual std::string getLayerType() const override;
 		virtual void solveInnerParams() override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		virtual void releaseTrainingState() override;
+		virtual void onParamsChanged() override;
+		virtual LayerCost getForwardCost(const size_t number) const override;
+		virtual WriteMode getOutputWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getDiffWriteMode() const override{ return WriteMode::Accumulate; }
+		virtual WriteMode getGradientWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
+		virtual bool supportSplitBackward() const override{ return true; }
+		virtual void backwardDiff(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
+		virtual void backwardGradient(const TensorView& prev, const TensorView& next, const TensorView& nextDiff) override;
+		virtual bool supportBlockedLayout() const override{ return true; }
+		virtual bool preferBlockedLayout() const override;
+		virtual void setBlockedLayout(const bool blocked) override;
+		//gemm of pixels and kernel on NHWC layout, whatever the algorithm is
+		virtual bool supportNHWCLayout() const override{ return true; }
+		virtual void setNHWCLayout(const bool nhwc) override;
+	private:
+		Algorithm selectAlgorithm() const;
 	private:
 		ParamSize kernelSize;
 		size_t widthStep = 0;
@@ -35,6 +72,19 @@ namespace EasyCNN
 		std::shared_ptr<ParamBucket> kernelGradient;
 		bool enabledBias = false;
 		PaddingType padddingType = VALID;
+		Algorithm algorithm = AUTO;
+		//algorithm forward runs, AUTO is solved
+		Algorithm forwardAlgorithm = DIRECT;
+		//(t*t,kn,ic) of winograd, transformed by next forward when not ready
+		std::shared_ptr<ParamBucket> winogradKernel;
+		bool winogradKernelReady = false;
+		//(ceil(kn/8),ic,kh,kw*8) and padded bias of blocked layout, transformed by next forward when not ready
+		std::shared_ptr<ParamBucket> blockedKernel;
+		std::shared_ptr<ParamBucket> blockedBias;
+		bool blockedKernelReady = false;
+		//(kn,kh,kw,ic) of NHWC layout, transformed by next forward when not ready
+		std::shared_ptr<ParamBucket> nhwcKernel;
+		bool nhwcKernelReady = false;
 		std::shared_ptr<ParamBucket> bias;
 		std::shared_ptr<ParamBucket> biasGradient;
 	};
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <initializer_list>
+#include "EasyCNN/Configure.h"
+
+namespace EasyCNN
+{
+	//work of one pass of a layer(or one parallel region), estimated from its sizes
+	struct LayerCost
+	{
+	public:
+		LayerCost() = default;
+		LayerCost(const double _flops, const double _bytes)
+			:flops(_flops), bytes(_bytes){}
+		double flops = 0.0;
+		//memory read and written
+		double bytes = 0.0;
+	};
+	//speed of host. fork-join of p threads costs forkJoinNanoseconds + p*perThreadNanoseconds,
+	//a part of one thread runs at the lower of flops and bytes rate.
+	//defaults are a modest core, calibrate_parallel_cost measures them.
+	struct ParallelCostModel
+	{
+		double forkJoinNanoseconds = 2000.0;
+		double perThreadNanoseconds = 500.0;
+		double flopsPerNanosecond = 2.0;
+		double bytesPerNanosecond = 8.0;
+	};
+	//no parallel_for may be running
+	void set_parallel_cost_model(const ParallelCostModel& model);
+	ParallelCostModel get_parallel_cost_model();
+	//measure fork-join of current backend and kernel speed of one thread, then use them.
+	//takes tens of milliseconds, call it once at startup.
+	ParallelCostModel calibrate_parallel_cost();
+	//time of cost on one thread
+	double get_serial_nanoseconds(const LayerCost& cost);
+	//threads which finish work soonest, fork-join included. 1 : run serially.
+	size_t get_parallel_threads_for(const LayerCost& cost);
+	//grain of a range of dims flattened(outer first) : one part per thread of get_parallel_threads_for.
+	//outermost dims which give every thread a part are split, inner ones are kept whole
+	//(e.g. batch 64 splits samples, batch 1 splits channels). result >= cells means serial.
+	size_t get_parallel_grain(std::initializer_list<size_t> dims, const LayerCost& cost);
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+#include "EasyCNN/Configure.h"
+
+namespace EasyCNN
+{
+	//numa nodes(sockets) and their cpus, read once from system.
+	//machine without numa information is one node of all cpus.
+	size_t get_numa_node_count();
+	const std::vector<size_t>& get_numa_node_cpus(const size_t node);
+	size_t get_numa_node_of_cpu(const size_t cpu);
+	//cpu which runs calling thread now, 0 if unknown
+	size_t get_current_cpu();
+	//bind calling thread to one cpu, false if system doesn't support it
+	bool pin_current_thread(const size_t cpu);
+	//calling thread may run on cpus allowed to process at startup again
+	bool unpin_current_thread();
+}
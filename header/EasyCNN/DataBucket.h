@@ -3,9 +3,17 @@
 #include "EasyCNN/Configure.h"
 #include "EasyCNN/EasyLogger.h"
 #include "EasyCNN/EasyAssert.h"
+#include "EasyCNN/MemoryPool.h"
 
 namespace EasyCNN
 {
+	//order of elements in memory, sizes are logical(n,c,h,w) in every layout.
+	//NHWC keeps channels of a pixel together(interleaved pixels of image decoders, tensorflow).
+	enum class Layout
+	{
+		NCHW,
+		NHWC
+	};
 	struct DataSize
 	{
 	public:
@@ -28,23 +36,117 @@ namespace EasyCNN
 		inline size_t getIndex(const size_t ic, const size_t ih, const size_t iw) const{
 			return ic*height*width + ih*width + iw;
 		}
+		inline size_t getIndex(const Layout layout, const size_t in, const size_t ic, const size_t ih, const size_t iw) const{
+			return layout == Layout::NCHW ? getIndex(in, ic, ih, iw) : ((in*height + ih)*width + iw)*channels + ic;
+		}
 		size_t number = 0;
 		size_t channels = 0;
 		size_t width = 0;
 		size_t height = 0;
 	};
+	//non-owning view of 4D tensor : pointer, shape, layout and strides(in floats).
+	//it is cheap to copy and slice, storage must be kept alive by its owner while view is used.
+	//strides follow layout : stride of width is 1 on NCHW, stride of channel is 1 on NHWC.
+	struct TensorView
+	{
+	public:
+		TensorView() = default;
+		TensorView(float* _data, const DataSize _size)
+			:data(_data), size(_size), numberStride(_size._3DSize()), channelStride(_size._2DSize()), heightStride(_size.width){}
+		TensorView(float* _data, const DataSize _size, const Layout _layout)
+			:data(_data), size(_size), numberStride(_size._3DSize()),
+			channelStride(_layout == Layout::NCHW ? _size._2DSize() : 1),
+			heightStride(_layout == Layout::NCHW ? _size.width : _size.width*_size.channels),
+			widthStride(_layout == Layout::NCHW ? 1 : _size.channels), layout(_layout){}
+		TensorView(float* _data, const DataSize _size, const size_t _numberStride, const size_t _channelStride, const size_t _heightStride)
+			:data(_data), size(_size), numberStride(_numberStride), channelStride(_channelStride), heightStride(_heightStride){}
+		TensorView(float* _data, const DataSize _size, const size_t _numberStride, const size_t _channelStride, const size_t _heightStride,
+			const size_t _widthStride, const Layout _layout)
+			:data(_data), size(_size), numberStride(_numberStride), channelStride(_channelStride), heightStride(_heightStride),
+			widthStride(_widthStride), layout(_layout){}
+		inline float* getData() const { return data; }
+		inline DataSize getSize() const { return size; }
+		inline Layout getLayout() const { return layout; }
+		inline float* getSampleData(const size_t in) const { return data + in*numberStride; }
+		inline size_t getIndex(const size_t in, const size_t ic, const size_t ih, const size_t iw) const{
+			return in*numberStride + ic*channelStride + ih*heightStride + iw*widthStride;
+		}
+		inline size_t getIndex(const size_t ic, const size_t ih, const size_t iw) const{
+			return ic*channelStride + ih*heightStride + iw*widthStride;
+		}
+		//samples [start,start+count), no copy
+		inline TensorView slice(const size_t start, const size_t count) const{
+			DataSize sliceSize = size;
+			sliceSize.number = count;
+			return TensorView(getSampleData(start), sliceSize, numberStride, channelStride, heightStride, widthStride, layout);
+		}
+		//channels [start,start+count) of every sample, no copy
+		inline TensorView sliceChannels(const size_t start, const size_t count) const{
+			DataSize sliceSize = size;
+			sliceSize.channels = count;
+			return TensorView(data + start*channelStride, sliceSize, numberStride, channelStride, heightStride, widthStride, layout);
+		}
+		//rows [start,start+count) of every sample, no copy
+		inline TensorView sliceRows(const size_t start, const size_t count) const{
+			DataSize sliceSize = size;
+			sliceSize.height = count;
+			return TensorView(data + start*heightStride, sliceSize, numberStride, channelStride, heightStride, widthStride, layout);
+		}
+		//every sample is one continuous block in order of _layout, kernels of NCHW use the default
+		inline bool isSampleDense(const Layout _layout = Layout::NCHW) const {
+			if (layout != _layout)
+			{
+				return false;
+			}
+			return layout == Layout::NCHW ? (channelStride == size._2DSize() && heightStride == size.width && widthStride == 1) :
+				(channelStride == 1 && widthStride == size.channels && heightStride == size.width*size.channels);
+		}
+		//whole tensor is one continuous block
+		inline bool isDense(const Layout _layout = Layout::NCHW) const {
+			return isSampleDense(_layout) && (numberStride == size._3DSize() || size.number <= 1);
+		}
+		float* data = nullptr;
+		DataSize size;
+		size_t numberStride = 0;
+		size_t channelStride = 0;
+		size_t heightStride = 0;
+		size_t widthStride = 1;
+		Layout layout = Layout::NCHW;
+	};
 	class DataBucket
 	{
 	public:
 		DataBucket(const DataSize _size);
+		DataBucket(const DataSize _size, const std::shared_ptr<MemoryPool> _pool);
+		//view over storage owned by others (e.g. planned slab), it can't grow
+		DataBucket(const DataSize _size, const std::shared_ptr<float> _data);
+		//non-owning view over caller's memory, caller keeps it alive while it is used
+		DataBucket(const DataSize _size, float* _userData);
 		virtual ~DataBucket();		
 	public:
 		DataSize getSize() const;
+		//tag of how data is ordered, NCHW by default. it doesn't move data.
+		Layout getLayout() const;
+		void setLayout(const Layout _layout);
 		std::shared_ptr<float> getData() const;
+		//view for kernels in layout of this bucket, no reference count is touched
+		TensorView getView() const;
 		void fillData(const float item);
+		//data and layout
 		void cloneTo(DataBucket& target);
+		//change shape, storage is reallocated only when it grows beyond capacity
+		void reshape(const DataSize _size);
+		//make sure storage holds at least _capacity floats, contents are kept
+		void reserve(const size_t _capacity);
+		size_t getCapacity() const;
+		//pool of storage, null for views
+		std::shared_ptr<MemoryPool> getMemoryPool() const;
 	private:
 		DataSize size;
+		Layout layout = Layout::NCHW;
+		//floats of storage, may be greater than size.totalSize()
+		size_t capacity = 0;
+		std::shared_ptr<MemoryPool> pool;
 		std::shared_ptr<float> data;
 	};
 }
\ No newline at end of file
@@ -5,7 +5,12 @@
 #include "EasyCNN/EasyLogger.h"
 #include "EasyCNN/EasyAssert.h"
 #include "EasyCNN/CommonTools.h"
+#include "EasyCNN/ParallelBackend.h"
+#include "EasyCNN/CostModel.h"
 #include "EasyCNN/ThreadPool.h"
+#include "EasyCNN/CpuTopology.h"
+#include "EasyCNN/MemoryPool.h"
+#include "EasyCNN/Workspace.h"
 #include "EasyCNN/MathFunctions.h"
 //layers
 #include "EasyCNN/Layer.h"
@@ -19,5 +24,7 @@
 #include "EasyCNN/SoftmaxLayer.h"
 #include "EasyCNN/DropoutLayer.h"
 #include "EasyCNN/BatchNormalizationLayer.h"
+#include "EasyCNN/LayoutLayer.h"
 //network
 #include "EasyCNN/NetWork.h"
+#include "EasyCNN/StreamPipeline.h"
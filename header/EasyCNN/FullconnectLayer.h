@@ -18,9 +18,18 @@ namespace EasyCNN
 		virtual void serializeFromString(const std::string content) override;		
 		virtual std::string getLayerType() const override;
 		virtual void solveInnerParams() override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		virtual void releaseTrainingState() override;
+		virtual LayerCost getForwardCost(const size_t number) const override;
+		virtual WriteMode getOutputWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getDiffWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getGradientWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
+		virtual bool supportSplitBackward() const override{ return true; }
+		virtual void backwardDiff(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
+		virtual void backwardGradient(const TensorView& prev, const TensorView& next, const TensorView& nextDiff) override;
 	private:
 		ParamSize outMapSize;
 		std::shared_ptr<ParamBucket> weight;
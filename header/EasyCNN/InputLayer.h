@@ -15,8 +15,14 @@ namespace EasyCNN
 		virtual std::string serializeToString() const override;
 		virtual void serializeFromString(const std::string content) override;
 		virtual std::string getLayerType() const override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		//output is the caller's input bucket itself
+		virtual bool supportInplace() const override{ return true; }
+		//diff of input is never used
+		virtual WriteMode getOutputWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getDiffWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getGradientWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
 	};
 }
\ No newline at end of file
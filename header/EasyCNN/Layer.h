@@ -5,6 +5,7 @@
 #include "EasyCNN/Configure.h"
 #include "EasyCNN/DataBucket.h"
 #include "EasyCNN/ParamBucket.h"
+#include "EasyCNN/CostModel.h"
 
 #define DECLARE_LAYER_TYPE static const std::string layerType;
 #define DEFINE_LAYER_TYPE(class_type,type_string) const std::string class_type::layerType = type_string; 
@@ -18,9 +19,18 @@ namespace EasyCNN
 		Train,
 		Test
 	};
+	//how layer writes a buffer : every element is overwritten,
+	//or results are added to it and executor must clear it before.
+	enum class WriteMode
+	{
+		Overwrite,
+		Accumulate
+	};
 	class Layer
 	{
 		FRIEND_WITH_NETWORK
+		//runs forward of layers in stages
+		friend class StreamPipeline;
 	public:
 		inline DataSize getInputBucketSize() const{ return inputSize; }
 		inline DataSize getOutputBucketSize() const{ return outputSize; }
@@ -38,15 +48,65 @@ namespace EasyCNN
 		inline std::vector<std::shared_ptr<ParamBucket>> getDiffData() const { return gradients; }
 		//params
 		inline std::vector<std::shared_ptr<ParamBucket>> getParamData() const { return params; }
+		//params were changed outside of layer(optimizer), layer drops what it derived from them
+		virtual void onParamsChanged(){/*nop*/}
 		//size
 		inline void setInputBucketSize(const DataSize size){ inputSize = size; }		
 		inline void setOutpuBuckerSize(const DataSize size){ outputSize = size; }		
+		//storage of params and inner buffers, set by network before solveInnerParams
+		inline void setMemoryPool(const std::shared_ptr<MemoryPool> pool){ memoryPool = pool; }
+		inline std::shared_ptr<MemoryPool> getMemoryPool() const{ return memoryPool; }
+		//scratch bytes one thread needs in forward/backward(get_workspace), set by solveInnerParams
+		inline void setWorkspaceSize(const size_t bytes){ workspaceSize = bytes; }
+		inline size_t getWorkspaceSize() const{ return workspaceSize; }
 		//solve params
 		virtual void solveInnerParams(){ outputSize = inputSize; }
-		//data flow		
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) = 0;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next, 
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) = 0;
+		//per-batch buffers of layer must hold maxBatch samples without reallocating
+		virtual void reserve(const size_t /*maxBatch*/){/*nop*/}
+		//inference only from now : free gradients and other train phase buffers(subclass frees its own).
+		//train phase buffers are allocated by solveInnerParams in train phase only.
+		virtual void releaseTrainingState(){ phase = Phase::Test; gradients.clear(); }
+		//work of forward over number samples from sizes, parallel regions pick threads and split by it.
+		//default is element-wise : one flop per output, input read and output written.
+		virtual LayerCost getForwardCost(const size_t number) const{
+			return LayerCost((double)number*outputSize._3DSize(), (double)sizeof(float)*number*(inputSize._3DSize() + outputSize._3DSize()));
+		}
+		//work of one parallel region of backward(prevDiff or gradient of weights)
+		virtual LayerCost getBackwardCost(const size_t number) const{ return getForwardCost(number); }
+		//inplace : next may share storage with prev(and prevDiff with nextDiff).
+		//layer which returns true must be element-wise, and its backward must not read prev.
+		virtual bool supportInplace() const{ return false; }
+		//backward reads next, so next can't be overwritten by an inplace layer behind.
+		virtual bool needOutputForBackward() const{ return false; }
+		//write mode of next in forward, prevDiff and gradients in backward.
+		//layer never clears these buffers itself, inplace layer must overwrite.
+		virtual WriteMode getOutputWriteMode() const{ return WriteMode::Accumulate; }
+		virtual WriteMode getDiffWriteMode() const{ return WriteMode::Accumulate; }
+		virtual WriteMode getGradientWriteMode() const{ return WriteMode::Accumulate; }
+		//data flow, views stay valid during the call only		
+		virtual void forward(const TensorView& prev, const TensorView& next) = 0;
+		virtual void backward(const TensorView& prev, const TensorView& next, 
+			const TensorView& prevDiff, const TensorView& nextDiff) = 0;
+		//backward in two independent parts network may run at the same time : prevDiff only, gradients only.
+		//layer which returns true implements both, and backward still does the whole.
+		virtual bool supportSplitBackward() const{ return false; }
+		virtual void backwardDiff(const TensorView& /*prev*/, const TensorView& /*next*/,
+			const TensorView& /*prevDiff*/, const TensorView& /*nextDiff*/){/*nop*/}
+		virtual void backwardGradient(const TensorView& /*prev*/, const TensorView& /*next*/, const TensorView& /*nextDiff*/){/*nop*/}
+		//NCHWc : in test phase of planned memory, network keeps activations of a run of such layers channel blocked
+		//(blocked_size) and converts them at edges of run. element-wise(inplace) layers inside of run don't mind layout.
+		//layer which returns true runs forward on blocked prev and next after setBlockedLayout(true), its sizes stay as solved.
+		virtual bool supportBlockedLayout() const{ return false; }
+		//layer is faster on blocked layout, every run has one of these at least
+		virtual bool preferBlockedLayout() const{ return false; }
+		virtual void setBlockedLayout(const bool blocked){ blockedLayout = blocked; }
+		inline bool isBlockedLayout() const{ return blockedLayout; }
+		//NHWC : in test phase of planned memory, caller's NHWC input stays channel last through a run of such layers
+		//from the first one(element-wise layers inside of run don't mind layout), network converts it to NCHW at end of run.
+		//layer which returns true runs forward on NHWC prev and next after setNHWCLayout(true), its sizes are the same.
+		virtual bool supportNHWCLayout() const{ return false; }
+		virtual void setNHWCLayout(const bool nhwc){ nhwcLayout = nhwc; }
+		inline bool isNHWCLayout() const{ return nhwcLayout; }
 	protected:
 		//subclass must add all gradient to gradients
 		std::vector<std::shared_ptr<DataBucket>> gradients;
@@ -55,6 +115,12 @@ namespace EasyCNN
 		Phase phase = Phase::Train;
 		DataSize inputSize;
 		DataSize outputSize;
+		size_t workspaceSize = 0;
+		//next of forward is channel blocked(prev too, except for conversion of layout)
+		bool blockedLayout = false;
+		//next of forward is NHWC(prev too, except for conversion of layout)
+		bool nhwcLayout = false;
+		std::shared_ptr<MemoryPool> memoryPool = MemoryPool::defaultPool();
 		float learningRate = 0.1f;
 	};
 }
@@ -0,0 +1,33 @@
+#pragma once
+#include "EasyCNN/Configure.h"
+#include "EasyCNN/Layer.h"
+
+namespace EasyCNN
+{
+	//converts activations between NCHW and channel blocked layout(blocked_size), or NHWC to NCHW. network inserts it
+	//at edges of layers which run on other layouts in test phase, it is never saved to model.
+	class LayoutLayer : public Layer
+	{
+		FRIEND_WITH_NETWORK
+	public:
+		enum Direction
+		{
+			ToBlocked = 0,
+			FromBlocked = 1,
+			FromNHWC = 2
+		};
+	public:
+		explicit LayoutLayer(const Direction _direction);
+		virtual ~LayoutLayer();
+		Direction getDirection() const;
+	protected:
+		DECLARE_LAYER_TYPE;
+		virtual std::string getLayerType() const override;
+		virtual WriteMode getOutputWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
+	private:
+		Direction direction = ToBlocked;
+	};
+}
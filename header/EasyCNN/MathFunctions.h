@@ -1,4 +1,5 @@
 #pragma once
+#include "EasyCNN/DataBucket.h"
 
 namespace EasyCNN
 {
@@ -28,14 +29,96 @@ namespace EasyCNN
 	void relu(const float* x, float* y, const size_t len);
 	void df_relu(const float* x, float* y, const size_t len);
 
-	//
-	void fullconnect(const float* input, const float* weight, const float* bias,float* output,
-		const size_t n, const size_t is, const size_t os);
+	//dx = f'(y)*dy, y is output of activation. dx may be the same as dy(inplace)
+	void sigmoid_backward(const float* y, const float* dy, float* dx, const size_t len);
+	void tanh_backward(const float* y, const float* dy, float* dx, const size_t len);
+	void relu_backward(const float* y, const float* dy, float* dx, const size_t len);
 
-	//mode: 0-validate,1-same
-	void convolution2d(const float* input, const float* kernel, const float* bias, float* output,
-		const size_t in, const size_t ic, const size_t iw, const size_t ih,
-		const size_t kn, const size_t kw, const size_t kh, const size_t kws, const size_t khs,
-		const size_t ow, const size_t oh,
-		const int mode);
+	//tensor versions, shapes must be equal and every sample must be dense(batch stride is free)
+	void copy(const TensorView& x, const TensorView& y);
+	void sigmoid(const TensorView& x, const TensorView& y);
+	void tanh(const TensorView& x, const TensorView& y);
+	void relu(const TensorView& x, const TensorView& y);
+	void sigmoid_backward(const TensorView& y, const TensorView& dy, const TensorView& dx);
+	void tanh_backward(const TensorView& y, const TensorView& dy, const TensorView& dx);
+	void relu_backward(const TensorView& y, const TensorView& dy, const TensorView& dx);
+
+	//c(m,n) = alpha*op(a)(m,k)*op(b)(k,n) + beta*c, op(x) is x or x^T. matrices are row major,
+	//lda/ldb/ldc are row strides as stored. beta 0 : c is not read.
+	//blocks are packed into first sgemm_workspace_size bytes of thread's workspace, callers keep their scratch after it.
+	void sgemm(const bool transA, const bool transB, const size_t m, const size_t n, const size_t k,
+		const float alpha, const float* a, const size_t lda, const float* b, const size_t ldb,
+		const float beta, float* c, const size_t ldc);
+	size_t sgemm_workspace_size(const size_t m, const size_t n, const size_t k);
+	//sgemm with c split in tiles over threads of parallel backend(the only parallel function here)
+	void parallel_sgemm(const bool transA, const bool transB, const size_t m, const size_t n, const size_t k,
+		const float alpha, const float* a, const size_t lda, const float* b, const size_t ldb,
+		const float beta, float* c, const size_t ldc);
+	//microkernel in use, avx2/fma is picked at runtime when cpu has it. false turns it off(e.g. to compare).
+	//returns whether simd kernel is used.
+	bool set_sgemm_simd(const bool enabled);
+	const char* get_sgemm_kernel();
+
+	//output(n,os) = input(n,is) * weight(os,is)^T + bias(os), bias may be null
+	void fullconnect(const TensorView& input, const float* weight, const float* bias, const TensorView& output);
+
+	//kernel is (kn,ic,kh,kw), bias may be null. mode: 0-validate,1-same
+	void convolution2d(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode);
+	//output rows [rowStart,rowStop) only
+	void convolution2d(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop);
+	//same as convolution2d, as gemm of kernel(kn,ic*kh*kw) and columns(ic*kh*kw,pixels) of output pixels :
+	//1x1 kernels of step 1 read input as columns, others gather them(im2col) into thread's workspace.
+	void convolution2d_gemm(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode);
+	void convolution2d_gemm(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop);
+	//workspace of convolution2d_gemm on rows of one sample
+	size_t convolution2d_gemm_workspace_size(const DataSize& inputSize, const DataSize& kernelSize, const DataSize& outputSize,
+		const size_t kws, const size_t khs, const int mode);
+	//same as convolution2d of 3x3 kernels and step 1, by winograd F(m x m,3x3) with m 2 or 4 : transformed tiles
+	//of input are multiplied with kernel transformed once before(winograd_kernel_size floats), one gemm per tile position.
+	size_t winograd_kernel_size(const size_t m, const DataSize& kernelSize);
+	void winograd_transform_kernel(const size_t m, const TensorView& kernel, float* transformedKernel);
+	//output rows [rowStart,rowStop), rowStart is on a tile(multiple of m). scratch is in thread's workspace.
+	void convolution2d_winograd(const size_t m, const TensorView& input, const float* transformedKernel, const float* bias,
+		const TensorView& output, const int mode, const size_t rowStart, const size_t rowStop);
+	//workspace of convolution2d_winograd on rows of one sample
+	size_t convolution2d_winograd_workspace_size(const size_t m, const DataSize& inputSize, const DataSize& outputSize);
+
+	//NCHWc layout : channels in blocks of CHANNEL_BLOCK, a block is (h,w,CHANNEL_BLOCK) so channels of a pixel are one vector.
+	//tensor(n,c,h,w) is stored as DataSize(n,ceil(c/CHANNEL_BLOCK),h,w*CHANNEL_BLOCK), missing channels are 0.
+	const size_t CHANNEL_BLOCK = 8;
+	DataSize blocked_size(const DataSize& size);
+	void to_blocked(const TensorView& input, const TensorView& output);
+	void from_blocked(const TensorView& input, const TensorView& output);
+	//kernel(kn,ic,kh,kw) to blocks of output channels(ceil(kn/CHANNEL_BLOCK),ic,kh,kw*CHANNEL_BLOCK),
+	//bias to ceil(kn/CHANNEL_BLOCK)*CHANNEL_BLOCK floats(bias may be null, blockedBias too)
+	DataSize blocked_kernel_size(const DataSize& kernelSize);
+	void blocked_transform_kernel(const TensorView& kernel, const float* bias, const TensorView& blockedKernel, float* blockedBias);
+	//convolution2d of blocked tensors and kernel, output rows [rowStart,rowStop). a tile of output pixels is kept in registers,
+	//only real input channels(channels of kernel) are read.
+	void convolution2d_blocked(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop);
+	//pooling of PoolingLayer on blocked tensors, type: 0-max,1-mean
+	void pooling2d_blocked(const TensorView& input, const TensorView& output, const int type,
+		const size_t kw, const size_t kh, const size_t ws, const size_t hs, const size_t rowStart, const size_t rowStop);
+
+	//NHWC layout : tensor(n,c,h,w) of the same DataSize is stored as (n,h,w,c), every sample must be dense.
+	void nchw_to_nhwc(const TensorView& input, const TensorView& output);
+	void nhwc_to_nchw(const TensorView& input, const TensorView& output);
+	//convolution2d of NHWC tensors and kernel((kn,kh,kw,ic) : nchw_to_nhwc of kernel), output rows [rowStart,rowStop).
+	//gemm of pixels(rows*ow,kh*kw*ic) and kernel^T writes NHWC output as it is : 1x1 kernels of step 1 read input
+	//as pixels, others gather them into thread's workspace(a tap of a pixel is one copy of ic floats).
+	//one gemm per block of convolution2d_nhwc_block_rows rows, rowStart and rowStop(unless it's the last row) are on blocks.
+	void convolution2d_nhwc(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop);
+	size_t convolution2d_nhwc_block_rows(const DataSize& outputSize);
+	//workspace of convolution2d_nhwc on rows of one sample
+	size_t convolution2d_nhwc_workspace_size(const DataSize& inputSize, const DataSize& kernelSize, const DataSize& outputSize,
+		const size_t kws, const size_t khs, const int mode);
+	//pooling of PoolingLayer on NHWC tensors, type: 0-max,1-mean
+	void pooling2d_nhwc(const TensorView& input, const TensorView& output, const int type,
+		const size_t kw, const size_t kh, const size_t ws, const size_t hs, const size_t rowStart, const size_t rowStop);
 };
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+#include <vector>
+#include "EasyCNN/Configure.h"
+
+namespace EasyCNN
+{
+	//assign offsets inside one slab to tensors with known lifetime,
+	//tensors whose live ranges don't overlap may share the same bytes.
+	class MemoryPlanner
+	{
+	public:
+		//live range is [firstUse,lastUse] in step index, return id of tensor
+		size_t addTensor(const size_t bytes, const int firstUse, const int lastUse);
+		//greedy by size, return total bytes of slab
+		size_t solve();
+		size_t getOffset(const size_t id) const;
+		size_t getSlabSize() const;
+		//sum of all tensors, the footprint without planning
+		size_t getNaiveSize() const;
+	private:
+		struct TensorInfo
+		{
+			size_t bytes;
+			int firstUse;
+			int lastUse;
+			size_t offset;
+		};
+		std::vector<TensorInfo> tensors;
+		size_t slabSize = 0;
+	};
+}
\ No newline at end of file
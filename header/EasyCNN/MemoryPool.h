@@ -0,0 +1,97 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unordered_map>
+#include "EasyCNN/Configure.h"
+
+namespace EasyCNN
+{
+	//every block handed out by MemoryPool is aligned to this boundary (cache line, AVX-512 friendly)
+	const size_t MEMORY_ALIGNMENT = 64;
+	//size of huge page(x86-64 and aarch64 default)
+	const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+	//how large blocks are backed by huge pages, to save TLB misses of big weights and activations.
+	//Transparent : 2M aligned block with madvise(MADV_HUGEPAGE).
+	//Explicit : mmap with MAP_HUGETLB from reserved pool of system, falls back to Transparent.
+	//both fall back to normal pages when system doesn't support them.
+	enum class HugePageMode
+	{
+		Disabled,
+		Transparent,
+		Explicit
+	};
+
+	//arena of aligned blocks, recycled by size class.
+	//blocks given back with deallocate are cached and handed out again to the next request of the same class,
+	//so the steady state of train/test does not touch the system heap at all.
+	class MemoryPool
+	{
+	public:
+		MemoryPool();
+		virtual ~MemoryPool();
+		//shared pool used by DataBucket when no pool is given
+		static std::shared_ptr<MemoryPool> defaultPool();
+		//round request up to its size class (bytes)
+		static size_t getSizeClass(const size_t bytes);
+	public:
+		void* allocate(const size_t bytes);
+		void deallocate(void* ptr, const size_t bytes);
+		//give all cached blocks back to system
+		void trim();
+		//blocks of at least thresholdBytes follow mode, cached blocks are released
+		void setHugePagePolicy(const HugePageMode mode, const size_t thresholdBytes = HUGE_PAGE_SIZE);
+		HugePageMode getHugePageMode() const;
+		//statistics
+		size_t getCachedBytes() const;
+		size_t getSystemAllocCount() const;
+		//bytes of live blocks mapped from reserved huge pages or advised to THP successfully
+		size_t getHugePageBytes() const;
+	private:
+		MemoryPool(const MemoryPool&) = delete;
+		MemoryPool& operator=(const MemoryPool&) = delete;
+		struct HugeBlock
+		{
+			size_t length = 0;
+			//mmap-ed, else aligned malloc
+			bool mapped = false;
+			//MAP_HUGETLB or madvise succeeded
+			bool backed = false;
+		};
+		void* systemAllocate(const size_t sizeClass);
+		void systemFree(void* ptr);
+	private:
+		mutable std::mutex poolMutex;
+		//size class => free blocks
+		std::unordered_map<size_t, std::vector<void*>> freeBlocks;
+		size_t cachedBytes = 0;
+		size_t systemAllocCount = 0;
+		HugePageMode hugePageMode = HugePageMode::Disabled;
+		size_t hugePageThreshold = HUGE_PAGE_SIZE;
+		std::unordered_map<void*, HugeBlock> hugeBlocks;
+		size_t hugePageBytes = 0;
+	};
+
+	//std allocator over pool, e.g. for control block of shared_ptr, so it doesn't touch system heap after warm up.
+	//every copy holds pool, so pool outlives what was allocated from it.
+	template<typename T>
+	struct PoolAllocator
+	{
+		typedef T value_type;
+		explicit PoolAllocator(const std::shared_ptr<MemoryPool>& _pool) :pool(_pool){}
+		template<typename U>
+		PoolAllocator(const PoolAllocator<U>& other) : pool(other.pool){}
+		T* allocate(const size_t n){ return static_cast<T*>(pool->allocate(n*sizeof(T))); }
+		void deallocate(T* ptr, const size_t n){ pool->deallocate(ptr, n*sizeof(T)); }
+		template<typename U>
+		bool operator==(const PoolAllocator<U>& other) const{ return pool == other.pool; }
+		template<typename U>
+		bool operator!=(const PoolAllocator<U>& other) const{ return pool != other.pool; }
+		std::shared_ptr<MemoryPool> pool;
+	};
+
+	//float buffer of at least len elements from pool, the block goes back to pool when last owner released.
+	//reference count lives in pool as well.
+	std::shared_ptr<float> make_pooled_buffer(const std::shared_ptr<MemoryPool>& pool, const size_t len);
+}
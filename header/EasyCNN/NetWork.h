@@ -1,18 +1,30 @@
 #pragma once
 #include <memory>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 #include "EasyCNN/Configure.h"
 #include "EasyCNN/Layer.h"
 #include "EasyCNN/LossFunction.h"
 #include "EasyCNN/Optimizer.h"
+#include "EasyCNN/TaskScheduler.h"
 
 namespace EasyCNN
 {
 	class NetWork
 	{
         FRIEND_WITH_LAYER
+		//runs layers of this network in stages
+		friend class StreamPipeline;
 	public:
 		NetWork();
+		//not copyable. moving runs requests submitted to other first, other is left empty.
+		//caller must not move a network which a StreamPipeline runs.
+		NetWork(NetWork&& other);
 		virtual ~NetWork();
 	public:
 		//common
@@ -20,7 +32,40 @@ namespace EasyCNN
 		float getLoss(const std::shared_ptr<DataBucket> labelDataBucket, const std::shared_ptr<DataBucket> outputDataBucket);
 		//test only!
 		bool loadModel(const std::string& modelFile);
+		//serving : gradients, diffs, dropout mask, pooling argmax and optimizer state are never allocated(call it before loadModel),
+		//or released if network was trained. only weights and planned activations remain, trainBatch is not allowed.
+		void setInferenceOnly();
+		//network is complete : switch to test phase and plan activation memory
+		void finalize();
+		//storage for batches up to maxBatch, smaller batches only change shape and never allocate
+		void reserve(const size_t maxBatch);
+		//large weights and activations of this network on huge pages, call it before adding layers(or loadModel)
+		void setHugePagePolicy(const HugePageMode mode, const size_t thresholdBytes = HUGE_PAGE_SIZE);
+		//test phase of planned memory(finalize) runs convolution and pooling on channel blocked layout(NCHWc)
+		//where convolutions prefer it, layout is converted at edges of them. buckets of caller never see it.
+		void setBlockedLayout(const bool enabled);
+		//input may be NHWC(DataBucket::setLayout), e.g. interleaved pixels of image decoders. test phase of planned memory
+		//runs convolution, pooling and element-wise layers on it as it is and converts it to NCHW before first other layer,
+		//output is tagged with its layout. false, or other phases : NHWC input is converted to NCHW at once.
+		void setNHWCLayout(const bool enabled);
+		//threads of this network : own(right-sized) or shared with other networks, may be resized live.
+		//null : TaskScheduler::current(), the default scheduler unless caller is bound to another one
+		void setScheduler(std::shared_ptr<TaskScheduler> scheduler);
+		std::shared_ptr<TaskScheduler> getScheduler() const;
+		//input is not copied but referenced until next call.
+		//output is caller's own until it is dropped, then network recycles its bucket for next outputs.
 		std::shared_ptr<DataBucket> testBatch(const std::shared_ptr<DataBucket> inputDataBucket);
+		//output is written to caller's bucket directly (e.g. a view over caller's memory)
+		void testBatch(const std::shared_ptr<DataBucket> inputDataBucket, std::shared_ptr<DataBucket> outputDataBucket);
+		//asynchronous testBatch : request is queued and run by a thread of this network in order of submit,
+		//caller keeps working meanwhile. input must not change until its output is ready.
+		//submit waits only when maxPending requests are queued or running(back-pressure).
+		std::future<std::shared_ptr<DataBucket>> submit(const std::shared_ptr<DataBucket> inputDataBucket);
+		//callback runs on thread of network with output, null if inference failed. it must not throw.
+		void submit(const std::shared_ptr<DataBucket> inputDataBucket, std::function<void(std::shared_ptr<DataBucket>)> callback);
+		void setMaxPending(const size_t maxPending);
+		//requests queued or running
+		size_t getPendingCount() const;
 		//train only!
 		void setInputSize(const DataSize size);
 		void setLossFunctor(std::shared_ptr<LossFunctor> lossFunctor);
@@ -31,6 +76,36 @@ namespace EasyCNN
 			const std::shared_ptr<DataBucket> labelDataBucket);
 		bool saveModel(const std::string& modelFile);
 	private:
+		//request of submit, promise or callback
+		struct AsyncRequest
+		{
+			std::shared_ptr<DataBucket> input;
+			std::shared_ptr<std::promise<std::shared_ptr<DataBucket>>> promise;
+			std::function<void(std::shared_ptr<DataBucket>)> callback;
+		};
+		//buckets of outputs dropped by callers, outputs given out keep it alive
+		struct OutputCache
+		{
+			std::mutex mutex;
+			std::vector<std::shared_ptr<DataBucket>> idle;
+		};
+		//locks, thread and queue of submit, held by pointer so network stays movable
+		struct AsyncState
+		{
+			//one batch runs at a time : requests of submit and calls of testBatch/trainBatch
+			std::mutex runMutex;
+			//requests of submit, thread starts with first one
+			std::thread thread;
+			std::mutex mutex;
+			std::condition_variable requestCondition;
+			std::condition_variable spaceCondition;
+			std::deque<AsyncRequest> requests;
+			size_t pendingCount = 0;
+			size_t maxPending = 16;
+			bool stop = false;
+			//outputs of testBatch and submit
+			std::shared_ptr<OutputCache> outputs = std::make_shared<OutputCache>();
+		};
 		//common
 		void setPhase(Phase phase);
 		Phase getPhase() const;
@@ -38,16 +113,60 @@ namespace EasyCNN
 		std::string decrypt(const std::string& content);
 	private:
 		//common
-		std::shared_ptr<DataBucket> forward(const std::shared_ptr<DataBucket> inputDataBucket);
+		std::shared_ptr<DataBucket> forward(const std::shared_ptr<DataBucket> inputDataBucket,
+			const std::shared_ptr<DataBucket> outputDataBucket);
 		float backward(const std::shared_ptr<DataBucket> labelDataBucket);		
+		//backward of layer i : input grad G_i, weight grad W_i(split layers only) and update U_i
+		void buildBackwardGraph();
 		std::shared_ptr<Layer> createLayerByType(const std::string layerType);
 		std::string lookaheadLayerType(const std::string line);
+		//memory
+		bool isInplaceLayer(const size_t layerIdx, const Phase phase) const;
+		//activation i as stored, blocked when layer before writes blocked layout
+		DataSize getActivationSize(const size_t i, const size_t number) const;
+		//layout of activation i, input is the one of input layer
+		Layout getActivationLayout(const size_t i) const;
+		void planMemory(const size_t number);
+		void releaseMemoryPlan();
+		//layout : conversions are inserted into layers(and removed) with buckets of plan
+		void planLayout();
+		void releaseLayout();
+		//async
+		//output bucket for number samples from cache(or pool), caller holds runMutex
+		std::shared_ptr<DataBucket> acquireOutput(const size_t number);
+		void enqueueRequest(AsyncRequest request);
+		void asyncLoop();
+		//queued requests are run, then thread exits
+		void stopAsync();
 	private:
 		Phase phase = Phase::Train;
 		std::vector<std::shared_ptr<Layer>> layers;
 		std::vector<std::shared_ptr<DataBucket>> dataBuckets;
 		std::vector<std::shared_ptr<DataBucket>> diffBuckets;
+		//all activations of test phase live in this slab
+		std::shared_ptr<float> activationSlab;
+		bool memoryPlanned = false;
+		//batch which planned slab can hold
+		size_t plannedBatch = 0;
+		size_t reservedBatch = 0;
+		bool inferenceOnly = false;
+		bool blockedLayoutEnabled = true;
+		bool nhwcLayoutEnabled = true;
+		//layout of input which layout of layers is planned for
+		Layout inputLayout = Layout::NCHW;
+		//layers has conversions of layout
+		bool layoutPlanned = false;
+		//NHWC input converted for layers which run NCHW
+		std::shared_ptr<DataBucket> convertedInput;
+		//storage of buckets and params, shared default pool unless network has its own policy
+		std::shared_ptr<MemoryPool> memoryPool = MemoryPool::defaultPool();
+		//null : scheduler of caller
+		std::shared_ptr<TaskScheduler> scheduler;
+		//built for backwardGraphLayers layers, rebuilt when a layer is added(or network is moved, nodes bind this)
+		std::unique_ptr<TaskGraph> backwardGraph;
+		size_t backwardGraphLayers = 0;
 		std::shared_ptr<LossFunctor> lossFunctor;
 		std::shared_ptr<Optimizer> optimizer;
+		std::unique_ptr<AsyncState> async{ new AsyncState() };
 	};
 }
@@ -0,0 +1,34 @@
+#pragma once
+#include <functional>
+#include "EasyCNN/Configure.h"
+#include "EasyCNN/TaskScheduler.h"
+
+namespace EasyCNN
+{
+	//who runs ranges of parallel_for and dispatch_worker.
+	//Native : TaskScheduler::current(), OpenMP : omp parallel for(only if compiled with openmp),
+	//Serial : caller alone, Custom : executor of embedding application.
+	enum class ParallelBackend
+	{
+		Native,
+		OpenMP,
+		Serial,
+		Custom
+	};
+	//run func(context, start, stop) over [begin,end) in ranges of about grain, return when all are done.
+	//func may be called from any thread at the same time.
+	typedef std::function<void(const size_t begin, const size_t end, const size_t grain, TaskFunc func, void* context)> ParallelExecutor;
+
+	//switch at runtime, no parallel_for may be running. false if backend is not available.
+	bool set_parallel_backend(const ParallelBackend backend);
+	ParallelBackend get_parallel_backend();
+	bool is_parallel_backend_available(const ParallelBackend backend);
+	//Custom backend : executor and number of its threads(caller included), grain of layers depends on it
+	void set_parallel_executor(ParallelExecutor executor, const size_t threads);
+	//threads of current backend, caller included
+	size_t get_parallel_threads();
+	//run on current backend
+	void parallel_run(const size_t begin, const size_t end, const size_t grain, TaskFunc func, void* context);
+	//run task graph, nodes run at the same time only on Native backend, else one after another
+	void parallel_run_graph(TaskGraph& graph);
+}
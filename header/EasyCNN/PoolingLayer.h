@@ -29,9 +29,18 @@ namespace EasyCNN
 		virtual void serializeFromString(const std::string content) override;		
 		virtual std::string getLayerType() const override;
 		virtual void solveInnerParams() override;
-		virtual void forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next) override;
-		virtual void backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-			std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff) override;
+		virtual void reserve(const size_t maxBatch) override;
+		virtual void releaseTrainingState() override;
+		virtual LayerCost getForwardCost(const size_t number) const override;
+		virtual WriteMode getOutputWriteMode() const override{ return WriteMode::Overwrite; }
+		virtual WriteMode getDiffWriteMode() const override{ return WriteMode::Accumulate; }
+		virtual WriteMode getGradientWriteMode() const override{ return WriteMode::Overwrite; }
+		//max and mean pooling are per channel, so blocks of channels(or all channels of NHWC pixels) are pooled as vectors
+		virtual bool supportBlockedLayout() const override{ return true; }
+		virtual bool supportNHWCLayout() const override{ return true; }
+		virtual void forward(const TensorView& prev, const TensorView& next) override;
+		virtual void backward(const TensorView& prev, const TensorView& next,
+			const TensorView& prevDiff, const TensorView& nextDiff) override;
 	private:
 		PoolingType poolingType = PoolingType::MaxPooling;
 		std::shared_ptr<ParamBucket> maxIdxes;
@@ -0,0 +1,21 @@
+#pragma once
+#include "EasyCNN/Configure.h"
+
+//x86 : kernels for avx2/fma are built next to baseline ones and picked at runtime
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define EASYCNN_SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+//msvc emits avx2 intrinsics without arch flag
+#define EASYCNN_TARGET_AVX2
+#else
+//only these functions use avx2/fma, library is built for baseline x86
+#define EASYCNN_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+namespace EasyCNN
+{
+	//cpu has avx2/fma and set_sgemm_simd didn't turn them off, every simd kernel follows it
+	bool simd_avx2_enabled();
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+#include <thread>
+#include <vector>
+#include "EasyCNN/Configure.h"
+#include "EasyCNN/DataBucket.h"
+#include "EasyCNN/TaskScheduler.h"
+#include "EasyCNN/BoundedQueue.h"
+
+namespace EasyCNN
+{
+	class NetWork;
+	//streaming inference of a network : its layers are split into stages of about the same forward cost,
+	//every stage runs on its own thread and scheduler(a group of cores), micro-batches(frames) move from
+	//stage to stage through bounded lock-free queues. stages work on different frames at the same time,
+	//so throughput grows with stages while a frame still takes about one forward.
+	//push from one thread and pop from one thread(may be another one).
+	//network must not run or change while pipeline is open.
+	class StreamPipeline
+	{
+	public:
+		//stages of about the same cost, fewer if network has fewer layers.
+		//threadsPerStage 0 : cores / stages, stage thread included.
+		//frames : micro-batches in flight, push waits when all of them are in use.
+		StreamPipeline(NetWork& network, const size_t microBatch, const size_t stages,
+			const size_t threadsPerStage = 0, const size_t frames = 4);
+		//layers of every stage in order, their sum is layer count of network
+		StreamPipeline(NetWork& network, const size_t microBatch, const std::vector<size_t>& stageLayers,
+			const size_t threadsPerStage = 0, const size_t frames = 4);
+		virtual ~StreamPipeline();
+		//input is copied, its number is at most microBatch. it is NCHW unless finalized network was planned for NHWC input.
+		void push(const std::shared_ptr<DataBucket> input);
+		//output of oldest pushed input, waits until it is done. output is reshaped(or created if null) and tagged with its layout.
+		//false : pipeline is closed and every output was popped
+		bool pop(std::shared_ptr<DataBucket>& output);
+		//no more push(call it on thread which pushes), stage threads exit after last frame
+		void close();
+		size_t getStageCount() const;
+		std::vector<size_t> getStageLayers() const;
+	private:
+		//activations of one micro-batch at stage boundaries, boundaries of inplace layers are one bucket
+		struct Frame
+		{
+			std::vector<std::shared_ptr<DataBucket>> boundaries;
+		};
+		//layers [firstLayer,lastLayer), activations between them are its own.
+		//activation k is buckets[k-firstLayer], or boundaries[boundaryOf[k-firstLayer]] of frame.
+		struct Stage
+		{
+			size_t firstLayer = 0;
+			size_t lastLayer = 0;
+			std::vector<std::shared_ptr<DataBucket>> buckets;
+			std::vector<size_t> boundaryOf;
+			std::shared_ptr<TaskScheduler> scheduler;
+			std::vector<size_t> cpus;
+			std::thread thread;
+			//frames to this stage, null : closed
+			std::unique_ptr<BoundedQueue<Frame*>> input;
+		};
+		StreamPipeline(const StreamPipeline&) = delete;
+		StreamPipeline& operator=(const StreamPipeline&) = delete;
+		void build(const std::vector<size_t>& stageLayers, const size_t threadsPerStage, const size_t frameCount);
+		void stageLoop(const size_t stageIdx);
+		void runStage(Stage& stage, Frame& frame);
+	private:
+		NetWork& network;
+		const size_t microBatch;
+		std::vector<std::unique_ptr<Stage>> stages;
+		std::vector<std::unique_ptr<Frame>> frames;
+		//frames from last stage, and frames popped by caller back to push
+		std::unique_ptr<BoundedQueue<Frame*>> output;
+		std::unique_ptr<BoundedQueue<Frame*>> freeFrames;
+		bool closed = false;
+		bool finished = false;
+	};
+}
@@ -0,0 +1,224 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+#include <functional>
+#include "EasyCNN/Configure.h"
+
+namespace EasyCNN
+{
+	//body of a range : plain function and context, tasks are copied by value and never allocate
+	typedef void(*TaskFunc)(void* context, const size_t start, const size_t stop);
+	//fork-join of one parallel_for : items not finished yet
+	struct TaskGroup
+	{
+		std::atomic<size_t> pending;
+	};
+	//range of work, split by whoever runs it until grain
+	struct Task
+	{
+		TaskFunc func = nullptr;
+		void* context = nullptr;
+		size_t start = 0;
+		size_t stop = 0;
+		size_t grain = 1;
+		TaskGroup* group = nullptr;
+	};
+
+	//Chase-Lev deque of fixed capacity.
+	//owner pushes and pops bottom without lock, other threads steal top with cas.
+	class WorkDeque
+	{
+	public:
+		static const int64_t CAPACITY = 256;
+	public:
+		//owner only, false when full
+		bool push(const Task& task);
+		//owner only, newest task
+		bool pop(Task& task);
+		//any thread, oldest(biggest) task
+		bool steal(Task& task);
+	private:
+		//fields of a task, a thief may read a slot the owner is rewriting(its cas fails then),
+		//so every field is atomic and accessed relaxed, ordering comes from top and bottom.
+		struct TaskSlot
+		{
+			std::atomic<TaskFunc> func{ nullptr };
+			std::atomic<void*> context{ nullptr };
+			std::atomic<size_t> start{ 0 };
+			std::atomic<size_t> stop{ 0 };
+			std::atomic<size_t> grain{ 1 };
+			std::atomic<TaskGroup*> group{ nullptr };
+		};
+		void storeTask(const int64_t index, const Task& task);
+		void loadTask(const int64_t index, Task& task) const;
+	private:
+		std::atomic<int64_t> top{ 0 };
+		std::atomic<int64_t> bottom{ 0 };
+		TaskSlot tasks[CAPACITY];
+	};
+
+	class TaskScheduler;
+	//dag of tasks, built once and run many times(e.g. backward of a network).
+	//a node runs after all nodes it depends on, independent nodes run at the same time.
+	class TaskGraph
+	{
+		friend class TaskScheduler;
+	public:
+		typedef std::function<void()> NodeFunc;
+	public:
+		//nodes are owned : movable, not copyable
+		TaskGraph() = default;
+		TaskGraph(TaskGraph&& other) = default;
+		TaskGraph& operator=(TaskGraph&& other) = default;
+		TaskGraph(const TaskGraph&) = delete;
+		TaskGraph& operator=(const TaskGraph&) = delete;
+		size_t addNode(NodeFunc func);
+		//after runs once before is done
+		void addEdge(const size_t before, const size_t after);
+		size_t size() const;
+		void clear();
+		//one node after another in order of dependencies, on calling thread
+		void runSerially();
+	private:
+		struct Node
+		{
+			NodeFunc func;
+			std::vector<size_t> successors;
+			size_t dependencies = 0;
+			std::atomic<size_t> remaining{ 0 };
+		};
+		std::vector<std::unique_ptr<Node>> nodes;
+		TaskScheduler* scheduler = nullptr;
+		TaskGroup* group = nullptr;
+	};
+
+	//where workers run.
+	//Compact : cpus of one node after another(few sockets, shared cache),
+	//Scatter : round robin over nodes(memory bandwidth of every socket).
+	enum class AffinityPolicy
+	{
+		None,
+		Compact,
+		Scatter
+	};
+
+	//work-stealing scheduler.
+	//every worker owns a deque, thread which calls parallel_for borrows one and runs tasks too,
+	//so 'threads' includes the caller. idle workers steal from others, spin a while for the next
+	//fork(layers come back to back), and sleep when nothing is pushed in spin time.
+	//schedulers are plain objects : each network may own one, share one, or use instance().
+	//when pinned workers span numa nodes, every range is first split over nodes by their threads,
+	//so the same part of a bucket is touched and processed on the same node, and thieves prefer their node.
+	class TaskScheduler
+	{
+	public:
+		//callers which are not workers, parallel_for runs serially when all slots are taken
+		static const size_t EXTERNAL_SLOTS = 8;
+		static const size_t MAX_THREADS = 256;
+		static const size_t MAX_NUMA_NODES = 16;
+		static const size_t DEFAULT_SPIN_MICROSECONDS = 100;
+	public:
+		//default scheduler of the process
+		static TaskScheduler& instance();
+		//scheduler of calling thread : its own if it is a worker(or inside parallel_for),
+		//else the one bound by SchedulerScope, else instance()
+		static TaskScheduler& current();
+		explicit TaskScheduler(const size_t threads);
+		virtual ~TaskScheduler();
+		size_t size() const;
+		//live : starts or retires only the difference, running parallel_for keep going.
+		//retired workers finish their queued ranges first.
+		void resize(const size_t threads);
+		//run func over [begin,end) in ranges of about grain, returns when all are done
+		void parallel_for(const size_t begin, const size_t end, const size_t grain, TaskFunc func, void* context);
+		//run every node of graph, a node is pushed when its last dependency is done.
+		//parallel_for inside nodes is stolen by idle threads as usual. returns when all are done.
+		void run(TaskGraph& graph);
+		//how long idle worker spins before sleeping, 0 : sleep at once.
+		//no spin when there are more threads than cores.
+		void setSpinTime(const size_t microseconds);
+		size_t getSpinTime() const;
+		//worker i runs on cpus[i % cpus.size()], empty : anywhere. workers move at their next task.
+		void setAffinity(const std::vector<size_t>& cpus);
+		//cpus of policy, first one is left to caller
+		void setAffinity(const AffinityPolicy policy);
+		std::vector<size_t> getAffinity() const;
+		//numa nodes ranges are split over, 1 unless workers are pinned to several nodes
+		size_t getNodeCount() const;
+	private:
+		//tasks of one node, pushed by callers of other nodes
+		struct NodeInbox
+		{
+			std::mutex mutex;
+			std::vector<Task> tasks;
+		};
+		TaskScheduler(const TaskScheduler&) = delete;
+		TaskScheduler& operator=(const TaskScheduler&) = delete;
+		void shutdown();
+		void workerLoop(const size_t worker);
+		bool retired(const size_t worker) const;
+		bool acquireSlot(size_t& slot);
+		void releaseSlot(const size_t slot);
+		bool findTask(const size_t slot, Task& task);
+		bool takeInbox(const size_t node, Task& task);
+		bool stealByNode(const size_t slot, const size_t node, const bool sameNode, Task& task);
+		void updateNodes();
+		void applyAffinity(const size_t worker);
+		void splitByNode(const size_t slot, Task& root);
+		bool spinForWork(const size_t worker, const size_t seenEpoch) const;
+		void execute(const size_t slot, Task task);
+		void notifyWork();
+		//caller's slot for a fork-join, false : all external slots are taken
+		bool enter(size_t& slot, TaskScheduler*& prevScheduler, size_t& prevSlot);
+		void leave(const size_t slot, TaskScheduler* prevScheduler, const size_t prevSlot);
+		void waitGroup(const size_t slot, TaskGroup& group);
+		static void runGraphNode(void* context, const size_t start, const size_t stop);
+		void pushGraphNode(TaskGraph& graph, const size_t node);
+	private:
+		//external slots, then workers' deques. deques are created once and kept until destruction,
+		//so thieves never see one freed, dequeCount only grows.
+		std::unique_ptr<std::atomic<WorkDeque*>[]> deques;
+		std::atomic<size_t> dequeCount{ 0 };
+		std::unique_ptr<std::atomic<bool>[]> externalBusy;
+		//workers[i] owns deque EXTERNAL_SLOTS+i and runs while i < activeWorkers
+		std::mutex resizeMutex;
+		std::vector<std::thread> workers;
+		std::atomic<size_t> activeWorkers{ 0 };
+		std::atomic<bool> stop{ false };
+		//sleep of idle workers, epoch changes whenever work is pushed
+		std::mutex sleepMutex;
+		std::condition_variable sleepCondition;
+		std::atomic<size_t> sleepers{ 0 };
+		std::atomic<size_t> epoch{ 0 };
+		std::atomic<size_t> spinTime{ DEFAULT_SPIN_MICROSECONDS };
+		std::atomic<bool> oversubscribed{ false };
+		//pinning, workers compare version and move themselves
+		mutable std::mutex affinityMutex;
+		std::vector<size_t> affinityCpus;
+		std::atomic<size_t> affinityVersion{ 0 };
+		//numa node of every slot, threads of every node, nodes with threads
+		std::unique_ptr<std::atomic<size_t>[]> slotNodes;
+		std::atomic<size_t> nodeThreads[MAX_NUMA_NODES];
+		std::atomic<size_t> nodeCount{ 1 };
+		NodeInbox inboxes[MAX_NUMA_NODES];
+		std::atomic<size_t> inboxTasks{ 0 };
+	};
+
+	//parallel_for of this thread goes to scheduler(null : instance()) until scope ends
+	class SchedulerScope
+	{
+	public:
+		explicit SchedulerScope(TaskScheduler* scheduler);
+		~SchedulerScope();
+	private:
+		SchedulerScope(const SchedulerScope&) = delete;
+		SchedulerScope& operator=(const SchedulerScope&) = delete;
+	private:
+		TaskScheduler* prevScheduler = nullptr;
+	};
+}
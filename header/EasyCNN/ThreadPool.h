@@ -3,8 +3,12 @@
 *  License: WTFPL
 */
 #pragma once
+#include <algorithm>
 #include <functional>
 #include "EasyCNN/Configure.h"
+#include "EasyCNN/TaskScheduler.h"
+#include "EasyCNN/ParallelBackend.h"
+#include "EasyCNN/CostModel.h"
 
 #include <vector>
 #include <queue>
@@ -19,6 +23,7 @@
 namespace EasyCNN
 {
 	//TODO: using wrapper to hidden information of ThreadPool
+	//queue pool of packaged tasks, APIs below run on parallel backend(TaskScheduler by default) now.
 	class ThreadPool {			
 	public:	
 		static ThreadPool& instance();
@@ -70,10 +75,71 @@ namespace EasyCNN
 
 	//////////////////////////////////////////////////////////////////////////
 	//APIs
-	//get thread number
+	//get thread number of default scheduler(caller of dispatch included)
 	size_t get_thread_num();
-	//set thread number, and returned support thread number
+	//set thread number of default scheduler live, and returned support thread number
 	size_t set_thread_num(const size_t num);
-	//dispatcher tasks of layer
+	//idle workers of default scheduler spin this long for next dispatch before sleeping(low latency vs cpu usage)
+	void set_spin_time(const size_t microseconds);
+	//dispatcher tasks of layer, on current parallel backend
 	void dispatch_worker(std::function<void(const size_t, const size_t)> func, const size_t number);
+	template<class F>
+	static void invoke_range(void* context, const size_t start, const size_t stop)
+	{
+		(*static_cast<const F*>(context))(start, stop);
+	}
+	//func(start,stop) over [begin,end) on all threads of backend, caller included.
+	//ranges are about grain long, 0 : even share of every thread.
+	template<class F>
+	void parallel_for(const size_t begin, const size_t end, const size_t grain, const F& func)
+	{
+		const size_t threads = get_parallel_threads();
+		const size_t realGrain = grain > 0 ? grain : (end - begin + threads - 1) / threads;
+		parallel_run(begin, end, realGrain, &invoke_range<F>, const_cast<F*>(&func));
+	}
+	//zero new storage on threads of current scheduler, split like kernels split it,
+	//so every page is first touched(and placed) on the numa node which processes it. nothing on one node.
+	void first_touch(float* data, const size_t count);
+	//2d range [0,n0)x[0,n1) flattened, so small n0(e.g. batch 1) still splits along n1.
+	//func(i, jStart, jStop), grain counts cells.
+	template<class F>
+	void parallel_for_2d(const size_t n0, const size_t n1, const size_t grain, const F& func)
+	{
+		if (n0 == 0 || n1 == 0)
+		{
+			return;
+		}
+		parallel_for(0, n0*n1, grain, [&](const size_t start, const size_t stop){
+			size_t cell = start;
+			while (cell < stop)
+			{
+				const size_t i = cell / n1;
+				const size_t j = cell % n1;
+				const size_t jStop = std::min(n1, j + (stop - cell));
+				func(i, j, jStop);
+				cell += jStop - j;
+			}
+		});
+	}
+	//3d range [0,n0)x[0,n1)x[0,n2) flattened, func(i, j, kStart, kStop), grain counts cells.
+	template<class F>
+	void parallel_for_3d(const size_t n0, const size_t n1, const size_t n2, const size_t grain, const F& func)
+	{
+		if (n0 == 0 || n1 == 0 || n2 == 0)
+		{
+			return;
+		}
+		parallel_for(0, n0*n1*n2, grain, [&](const size_t start, const size_t stop){
+			size_t cell = start;
+			while (cell < stop)
+			{
+				const size_t i = cell / (n1*n2);
+				const size_t j = cell / n2 % n1;
+				const size_t k = cell % n2;
+				const size_t kStop = std::min(n2, k + (stop - cell));
+				func(i, j, k, kStop);
+				cell += kStop - k;
+			}
+		});
+	}
 };
\ No newline at end of file
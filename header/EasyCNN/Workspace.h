@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+#include "EasyCNN/Configure.h"
+
+namespace EasyCNN
+{
+	//per-thread scratch memory of kernels(im2col columns, packed panels, transformed tiles...).
+	//every thread owns one aligned region which only grows, so kernels never allocate in parallel region.
+
+	//bytes one thread needs at most, network reserves the maximum of its layers.
+	//workers of thread pool grow their region before running next task.
+	void reserve_workspace(const size_t bytes);
+	size_t get_workspace_size();
+	//make sure scratch of current thread holds the reserved size
+	void prepare_workspace();
+	//scratch of current thread, at least bytes and aligned to MEMORY_ALIGNMENT.
+	//content is undefined, it may be reused by the next kernel run on this thread.
+	float* get_workspace(const size_t bytes);
+}
@@ -6,17 +6,32 @@ LOCAL_MODULE    := easycnn
 
 LOCAL_SRC_FILES := \
 	$(LOCAL_PATH)/../../src/ActivationLayer.cpp \
+	$(LOCAL_PATH)/../../src/BlockedLayout.cpp \
+	$(LOCAL_PATH)/../../src/ConvolutionGemm.cpp \
 	$(LOCAL_PATH)/../../src/ConvolutionLayer.cpp \
+	$(LOCAL_PATH)/../../src/CostModel.cpp \
+	$(LOCAL_PATH)/../../src/CpuTopology.cpp \
 	$(LOCAL_PATH)/../../src/DataBucket.cpp \
 	$(LOCAL_PATH)/../../src/EasyAssert.cpp \
 	$(LOCAL_PATH)/../../src/EasyLogger.cpp \
 	$(LOCAL_PATH)/../../src/FullconnectLayer.cpp \
+	$(LOCAL_PATH)/../../src/Gemm.cpp \
 	$(LOCAL_PATH)/../../src/InputLayer.cpp \
+	$(LOCAL_PATH)/../../src/LayoutLayer.cpp \
 	$(LOCAL_PATH)/../../src/LossFunction.cpp \
+	$(LOCAL_PATH)/../../src/MemoryPlanner.cpp \
+	$(LOCAL_PATH)/../../src/MemoryPool.cpp \
 	$(LOCAL_PATH)/../../src/NetWork.cpp \
+	$(LOCAL_PATH)/../../src/NhwcLayout.cpp \
+	$(LOCAL_PATH)/../../src/ParallelBackend.cpp \
 	$(LOCAL_PATH)/../../src/ParamBucket.cpp \
 	$(LOCAL_PATH)/../../src/PoolingLayer.cpp \
-	$(LOCAL_PATH)/../../src/SoftmaxLayer.cpp
+	$(LOCAL_PATH)/../../src/SoftmaxLayer.cpp \
+	$(LOCAL_PATH)/../../src/StreamPipeline.cpp \
+	$(LOCAL_PATH)/../../src/TaskScheduler.cpp \
+	$(LOCAL_PATH)/../../src/ThreadPool.cpp \
+	$(LOCAL_PATH)/../../src/Winograd.cpp \
+	$(LOCAL_PATH)/../../src/Workspace.cpp
 	
 LOCAL_C_INCLUDES := $(LOCAL_PATH)/../header
 LOCAL_CFLAGS :=  -D__ARM_NEON -D__cpusplus -O3 -mfloat-abi=softfp -mfpu=neon -march=armv7-a -mtune=cortex-a8 -fopenmp -std=c++11 -ffunction-sections -fdata-sections -fvisibility=hidden
@@ -5,6 +5,21 @@
 
 namespace EasyCNN
 {
+	//channels [start,stop) of sample nn, rows on NHWC where channels of a row are interleaved
+	static TensorView part(const TensorView& view, const size_t nn, const size_t start, const size_t stop)
+	{
+		const TensorView sample = view.slice(nn, 1);
+		return view.getLayout() == Layout::NHWC ? sample.sliceRows(start, stop - start) : sample.sliceChannels(start, stop - start);
+	}
+	//element-wise layers split over samples and channels(rows on NHWC), so batch 1 still uses every thread
+	template<typename Worker>
+	static void dispatch_elementwise(const TensorView& view, const LayerCost& cost, const Worker& worker)
+	{
+		const DataSize size = view.getSize();
+		const size_t parts = (view.getLayout() == Layout::NHWC ? size.height : size.channels);
+		parallel_for_2d(size.number, parts, get_parallel_grain({ size.number, parts }, cost), worker);
+	}
+
 	SigmodLayer::SigmodLayer()
 	{
 
@@ -18,47 +33,30 @@ namespace EasyCNN
 	{
 		return layerType;
 	}
-	void SigmodLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void SigmodLayer::forward(const TensorView& prev, const TensorView& next)
 	{
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const float* prevData = prev->getData().get();
-		float* nextData = next->getData().get();
-
-		auto worker = [&](const size_t start,const size_t stop){
-			const size_t offset = start*prevSize._3DSize();
-			const size_t total_size = (stop - start)*prevSize._3DSize();
-			sigmoid(prevData + offset, nextData + offset, total_size);
+		const DataSize prevSize = prev.getSize();
+		auto worker = [&](const size_t nn, const size_t start, const size_t stop){
+			sigmoid(part(prev, nn, start, stop), part(next, nn, start, stop));
 		};
-		dispatch_worker(worker, prevSize.number);
+		dispatch_elementwise(prev, getForwardCost(prevSize.number), worker);
 	}
-	void SigmodLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void SigmodLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
-		const float* prevData = prev->getData().get();
-		const float* nextData = next->getData().get();
-		float* prevDiffData = prevDiff->getData().get();
-		const float* nextDiffData = nextDiff->getData().get();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
 		easyAssert(prevSize == nextSize, "size must be equal!");
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 
-		//update prevDiff
-		prevDiff->fillData(0.0f);
-
-		auto worker = [&](const size_t start, const size_t stop){
-			const size_t offset = start*prevSize._3DSize();
-			const size_t total_size = (stop - start)*prevSize._3DSize();
-			//calculate current inner diff
-			df_sigmoid(nextData + offset, prevDiffData + offset, total_size);
-			//multiply next diff
-			mul_inplace(prevDiffData + offset, nextDiffData + offset, total_size);
+		//update prevDiff, every element is overwritten(prevDiff may be nextDiff when inplace)
+		auto worker = [&](const size_t nn, const size_t start, const size_t stop){
+			//calculate current inner diff && multiply next diff
+			sigmoid_backward(part(next, nn, start, stop), part(nextDiff, nn, start, stop), part(prevDiff, nn, start, stop));
 		};
-		dispatch_worker(worker, prevSize.number);
+		dispatch_elementwise(prev, getBackwardCost(prevSize.number), worker);
 
 		//update this layer's param
 		//Tanh layer : nop
@@ -79,47 +77,30 @@ namespace EasyCNN
 	}
 
 
-	void TanhLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void TanhLayer::forward(const TensorView& prev, const TensorView& next)
 	{
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const float* prevData = prev->getData().get();
-		float* nextData = next->getData().get();
-
-		auto worker = [&](const size_t start, const size_t stop){
-			const size_t offset = start*prevSize._3DSize();
-			const size_t total_size = (stop - start)*prevSize._3DSize();
-			tanh(prevData + offset, nextData + offset, total_size);
+		const DataSize prevSize = prev.getSize();
+		auto worker = [&](const size_t nn, const size_t start, const size_t stop){
+			tanh(part(prev, nn, start, stop), part(next, nn, start, stop));
 		};
-		dispatch_worker(worker, prevSize.number);
+		dispatch_elementwise(prev, getForwardCost(prevSize.number), worker);
 	}
-	void TanhLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void TanhLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-			const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
-		const float* prevData = prev->getData().get();
-		const float* nextData = next->getData().get();
-		float* prevDiffData = prevDiff->getData().get();
-		const float* nextDiffData = nextDiff->getData().get();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
 		easyAssert(prevSize == nextSize, "size must be equal!");
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 
-		//update prevDiff
-		prevDiff->fillData(0.0f);		
-
-		auto worker = [&](const size_t start, const size_t stop){
-			const size_t offset = start*prevSize._3DSize();
-			const size_t total_size = (stop - start)*prevSize._3DSize();
-			//calculate current inner diff
-			df_tanh(nextData + offset, prevDiffData + offset, total_size);
-			//multiply next diff
-			mul_inplace(prevDiffData + offset, nextDiffData + offset, total_size);
+		//update prevDiff, every element is overwritten(prevDiff may be nextDiff when inplace)
+		auto worker = [&](const size_t nn, const size_t start, const size_t stop){
+			//calculate current inner diff && multiply next diff
+			tanh_backward(part(next, nn, start, stop), part(nextDiff, nn, start, stop), part(prevDiff, nn, start, stop));
 		};
-		dispatch_worker(worker, prevSize.number);
+		dispatch_elementwise(prev, getBackwardCost(prevSize.number), worker);
 
 		//update this layer's param
 		//Tanh layer : nop
@@ -140,47 +121,30 @@ namespace EasyCNN
 	}
 
 
-	void ReluLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void ReluLayer::forward(const TensorView& prev, const TensorView& next)
 	{
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const float* prevData = prev->getData().get();
-		float* nextData = next->getData().get();
-
-		auto worker = [&](const size_t start, const size_t stop){
-			const size_t offset = start*prevSize._3DSize();
-			const size_t total_size = (stop - start)*prevSize._3DSize();
-			relu(prevData + offset, nextData + offset, total_size);
+		const DataSize prevSize = prev.getSize();
+		auto worker = [&](const size_t nn, const size_t start, const size_t stop){
+			relu(part(prev, nn, start, stop), part(next, nn, start, stop));
 		};
-		dispatch_worker(worker, prevSize.number);
+		dispatch_elementwise(prev, getForwardCost(prevSize.number), worker);
 	}
-	void ReluLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void ReluLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
-		const float* prevData = prev->getData().get();
-		const float* nextData = next->getData().get();
-		float* prevDiffData = prevDiff->getData().get();
-		const float* nextDiffData = nextDiff->getData().get();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
 		easyAssert(prevSize == nextSize, "size must be equal!");
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 
-		//update prevDiff		
-		prevDiff->fillData(0.0f);	
-
-		auto worker = [&](const size_t start, const size_t stop){
-			const size_t offset = start*prevSize._3DSize();
-			const size_t total_size = (stop - start)*prevSize._3DSize();
-			//calculate current inner diff
-			df_relu(nextData + offset, prevDiffData + offset, total_size);
-			//multiply next diff
-			mul_inplace(prevDiffData + offset, nextDiffData + offset, total_size);
+		//update prevDiff, every element is overwritten(prevDiff may be nextDiff when inplace)
+		auto worker = [&](const size_t nn, const size_t start, const size_t stop){
+			//calculate current inner diff && multiply next diff
+			relu_backward(part(next, nn, start, stop), part(nextDiff, nn, start, stop), part(prevDiff, nn, start, stop));
 		};
-		dispatch_worker(worker, prevSize.number);
+		dispatch_elementwise(prev, getBackwardCost(prevSize.number), worker);
 
 		//update this layer's param
 		//RELU layer : nop
@@ -40,31 +40,30 @@ namespace EasyCNN
 	{
 		setOutpuBuckerSize(getInputBucketSize());
 	}
-	void BatchNormalizationLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void BatchNormalizationLayer::forward(const TensorView& prev, const TensorView& next)
 	{
-		const DataSize prevDataSize = prev->getSize();
-		const DataSize nextDataSize = next->getSize();
+		const DataSize prevDataSize = prev.getSize();
+		const DataSize nextDataSize = next.getSize();
 		easyAssert(prevDataSize == nextDataSize, "size must be equal!");
 
 		//TODO
 	}
-	void BatchNormalizationLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void BatchNormalizationLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
-		float* prevDiffData = prevDiff->getData().get();
-		const float* nextDiffData = nextDiff->getData().get();		
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
+		const DataSize nextDiffSize = nextDiff.getSize();
+		float* prevDiffData = prevDiff.getData();
+		const float* nextDiffData = nextDiff.getData();		
 		easyAssert(prevSize == nextSize, "size must be equal!");
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 
 		//////////////////////////////////////////////////////////////////////////
 		//update prevDiff
-		
-		prevDiff->fillData(0.0f);
+		//prevDiff is cleared by network
 		//calculate current inner diff && multiply next diff
 		//TODO
 
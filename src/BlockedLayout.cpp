@@ -0,0 +1,423 @@
+#include <algorithm>
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/EasyAssert.h"
+#include "EasyCNN/Simd.h"
+
+namespace EasyCNN
+{
+	//output pixels of a row computed together, their vectors of one output block stay in registers
+	static const size_t BLOCKED_TILE = 8;
+
+	//one sample of convolution2d on blocked tensors, same mode keeps size and doesn't use steps(as convolution2d_same)
+	struct BlockedConvolutionShape
+	{
+		BlockedConvolutionShape(const DataSize& inputSize, const DataSize& kernelSize, const DataSize& outputSize,
+			const size_t kws, const size_t khs, const int mode)
+		{
+			ic = kernelSize.channels;
+			ih = inputSize.height;
+			iw = inputSize.width / CHANNEL_BLOCK;
+			kh = kernelSize.height;
+			kw = kernelSize.width / CHANNEL_BLOCK;
+			oh = outputSize.height;
+			ow = outputSize.width / CHANNEL_BLOCK;
+			const bool same = (mode == 1);
+			ws = same ? 1 : kws;
+			hs = same ? 1 : khs;
+			padTop = same ? kh / 2 : 0;
+			padLeft = same ? kw / 2 : 0;
+			//outputs [oxStart,oxStop) read inside of input row for every kernel column
+			oxStart = std::min(ow, (padLeft + ws - 1) / ws);
+			const size_t oxEnd = (iw + padLeft >= kw) ? (iw + padLeft - kw) / ws + 1 : 0;
+			oxStop = std::max(oxStart, std::min(ow, oxEnd));
+		}
+		size_t ic, ih, iw, kh, kw, oh, ow;
+		size_t ws, hs, padTop, padLeft;
+		size_t oxStart, oxStop;
+	};
+	//output row oy of one output block in one sample
+	struct BlockedRow
+	{
+		const BlockedConvolutionShape* shape;
+		//input sample, kernel(ic,kh,kw*CHANNEL_BLOCK) and bias of block(may be null), output row
+		const float* input;
+		size_t channelStride;
+		size_t heightStride;
+		const float* kernel;
+		const float* bias;
+		float* output;
+		size_t oy;
+	};
+	//pixels [ox,ox+tile) whose taps are all inside of input row, or one pixel of border(checked)
+	typedef void(*BlockedTileKernel)(const BlockedRow& row, const size_t ox);
+	struct BlockedKernels
+	{
+		BlockedTileKernel tile;
+		BlockedTileKernel halfTile;
+		BlockedTileKernel pixel;
+		BlockedTileKernel border;
+	};
+
+	//////////////////////////////////////////////////////////////////////////
+	//scalar kernels
+	template <size_t TILE, bool CHECKED>
+	static void blocked_tile_scalar(const BlockedRow& row, const size_t ox)
+	{
+		const BlockedConvolutionShape& shape = *row.shape;
+		float acc[TILE][CHANNEL_BLOCK];
+		for (size_t t = 0; t < TILE; t++)
+		{
+			for (size_t l = 0; l < CHANNEL_BLOCK; l++)
+			{
+				acc[t][l] = row.bias ? row.bias[l] : 0.0f;
+			}
+		}
+		const float* kernel = row.kernel;
+		for (size_t c = 0; c < shape.ic; c++)
+		{
+			const float* channel = row.input + (c / CHANNEL_BLOCK)*row.channelStride + c % CHANNEL_BLOCK;
+			for (size_t y = 0; y < shape.kh; y++, kernel += shape.kw*CHANNEL_BLOCK)
+			{
+				const int iy = (int)(row.oy*shape.hs + y) - (int)shape.padTop;
+				if (iy < 0 || iy >= (int)shape.ih)
+				{
+					continue;
+				}
+				const float* src = channel + iy*row.heightStride;
+				for (size_t x = 0; x < shape.kw; x++)
+				{
+					const float* w = kernel + x*CHANNEL_BLOCK;
+					for (size_t t = 0; t < TILE; t++)
+					{
+						const int ix = (int)((ox + t)*shape.ws + x) - (int)shape.padLeft;
+						if (CHECKED && (ix < 0 || ix >= (int)shape.iw))
+						{
+							continue;
+						}
+						const float v = src[ix*CHANNEL_BLOCK];
+						for (size_t l = 0; l < CHANNEL_BLOCK; l++)
+						{
+							acc[t][l] += v*w[l];
+						}
+					}
+				}
+			}
+		}
+		for (size_t t = 0; t < TILE; t++)
+		{
+			std::copy(acc[t], acc[t] + CHANNEL_BLOCK, row.output + (ox + t)*CHANNEL_BLOCK);
+		}
+	}
+
+#ifdef EASYCNN_SIMD_X86
+	//////////////////////////////////////////////////////////////////////////
+	//avx2/fma kernels : a vector is 8 output channels of a pixel, one broadcast and fma per pixel and tap
+	//pixels after TILE are not computed(constant, so their code is dropped)
+#define EASYCNN_BLOCKED_TAP(t) if (t < TILE) acc##t = _mm256_fmadd_ps(_mm256_broadcast_ss(src + t*step), w, acc##t);
+#define EASYCNN_BLOCKED_STORE(t) if (t < TILE) _mm256_storeu_ps(output + t*CHANNEL_BLOCK, acc##t);
+	template <size_t TILE>
+	EASYCNN_TARGET_AVX2
+	static void blocked_tile_avx2(const BlockedRow& row, const size_t ox)
+	{
+		static_assert(CHANNEL_BLOCK == 8 && TILE <= 8, "avx2 kernel is for tiles of 8 pixels at most and blocks of 8 channels.");
+		const BlockedConvolutionShape& shape = *row.shape;
+		const __m256 init = row.bias ? _mm256_loadu_ps(row.bias) : _mm256_setzero_ps();
+		__m256 acc0 = init, acc1 = init, acc2 = init, acc3 = init;
+		__m256 acc4 = init, acc5 = init, acc6 = init, acc7 = init;
+		//from a pixel of tile to next one in input
+		const size_t step = shape.ws*CHANNEL_BLOCK;
+		const float* kernel = row.kernel;
+		for (size_t c = 0; c < shape.ic; c++)
+		{
+			const float* channel = row.input + (c / CHANNEL_BLOCK)*row.channelStride + c % CHANNEL_BLOCK
+				+ (ox*shape.ws - shape.padLeft)*CHANNEL_BLOCK;
+			for (size_t y = 0; y < shape.kh; y++, kernel += shape.kw*CHANNEL_BLOCK)
+			{
+				const int iy = (int)(row.oy*shape.hs + y) - (int)shape.padTop;
+				if (iy < 0 || iy >= (int)shape.ih)
+				{
+					continue;
+				}
+				const float* src = channel + iy*row.heightStride;
+				for (size_t x = 0; x < shape.kw; x++, src += CHANNEL_BLOCK)
+				{
+					const __m256 w = _mm256_loadu_ps(kernel + x*CHANNEL_BLOCK);
+					EASYCNN_BLOCKED_TAP(0);
+					EASYCNN_BLOCKED_TAP(1);
+					EASYCNN_BLOCKED_TAP(2);
+					EASYCNN_BLOCKED_TAP(3);
+					EASYCNN_BLOCKED_TAP(4);
+					EASYCNN_BLOCKED_TAP(5);
+					EASYCNN_BLOCKED_TAP(6);
+					EASYCNN_BLOCKED_TAP(7);
+				}
+			}
+		}
+		float* output = row.output + ox*CHANNEL_BLOCK;
+		EASYCNN_BLOCKED_STORE(0);
+		EASYCNN_BLOCKED_STORE(1);
+		EASYCNN_BLOCKED_STORE(2);
+		EASYCNN_BLOCKED_STORE(3);
+		EASYCNN_BLOCKED_STORE(4);
+		EASYCNN_BLOCKED_STORE(5);
+		EASYCNN_BLOCKED_STORE(6);
+		EASYCNN_BLOCKED_STORE(7);
+	}
+#undef EASYCNN_BLOCKED_TAP
+#undef EASYCNN_BLOCKED_STORE
+	template <bool CHECKED>
+	EASYCNN_TARGET_AVX2
+	static void blocked_pixel_avx2(const BlockedRow& row, const size_t ox)
+	{
+		const BlockedConvolutionShape& shape = *row.shape;
+		__m256 acc = row.bias ? _mm256_loadu_ps(row.bias) : _mm256_setzero_ps();
+		const float* kernel = row.kernel;
+		for (size_t c = 0; c < shape.ic; c++)
+		{
+			const float* channel = row.input + (c / CHANNEL_BLOCK)*row.channelStride + c % CHANNEL_BLOCK;
+			for (size_t y = 0; y < shape.kh; y++, kernel += shape.kw*CHANNEL_BLOCK)
+			{
+				const int iy = (int)(row.oy*shape.hs + y) - (int)shape.padTop;
+				if (iy < 0 || iy >= (int)shape.ih)
+				{
+					continue;
+				}
+				const float* src = channel + iy*row.heightStride;
+				for (size_t x = 0; x < shape.kw; x++)
+				{
+					const int ix = (int)(ox*shape.ws + x) - (int)shape.padLeft;
+					if (CHECKED && (ix < 0 || ix >= (int)shape.iw))
+					{
+						continue;
+					}
+					acc = _mm256_fmadd_ps(_mm256_broadcast_ss(src + ix*CHANNEL_BLOCK), _mm256_loadu_ps(kernel + x*CHANNEL_BLOCK), acc);
+				}
+			}
+		}
+		_mm256_storeu_ps(row.output + ox*CHANNEL_BLOCK, acc);
+	}
+#endif
+
+	static const BlockedKernels scalarBlockedKernels = {
+		&blocked_tile_scalar<BLOCKED_TILE, false>, &blocked_tile_scalar<BLOCKED_TILE / 2, false>,
+		&blocked_tile_scalar<1, false>, &blocked_tile_scalar<1, true> };
+#ifdef EASYCNN_SIMD_X86
+	static const BlockedKernels avx2BlockedKernels = {
+		&blocked_tile_avx2<BLOCKED_TILE>, &blocked_tile_avx2<BLOCKED_TILE / 2>,
+		&blocked_pixel_avx2<false>, &blocked_pixel_avx2<true> };
+#endif
+	static const BlockedKernels& blocked_kernels()
+	{
+#ifdef EASYCNN_SIMD_X86
+		if (simd_avx2_enabled())
+		{
+			return avx2BlockedKernels;
+		}
+#endif
+		return scalarBlockedKernels;
+	}
+
+	DataSize blocked_size(const DataSize& size)
+	{
+		DataSize blockedSize = size;
+		blockedSize.channels = (size.channels + CHANNEL_BLOCK - 1) / CHANNEL_BLOCK;
+		blockedSize.width = size.width*CHANNEL_BLOCK;
+		return blockedSize;
+	}
+	void to_blocked(const TensorView& input, const TensorView& output)
+	{
+		const DataSize inputSize = input.getSize();
+		easyAssert(output.getSize() == blocked_size(inputSize) && input.getLayout() == Layout::NCHW && output.getLayout() == Layout::NCHW,
+			"size of blocked tensor is invalidate.");
+		for (size_t nn = 0; nn < inputSize.number; nn++)
+		{
+			for (size_t b = 0; b < output.getSize().channels; b++)
+			{
+				for (size_t y = 0; y < inputSize.height; y++)
+				{
+					float* dst = output.getSampleData(nn) + output.getIndex(b, y, 0);
+					for (size_t l = 0; l < CHANNEL_BLOCK; l++)
+					{
+						const size_t c = b*CHANNEL_BLOCK + l;
+						if (c >= inputSize.channels)
+						{
+							//missing channels are 0
+							for (size_t x = 0; x < inputSize.width; x++)
+							{
+								dst[x*CHANNEL_BLOCK + l] = 0.0f;
+							}
+							continue;
+						}
+						const float* src = input.getSampleData(nn) + input.getIndex(c, y, 0);
+						for (size_t x = 0; x < inputSize.width; x++)
+						{
+							dst[x*CHANNEL_BLOCK + l] = src[x];
+						}
+					}
+				}
+			}
+		}
+	}
+	void from_blocked(const TensorView& input, const TensorView& output)
+	{
+		const DataSize outputSize = output.getSize();
+		easyAssert(input.getSize() == blocked_size(outputSize) && input.getLayout() == Layout::NCHW && output.getLayout() == Layout::NCHW,
+			"size of blocked tensor is invalidate.");
+		for (size_t nn = 0; nn < outputSize.number; nn++)
+		{
+			for (size_t c = 0; c < outputSize.channels; c++)
+			{
+				const size_t b = c / CHANNEL_BLOCK;
+				const size_t l = c % CHANNEL_BLOCK;
+				for (size_t y = 0; y < outputSize.height; y++)
+				{
+					const float* src = input.getSampleData(nn) + input.getIndex(b, y, 0) + l;
+					float* dst = output.getSampleData(nn) + output.getIndex(c, y, 0);
+					for (size_t x = 0; x < outputSize.width; x++)
+					{
+						dst[x] = src[x*CHANNEL_BLOCK];
+					}
+				}
+			}
+		}
+	}
+	DataSize blocked_kernel_size(const DataSize& kernelSize)
+	{
+		//blocks of kernels(output channels), not of input channels
+		DataSize blockedSize = kernelSize;
+		blockedSize.number = (kernelSize.number + CHANNEL_BLOCK - 1) / CHANNEL_BLOCK;
+		blockedSize.width = kernelSize.width*CHANNEL_BLOCK;
+		return blockedSize;
+	}
+	void blocked_transform_kernel(const TensorView& kernel, const float* bias, const TensorView& blockedKernel, float* blockedBias)
+	{
+		const DataSize kernelSize = kernel.getSize();
+		const DataSize expectSize = blocked_kernel_size(kernelSize);
+		easyAssert(blockedKernel.getSize() == expectSize && blockedKernel.isDense(), "size of blocked kernel is invalidate.");
+		float* dst = blockedKernel.getData();
+		for (size_t b = 0; b < expectSize.number; b++)
+		{
+			for (size_t c = 0; c < kernelSize.channels; c++)
+			{
+				for (size_t y = 0; y < kernelSize.height; y++)
+				{
+					for (size_t x = 0; x < kernelSize.width; x++)
+					{
+						for (size_t l = 0; l < CHANNEL_BLOCK; l++, dst++)
+						{
+							const size_t o = b*CHANNEL_BLOCK + l;
+							*dst = (o < kernelSize.number) ? kernel.getData()[kernel.getIndex(o, c, y, x)] : 0.0f;
+						}
+					}
+				}
+			}
+		}
+		if (blockedBias)
+		{
+			for (size_t o = 0; o < expectSize.number*CHANNEL_BLOCK; o++)
+			{
+				blockedBias[o] = (bias && o < kernelSize.number) ? bias[o] : 0.0f;
+			}
+		}
+	}
+	void convolution2d_blocked(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop)
+	{
+		const DataSize inputSize = input.getSize();
+		const DataSize kernelSize = kernel.getSize();
+		const DataSize outputSize = output.getSize();
+		easyAssert(inputSize.number == outputSize.number, "number of input and output must be equal.");
+		easyAssert(outputSize.channels == kernelSize.number && kernelSize.channels <= inputSize.channels*CHANNEL_BLOCK,
+			"channels of kernel is invalidate.");
+		easyAssert(inputSize.width % CHANNEL_BLOCK == 0 && kernelSize.width % CHANNEL_BLOCK == 0 && outputSize.width % CHANNEL_BLOCK == 0 &&
+			input.getLayout() == Layout::NCHW && output.getLayout() == Layout::NCHW, "tensors are not blocked.");
+		easyAssert(rowStart <= rowStop && rowStop <= outputSize.height, "rows are out of output.");
+		const BlockedConvolutionShape shape(inputSize, kernelSize, outputSize, kws, khs, mode);
+		const BlockedKernels& kernels = blocked_kernels();
+		BlockedRow row;
+		row.shape = &shape;
+		row.channelStride = input.channelStride;
+		row.heightStride = input.heightStride;
+		for (size_t nn = 0; nn < inputSize.number; nn++)
+		{
+			row.input = input.getSampleData(nn);
+			for (size_t b = 0; b < outputSize.channels; b++)
+			{
+				row.kernel = kernel.getSampleData(b);
+				row.bias = bias ? bias + b*CHANNEL_BLOCK : nullptr;
+				for (size_t oy = rowStart; oy < rowStop; oy++)
+				{
+					row.output = output.getSampleData(nn) + output.getIndex(b, oy, 0);
+					row.oy = oy;
+					size_t ox = 0;
+					for (; ox < shape.oxStart; ox++)
+					{
+						kernels.border(row, ox);
+					}
+					for (; ox + BLOCKED_TILE <= shape.oxStop; ox += BLOCKED_TILE)
+					{
+						kernels.tile(row, ox);
+					}
+					for (; ox + BLOCKED_TILE / 2 <= shape.oxStop; ox += BLOCKED_TILE / 2)
+					{
+						kernels.halfTile(row, ox);
+					}
+					for (; ox < shape.oxStop; ox++)
+					{
+						kernels.pixel(row, ox);
+					}
+					for (; ox < shape.ow; ox++)
+					{
+						kernels.border(row, ox);
+					}
+				}
+			}
+		}
+	}
+	void pooling2d_blocked(const TensorView& input, const TensorView& output, const int type,
+		const size_t kw, const size_t kh, const size_t ws, const size_t hs, const size_t rowStart, const size_t rowStop)
+	{
+		const DataSize inputSize = input.getSize();
+		const DataSize outputSize = output.getSize();
+		easyAssert(inputSize.number == outputSize.number && inputSize.channels == outputSize.channels, "size of input and output must be matched.");
+		easyAssert(inputSize.width % CHANNEL_BLOCK == 0 && outputSize.width % CHANNEL_BLOCK == 0 &&
+			input.getLayout() == Layout::NCHW && output.getLayout() == Layout::NCHW, "tensors are not blocked.");
+		easyAssert(rowStart <= rowStop && rowStop <= outputSize.height, "rows are out of output.");
+		const size_t iw = inputSize.width / CHANNEL_BLOCK;
+		const size_t ow = outputSize.width / CHANNEL_BLOCK;
+		//as PoolingLayer : window starts at ox*ws and is clipped, max starts from 0, mean divides by whole window
+		const float area = (float)(kw*kh);
+		for (size_t nn = 0; nn < inputSize.number; nn++)
+		{
+			for (size_t b = 0; b < outputSize.channels; b++)
+			{
+				const float* src = input.getSampleData(nn) + input.getIndex(b, 0, 0);
+				for (size_t oy = rowStart; oy < rowStop; oy++)
+				{
+					float* dst = output.getSampleData(nn) + output.getIndex(b, oy, 0);
+					const size_t yStop = std::min(oy*hs + kh, inputSize.height);
+					for (size_t ox = 0; ox < ow; ox++, dst += CHANNEL_BLOCK)
+					{
+						const size_t xStop = std::min(ox*ws + kw, iw);
+						float result[CHANNEL_BLOCK] = {};
+						for (size_t iy = oy*hs; iy < yStop; iy++)
+						{
+							for (size_t ix = ox*ws; ix < xStop; ix++)
+							{
+								const float* pixel = src + iy*input.heightStride + ix*CHANNEL_BLOCK;
+								for (size_t l = 0; l < CHANNEL_BLOCK; l++)
+								{
+									result[l] = (type == 0) ? std::max(result[l], pixel[l]) : result[l] + pixel[l];
+								}
+							}
+						}
+						for (size_t l = 0; l < CHANNEL_BLOCK; l++)
+						{
+							dst[l] = (type == 0) ? result[l] : result[l] / area;
+						}
+					}
+				}
+			}
+		}
+	}
+}//namespace
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/Workspace.h"
+#include "EasyCNN/EasyAssert.h"
+
+namespace EasyCNN
+{
+	enum class ConvolutionPath
+	{
+		//1x1 kernel of step 1 : input channels are columns already
+		Pointwise,
+		//any other kernel : columns of every output pixel are gathered first
+		Im2col
+	};
+	//one sample of convolution2d, same mode keeps size and doesn't use steps(as convolution2d_same)
+	struct ConvolutionShape
+	{
+		ConvolutionShape(const DataSize& inputSize, const DataSize& kernelSize, const DataSize& outputSize,
+			const size_t kws, const size_t khs, const int mode)
+		{
+			ic = inputSize.channels;
+			ih = inputSize.height;
+			iw = inputSize.width;
+			oc = kernelSize.number;
+			kh = kernelSize.height;
+			kw = kernelSize.width;
+			oh = outputSize.height;
+			ow = outputSize.width;
+			const bool same = (mode == 1);
+			ws = same ? 1 : kws;
+			hs = same ? 1 : khs;
+			padTop = same ? kh / 2 : 0;
+			padLeft = same ? kw / 2 : 0;
+			if (kh == 1 && kw == 1 && ws == 1 && hs == 1)
+			{
+				path = ConvolutionPath::Pointwise;
+			}
+			else
+			{
+				path = ConvolutionPath::Im2col;
+			}
+		}
+		//k of gemm
+		size_t depth() const
+		{
+			return path == ConvolutionPath::Im2col ? ic*kh*kw : ic;
+		}
+		//n of gemm for output rows
+		size_t columns(const size_t rows) const
+		{
+			return rows*ow;
+		}
+		//floats of scratch after sgemm's packing
+		size_t scratchFloats(const size_t rows) const
+		{
+			return path == ConvolutionPath::Im2col ? depth()*columns(rows) : 0;
+		}
+		size_t workspaceBytes(const size_t rows) const
+		{
+			return sgemm_workspace_size(oc, columns(rows), depth()) + scratchFloats(rows)*sizeof(float);
+		}
+		size_t ic, ih, iw, oc, kh, kw, oh, ow;
+		size_t ws, hs, padTop, padLeft;
+		ConvolutionPath path;
+	};
+
+	//columns(ic*kh*kw, rows*ow) of output rows [rowStart,rowStop), padding is 0.
+	//bounds are solved once per kernel column, a row of step 1 is one copy.
+	static void im2col(const ConvolutionShape& shape, const float* input, const size_t channelStride,
+		const size_t rowStart, const size_t rowStop, float* columns)
+	{
+		const size_t rowLength = (rowStop - rowStart)*shape.ow;
+		for (size_t x = 0; x < shape.kw; x++)
+		{
+			//outputs [oxStart,oxStop) read inside of input row, ix = ox*ws + x - padLeft
+			const size_t oxStart = std::min(shape.ow, x >= shape.padLeft ? 0 : (shape.padLeft - x + shape.ws - 1) / shape.ws);
+			const size_t oxEnd = (shape.iw + shape.padLeft > x) ? (shape.iw + shape.padLeft - x + shape.ws - 1) / shape.ws : 0;
+			const size_t oxStop = std::max(oxStart, std::min(shape.ow, oxEnd));
+			for (size_t c = 0; c < shape.ic; c++)
+			{
+				const float* channel = input + c*channelStride;
+				for (size_t y = 0; y < shape.kh; y++)
+				{
+					float* dst = columns + ((c*shape.kh + y)*shape.kw + x)*rowLength;
+					for (size_t oy = rowStart; oy < rowStop; oy++, dst += shape.ow)
+					{
+						const int iy = (int)(oy*shape.hs + y) - (int)shape.padTop;
+						if (iy < 0 || iy >= (int)shape.ih)
+						{
+							std::fill(dst, dst + shape.ow, 0.0f);
+							continue;
+						}
+						const float* src = channel + iy*shape.iw;
+						std::fill(dst, dst + oxStart, 0.0f);
+						if (shape.ws == 1)
+						{
+							std::copy(src + oxStart + x - shape.padLeft, src + oxStop + x - shape.padLeft, dst + oxStart);
+						}
+						else
+						{
+							for (size_t ox = oxStart; ox < oxStop; ox++)
+							{
+								dst[ox] = src[ox*shape.ws + x - shape.padLeft];
+							}
+						}
+						std::fill(dst + oxStop, dst + shape.ow, 0.0f);
+					}
+				}
+			}
+		}
+	}
+
+	void convolution2d_gemm(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode)
+	{
+		convolution2d_gemm(input, kernel, bias, output, kws, khs, mode, 0, output.getSize().height);
+	}
+	void convolution2d_gemm(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop)
+	{
+		easyAssert(input.getSize().number == output.getSize().number, "number of input and output must be equal.");
+		easyAssert(input.getSize().channels == kernel.getSize().channels && output.getSize().channels == kernel.getSize().number,
+			"channels of kernel is invalidate.");
+		easyAssert(rowStart <= rowStop && rowStop <= output.getSize().height, "rows are out of output.");
+		easyAssert(input.isSampleDense() && kernel.isSampleDense() && output.isSampleDense(), "every sample must be dense.");
+		if (rowStart == rowStop)
+		{
+			return;
+		}
+		const ConvolutionShape shape(input.getSize(), kernel.getSize(), output.getSize(), kws, khs, mode);
+		const size_t rows = rowStop - rowStart;
+		const size_t gemmBytes = sgemm_workspace_size(shape.oc, shape.columns(rows), shape.depth());
+		//taken once at full size, sgemm finds it big enough and doesn't move it
+		float* const scratch = get_workspace(shape.workspaceBytes(rows)) + gemmBytes / sizeof(float);
+		const float* kernelData = kernel.getData();
+		for (size_t nn = 0; nn < input.getSize().number; nn++)
+		{
+			const float* inputData = input.getSampleData(nn);
+			float* outputData = output.getSampleData(nn);
+			switch (shape.path)
+			{
+			case ConvolutionPath::Pointwise:
+				sgemm(false, false, shape.oc, rows*shape.ow, shape.ic, 1.0f, kernelData, kernel.numberStride,
+					inputData + rowStart*shape.iw, input.channelStride, 0.0f, outputData + rowStart*shape.ow, output.channelStride);
+				break;
+			case ConvolutionPath::Im2col:
+				im2col(shape, inputData, input.channelStride, rowStart, rowStop, scratch);
+				sgemm(false, false, shape.oc, rows*shape.ow, shape.depth(), 1.0f, kernelData, kernel.numberStride,
+					scratch, rows*shape.ow, 0.0f, outputData + rowStart*shape.ow, output.channelStride);
+				break;
+			}
+			if (bias)
+			{
+				for (size_t o = 0; o < shape.oc; o++)
+				{
+					float* dst = outputData + o*output.channelStride + rowStart*shape.ow;
+					for (size_t i = 0; i < rows*shape.ow; i++)
+					{
+						dst[i] += bias[o];
+					}
+				}
+			}
+		}
+	}
+	size_t convolution2d_gemm_workspace_size(const DataSize& inputSize, const DataSize& kernelSize, const DataSize& outputSize,
+		const size_t kws, const size_t khs, const int mode)
+	{
+		//a range has all rows of a sample at most
+		const ConvolutionShape shape(inputSize, kernelSize, outputSize, kws, khs, mode);
+		return shape.workspaceBytes(outputSize.height);
+	}
+}//namespace
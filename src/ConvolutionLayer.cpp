@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sstream>
 #include "EasyCNN/ConvolutionLayer.h"
 #include "EasyCNN/CommonTools.h"
@@ -29,6 +30,14 @@ namespace EasyCNN
 		enabledBias = _enabledBias;
 		padddingType = _padddingType;
 	}
+	void ConvolutionLayer::setAlgorithm(const Algorithm _algorithm)
+	{
+		algorithm = _algorithm;
+	}
+	ConvolutionLayer::Algorithm ConvolutionLayer::getAlgorithm() const
+	{
+		return algorithm;
+	}
 	std::string ConvolutionLayer::serializeToString() const
 	{
 		const std::string spliter = " ";
@@ -83,6 +92,10 @@ namespace EasyCNN
 				ss >> biasData[i];
 			}
 		}
+		//weights are new
+		winogradKernelReady = false;
+		blockedKernelReady = false;
+		nhwcKernelReady = false;
 	}
 	DEFINE_LAYER_TYPE(ConvolutionLayer, "ConvolutionLayer");
 	std::string ConvolutionLayer::getLayerType() const
@@ -111,9 +124,30 @@ namespace EasyCNN
 		}
 		setOutpuBuckerSize(outputSize);
 		easyAssert(outputSize.number > 0 && outputSize.channels > 0 && outputSize.width > 0 && outputSize.height > 0, "output size is invalidate.");
+		//layout is picked by network, forward of NCHW layout runs gemm for BLOCKED
+		forwardAlgorithm = (algorithm == AUTO) ? selectAlgorithm() : (algorithm == BLOCKED ? GEMM : algorithm);
+		if (forwardAlgorithm == WINOGRAD_2X2 || forwardAlgorithm == WINOGRAD_4X4)
+		{
+			easyAssert(kernelSize.width == 3 && kernelSize.height == 3 && widthStep == 1 && heightStep == 1,
+				"winograd needs 3x3 kernel of step 1.");
+			const size_t tile = (forwardAlgorithm == WINOGRAD_2X2) ? 2 : 4;
+			const size_t transformedSize = winograd_kernel_size(tile, kernelSize);
+			if (winogradKernel.get() == nullptr || winogradKernel->getSize().totalSize() != transformedSize)
+			{
+				winogradKernel.reset(new ParamBucket(ParamSize(1, 1, 1, transformedSize), getMemoryPool()));
+			}
+			winogradKernelReady = false;
+			setWorkspaceSize(convolution2d_winograd_workspace_size(tile, inputSize, outputSize));
+		}
+		else
+		{
+			winogradKernel.reset();
+			setWorkspaceSize(forwardAlgorithm == GEMM ?
+				convolution2d_gemm_workspace_size(inputSize, kernelSize, outputSize, widthStep, heightStep, (int)padddingType) : 0);
+		}
 		if (kernel.get() == nullptr)
 		{
-			kernel.reset(new ParamBucket(kernelSize));
+			kernel.reset(new ParamBucket(kernelSize, getMemoryPool()));
 			normal_distribution_init(kernel->getData().get(), kernel->getSize().totalSize(), 0.0f, 0.1f);
 			/*
 			const size_t fan_in = inputSize._2DSize();
@@ -121,21 +155,21 @@ namespace EasyCNN
 			xavier_init(kernel->getData().get(), kernel->getSize().totalSize(), fan_in, fan_out);
 			*/
 		}
-		if (kernelGradient.get() == nullptr)
+		if (getPhase() == Phase::Train && kernelGradient.get() == nullptr)
 		{
-			kernelGradient.reset(new ParamBucket(kernel->getSize()));
+			kernelGradient.reset(new ParamBucket(kernel->getSize(), getMemoryPool()));
 			const_distribution_init(kernelGradient->getData().get(), kernelGradient->getSize().totalSize(), 0.0f);
 		}
 		if (enabledBias)
 		{
 			if (bias.get() == nullptr)
 			{
-				bias.reset(new ParamBucket(ParamSize(kernelSize.number, 1, 1, 1)));
+				bias.reset(new ParamBucket(ParamSize(kernelSize.number, 1, 1, 1), getMemoryPool()));
 				const_distribution_init(bias->getData().get(), bias->getSize().totalSize(), 0.0f);
 			}
-			if (biasGradient.get() == nullptr)
+			if (getPhase() == Phase::Train && biasGradient.get() == nullptr)
 			{
-				biasGradient.reset(new ParamBucket(bias->getSize()));
+				biasGradient.reset(new ParamBucket(bias->getSize(), getMemoryPool()));
 				const_distribution_init(biasGradient->getData().get(), biasGradient->getSize().totalSize(), 0.0f);
 			}
 		}
@@ -148,25 +182,176 @@ namespace EasyCNN
 		gradients.push_back(kernelGradient);
 		gradients.push_back(biasGradient);
 	}
-	void ConvolutionLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void ConvolutionLayer::releaseTrainingState()
+	{
+		Layer::releaseTrainingState();
+		kernelGradient.reset();
+		biasGradient.reset();
+	}
+	void ConvolutionLayer::onParamsChanged()
+	{
+		winogradKernelReady = false;
+		blockedKernelReady = false;
+		nhwcKernelReady = false;
+	}
+	//from convolution benchmark : with few input channels gemm has short depth, and direct loops on blocked layout
+	//win(3x faster for 1 input channel, about even at 32). 1x1 kernels are plain gemm already.
+	bool ConvolutionLayer::preferBlockedLayout() const
+	{
+		if (algorithm == AUTO)
+		{
+			return kernelSize._2DSize() > 1 && inputSize.channels < 32;
+		}
+		return algorithm == BLOCKED;
+	}
+	void ConvolutionLayer::setBlockedLayout(const bool blocked)
+	{
+		Layer::setBlockedLayout(blocked);
+		if (!blocked)
+		{
+			blockedKernel.reset();
+			blockedBias.reset();
+			return;
+		}
+		const DataSize blockedKernelSize = blocked_kernel_size(kernelSize);
+		if (blockedKernel.get() == nullptr || blockedKernel->getSize() != blockedKernelSize)
+		{
+			blockedKernel.reset(new ParamBucket(blockedKernelSize, getMemoryPool()));
+			blockedBias.reset(new ParamBucket(ParamSize(blockedKernelSize.number*CHANNEL_BLOCK, 1, 1, 1), getMemoryPool()));
+		}
+		blockedKernelReady = false;
+	}
+	void ConvolutionLayer::setNHWCLayout(const bool nhwc)
+	{
+		Layer::setNHWCLayout(nhwc);
+		if (!nhwc)
+		{
+			nhwcKernel.reset();
+			return;
+		}
+		if (nhwcKernel.get() == nullptr || nhwcKernel->getSize() != kernelSize)
+		{
+			nhwcKernel.reset(new ParamBucket(kernelSize, getMemoryPool()));
+			nhwcKernel->setLayout(Layout::NHWC);
+		}
+		nhwcKernelReady = false;
+		//network reserves it after layout is planned
+		setWorkspaceSize(std::max(getWorkspaceSize(), convolution2d_nhwc_workspace_size(inputSize, kernelSize, outputSize,
+			widthStep, heightStep, (int)padddingType)));
+	}
+	//from convolution benchmark : winograd pays for its transforms when there are enough channels to multiply,
+	//and its gemms need enough tiles(larger tiles on larger maps). direct loops never win against gemm.
+	ConvolutionLayer::Algorithm ConvolutionLayer::selectAlgorithm() const
+	{
+		const size_t minChannels = std::min(inputSize.channels, outputSize.channels);
+		const size_t minSide = std::min(outputSize.width, outputSize.height);
+		if (kernelSize.width == 3 && kernelSize.height == 3 && widthStep == 1 && heightStep == 1 && minChannels >= 32)
+		{
+			if (minSide >= 24)
+			{
+				return WINOGRAD_4X4;
+			}
+			if (minSide >= 12)
+			{
+				return WINOGRAD_2X2;
+			}
+		}
+		return GEMM;
+	}
+	//backward regions(prevDiff, kernel gradient) do the same multiply-adds each
+	LayerCost ConvolutionLayer::getForwardCost(const size_t number) const
+	{
+		const double outputs = (double)number*outputSize._3DSize();
+		const double elements = (double)number*(inputSize._3DSize() + outputSize._3DSize()) + kernelSize.totalSize();
+		return LayerCost(2.0*outputs*kernelSize._3DSize(), sizeof(float)*elements);
+	}
+	void ConvolutionLayer::forward(const TensorView& prev, const TensorView& next)
 	{
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
+		const DataSize nextSize = next.getSize();
 
-		const float* prevData = prev->getData().get();
-		const float* kernelData = kernel->getData().get();
-		const float* biasData = bias->getData().get();
-		float* nextData = next->getData().get();
+		const TensorView kernelView = kernel->getView();
+		const float* biasData = enabledBias ? bias->getData().get() : nullptr;
 
-		auto worker = [&](const size_t start, const size_t stop){
-			convolution2d(prevData + start*prevSize._3DSize(), kernelData, biasData, nextData + start*nextSize._3DSize(),
-				stop-start, prevSize.channels, prevSize.width, prevSize.height, 
-				kernelSize.number,kernelSize.width, kernelSize.height, widthStep, heightStep,
-				nextSize.width, nextSize.height,(int)padddingType);
-		};
-		dispatch_worker(worker, prevSize.number);
+		if (isBlockedLayout())
+		{
+			if (!blockedKernelReady)
+			{
+				blocked_transform_kernel(kernelView, biasData, blockedKernel->getView(), blockedBias->getData().get());
+				blockedKernelReady = true;
+			}
+			const TensorView blockedKernelView = blockedKernel->getView();
+			const float* blockedBiasData = enabledBias ? blockedBias->getData().get() : nullptr;
+			//split over samples, output channel blocks and rows
+			const size_t blocks = blockedKernelView.getSize().number;
+			auto worker = [&](const size_t nn, const size_t nb, const size_t rowStart, const size_t rowStop){
+				convolution2d_blocked(prev.slice(nn, 1), blockedKernelView.slice(nb, 1), blockedBiasData ? blockedBiasData + nb*CHANNEL_BLOCK : nullptr,
+					next.slice(nn, 1).sliceChannels(nb, 1), widthStep, heightStep, (int)padddingType, rowStart, rowStop);
+			};
+			parallel_for_3d(nextSize.number, blocks, nextSize.height,
+				get_parallel_grain({ nextSize.number, blocks, nextSize.height }, getForwardCost(nextSize.number)), worker);
+		}
+		else if (isNHWCLayout())
+		{
+			if (!nhwcKernelReady)
+			{
+				nchw_to_nhwc(kernelView, nhwcKernel->getView());
+				nhwcKernelReady = true;
+			}
+			const TensorView nhwcKernelView = nhwcKernel->getView();
+			//split over samples and blocks of rows, every range gathers pixels of its own rows only
+			const size_t blockRows = convolution2d_nhwc_block_rows(nextSize);
+			const size_t rowBlocks = (nextSize.height + blockRows - 1) / blockRows;
+			auto worker = [&](const size_t nn, const size_t blockStart, const size_t blockStop){
+				convolution2d_nhwc(prev.slice(nn, 1), nhwcKernelView, biasData, next.slice(nn, 1),
+					widthStep, heightStep, (int)padddingType, blockStart*blockRows, std::min(nextSize.height, blockStop*blockRows));
+			};
+			parallel_for_2d(nextSize.number, rowBlocks,
+				get_parallel_grain({ nextSize.number, rowBlocks }, getForwardCost(nextSize.number)), worker);
+		}
+		else if (forwardAlgorithm == WINOGRAD_2X2 || forwardAlgorithm == WINOGRAD_4X4)
+		{
+			const size_t tile = (forwardAlgorithm == WINOGRAD_2X2) ? 2 : 4;
+			if (!winogradKernelReady)
+			{
+				winograd_transform_kernel(tile, kernelView, winogradKernel->getData().get());
+				winogradKernelReady = true;
+			}
+			const float* transformedKernel = winogradKernel->getData().get();
+			//split over samples and rows of tiles
+			const size_t tileRows = (nextSize.height + tile - 1) / tile;
+			auto worker = [&](const size_t nn, const size_t tileRowStart, const size_t tileRowStop){
+				convolution2d_winograd(tile, prev.slice(nn, 1), transformedKernel, biasData, next.slice(nn, 1),
+					(int)padddingType, tileRowStart*tile, std::min(nextSize.height, tileRowStop*tile));
+			};
+			parallel_for_2d(nextSize.number, tileRows,
+				get_parallel_grain({ nextSize.number, tileRows }, getForwardCost(nextSize.number)), worker);
+		}
+		else if (forwardAlgorithm == GEMM)
+		{
+			//split over samples and rows, every range builds columns of its own rows only
+			auto worker = [&](const size_t nn, const size_t rowStart, const size_t rowStop){
+				convolution2d_gemm(prev.slice(nn, 1), kernelView, biasData, next.slice(nn, 1),
+					widthStep, heightStep, (int)padddingType, rowStart, rowStop);
+			};
+			parallel_for_2d(nextSize.number, nextSize.height,
+				get_parallel_grain({ nextSize.number, nextSize.height }, getForwardCost(nextSize.number)), worker);
+		}
+		else
+		{
+			//split over samples, output channels and rows, so batch 1 still uses every thread
+			auto worker = [&](const size_t nn, const size_t nc, const size_t rowStart, const size_t rowStop){
+				convolution2d(prev.slice(nn, 1), kernelView.slice(nc, 1), biasData ? biasData + nc : nullptr, next.slice(nn, 1).sliceChannels(nc, 1),
+					widthStep, heightStep, (int)padddingType, rowStart, rowStop);
+			};
+			parallel_for_3d(nextSize.number, nextSize.channels, nextSize.height,
+				get_parallel_grain({ nextSize.number, nextSize.channels, nextSize.height }, getForwardCost(nextSize.number)), worker);
+		}
 
 #if WITH_OPENCV_DEBUG
+		const DataSize prevSize = prev.getSize();
+		const float* prevData = prev.getData();
+		const float* kernelData = kernelView.getData();
+		const float* nextData = next.getData();
 		//input image
 		for (size_t pn = 0; pn < prevSize.number; pn++)
 		{
@@ -222,54 +407,53 @@ namespace EasyCNN
 		cv::destroyAllWindows();
 #endif //WITH_OPENCV_DEBUG
 	}
-	void ConvolutionLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void ConvolutionLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
+	{
+		backwardDiff(prev, next, prevDiff, nextDiff);
+		backwardGradient(prev, next, nextDiff);
+	}
+	void ConvolutionLayer::backwardDiff(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
-		const ParamSize biasSize = bias->getSize();
-		const float* prevData = prev->getData().get();
-		const float* nextData = next->getData().get();
-		float* prevDiffData = prevDiff->getData().get();
-		const float* nextDiffData = nextDiff->getData().get();
-		float *kernelData = kernel->getData().get();
-		float *biasData = bias->getData().get();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
+		float* prevDiffData = prevDiff.getData();
+		const float* nextDiffData = nextDiff.getData();
+		const float *kernelData = kernel->getData().get();
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 
 		//////////////////////////////////////////////////////////////////////////
 		//update prevDiff
-		prevDiff->fillData(0.0f);
+		//prevDiff is cleared by network(accumulate mode)
 		//calculate current inner diff
-		auto worker = [&](const size_t start, const size_t stop){
-			for (size_t nn = start; nn < stop; nn++)
+		//split over samples and input channels, every channel of prevDiff is written by one range
+		auto worker = [&](const size_t nn, const size_t kcStart, const size_t kcStop){
+			for (size_t kc = kcStart; kc < kcStop; kc++)
 			{
 				for (size_t nc = 0; nc < nextSize.channels; nc++)
 				{
+					const size_t kn = nc;
 					for (size_t nh = 0; nh < nextSize.height; nh++)
 					{
 						for (size_t nw = 0; nw < nextSize.width; nw++)
 						{
 							const size_t inStartX = nw*widthStep;
 							const size_t inStartY = nh*heightStep;
-							const size_t nextDiffIdx = nextSize.getIndex(nn, nc, nh, nw);
-							const size_t kn = nc;
-							for (size_t kc = 0; kc < kernelSize.channels; kc++)
+							const size_t nextDiffIdx = nextDiff.getIndex(nn, nc, nh, nw);
+							for (size_t kh = 0; kh < kernelSize.height; kh++)
 							{
-								for (size_t kh = 0; kh < kernelSize.height; kh++)
+								for (size_t kw = 0; kw < kernelSize.width; kw++)
 								{
-									for (size_t kw = 0; kw < kernelSize.width; kw++)
+									const size_t inY = inStartY + kh;
+									const size_t inX = inStartX + kw;
+									if (inY >= 0 && inY < inputSize.height && inX >= 0 && inX < inputSize.width)
 									{
-										const size_t inY = inStartY + kh;
-										const size_t inX = inStartX + kw;
-										if (inY >= 0 && inY < inputSize.height && inX >= 0 && inX < inputSize.width)
-										{
-											const size_t prevDiffIdx = prevDiffSize.getIndex(nn, kc, inY, inX);
-											const size_t kernelIdx = kernelSize.getIndex(kn, kc, kh, kw);
-											prevDiffData[prevDiffIdx] += kernelData[kernelIdx] * nextDiffData[nextDiffIdx];
-										}
+										const size_t prevDiffIdx = prevDiff.getIndex(nn, kc, inY, inX);
+										const size_t kernelIdx = kernelSize.getIndex(kn, kc, kh, kw);
+										prevDiffData[prevDiffIdx] += kernelData[kernelIdx] * nextDiffData[nextDiffIdx];
 									}
 								}
 							}
@@ -278,68 +462,78 @@ namespace EasyCNN
 				}
 			}
 		};
-		dispatch_worker(worker, prevSize.number);
+		parallel_for_2d(prevSize.number, kernelSize.channels,
+			get_parallel_grain({ prevSize.number, kernelSize.channels }, getBackwardCost(prevSize.number)), worker);
+	}
+	void ConvolutionLayer::backwardGradient(const TensorView& prev, const TensorView& next, const TensorView& nextDiff)
+	{
+		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
+		const DataSize nextSize = next.getSize();
+		const DataSize nextDiffSize = nextDiff.getSize();
+		const ParamSize biasSize = bias->getSize();
+		const float* prevData = prev.getData();
+		const float* nextDiffData = nextDiff.getData();
 
 		//////////////////////////////////////////////////////////////////////////
 		//update this layer's param
 		const ParamSize kernelGradientSize(kernelSize);
-		kernelGradient->fillData(0.0f);
 		float* kernelGradientData = kernelGradient->getData().get();
-		//update kernel gradient
-		for (size_t nn = 0; nn < nextSize.number; nn++)
-		{
-			for (size_t nc = 0; nc < nextSize.channels; nc++)
+		//update kernel gradient, every element is overwritten
+		auto kernelGradientWorker = [&](const size_t kn, const size_t kcStart, const size_t kcStop){
+			const size_t nc = kn;
+			for (size_t kc = kcStart; kc < kcStop; kc++)
 			{
-				for (size_t nh = 0; nh < nextSize.height; nh++)
+				for (size_t kh = 0; kh < kernelSize.height; kh++)
 				{
-					for (size_t nw = 0; nw < nextSize.width; nw++)
+					for (size_t kw = 0; kw < kernelSize.width; kw++)
 					{
-						const size_t inStartX = nw*widthStep;
-						const size_t inStartY = nh*heightStep;
-						const size_t nextDiffIdx = nextSize.getIndex(nn, nc, nh, nw);
-						const size_t kn = nc;
-						for (size_t kc = 0; kc < kernelSize.channels; kc++)
+						float sum = 0.0f;
+						for (size_t nn = 0; nn < nextSize.number; nn++)
 						{
-							for (size_t kh = 0; kh < kernelSize.height; kh++)
+							for (size_t nh = 0; nh < nextSize.height; nh++)
 							{
-								for (size_t kw = 0; kw < kernelSize.width; kw++)
+								for (size_t nw = 0; nw < nextSize.width; nw++)
 								{
-									const size_t inY = inStartY + kh;
-									const size_t inX = inStartX + kw;
+									const size_t inY = nh*heightStep + kh;
+									const size_t inX = nw*widthStep + kw;
 									if (inY >= 0 && inY < inputSize.height && inX >= 0 && inX < inputSize.width)
 									{
-										const size_t kernelGradientIdx = kernelGradientSize.getIndex(kn, kc, kh, kw);
-										const size_t prevIdx = prevSize.getIndex(nn, kc, inY, inX);
-										kernelGradientData[kernelGradientIdx] += prevData[prevIdx] * nextDiffData[nextDiffIdx];
+										const size_t nextDiffIdx = nextDiff.getIndex(nn, nc, nh, nw);
+										const size_t prevIdx = prev.getIndex(nn, kc, inY, inX);
+										sum += prevData[prevIdx] * nextDiffData[nextDiffIdx];
 									}
 								}
 							}
 						}
+						kernelGradientData[kernelGradientSize.getIndex(kn, kc, kh, kw)] = sum;
 					}
 				}
 			}
-		}
+		};
+		parallel_for_2d(kernelSize.number, kernelSize.channels,
+			get_parallel_grain({ kernelSize.number, kernelSize.channels }, getBackwardCost(nextSize.number)), kernelGradientWorker);
 		//div by batch size
 		div_inplace(kernelGradientData, (float)nextSize.number, kernelSize.totalSize());		
 
 		//////////////////////////////////////////////////////////////////////////
-		//update bias gradient
-		biasGradient->fillData(0.0f);
+		//update bias gradient, every element is overwritten
 		float* biasGradientData = biasGradient->getData().get();
-		for (size_t nn = 0; nn < nextDiffSize.number; nn++)
+		for (size_t nc = 0; nc < nextDiffSize.channels; nc++)
 		{
-			for (size_t nc = 0; nc < nextDiffSize.channels; nc++)
+			const size_t biasGradientIdx = nc;
+			float sum = 0.0f;
+			for (size_t nn = 0; nn < nextDiffSize.number; nn++)
 			{
-				const size_t biasGradientIdx = nc;
 				for (size_t nh = 0; nh < nextDiffSize.height; nh++)
 				{
 					for (size_t nw = 0; nw < nextDiffSize.width; nw++)
 					{
-						const size_t nextDiffIdx = nextDiffSize.getIndex(nn, nc, nh, nw);
-						biasGradientData[biasGradientIdx] += 1.0f*nextDiffData[nextDiffIdx];
+						const size_t nextDiffIdx = nextDiff.getIndex(nn, nc, nh, nw);
+						sum += 1.0f*nextDiffData[nextDiffIdx];
 					}
 				}
 			}
+			biasGradientData[biasGradientIdx] = sum;
 		}
 		//div by batch size
 		div_inplace(biasGradientData, (float)nextSize.number, biasSize.totalSize());
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "EasyCNN/CostModel.h"
+#include "EasyCNN/ThreadPool.h"
+
+namespace EasyCNN
+{
+	static ParallelCostModel costModel;
+	//keeps measured loops alive
+	static volatile float calibrationSink = 0.0f;
+
+	static double nowNanoseconds()
+	{
+		return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	static void busyWait(const double nanoseconds)
+	{
+		const double deadline = nowNanoseconds() + nanoseconds;
+		while (nowNanoseconds() < deadline)
+		{
+			//spin
+		}
+	}
+	//fork-join overhead of p parts of fixed work : elapsed - work of one part
+	static double measureForkJoin(const size_t parts)
+	{
+		const double partNanoseconds = 5000.0;
+		const size_t iterations = 200;
+		auto worker = [&](const size_t start, const size_t stop){
+			busyWait(partNanoseconds*(stop - start));
+		};
+		parallel_for(0, parts, 1, worker);
+		const double start = nowNanoseconds();
+		for (size_t i = 0; i < iterations; i++)
+		{
+			parallel_for(0, parts, 1, worker);
+		}
+		const double elapsed = (nowNanoseconds() - start) / iterations;
+		return std::max(elapsed - partNanoseconds, 0.0);
+	}
+
+	void set_parallel_cost_model(const ParallelCostModel& model)
+	{
+		costModel = model;
+	}
+	ParallelCostModel get_parallel_cost_model()
+	{
+		return costModel;
+	}
+	ParallelCostModel calibrate_parallel_cost()
+	{
+		ParallelCostModel model = costModel;
+		//multiply-add in cache
+		{
+			std::vector<float> a(4096, 1.0f);
+			std::vector<float> b(4096, 0.5f);
+			const size_t repeats = 2000;
+			float sum = 0.0f;
+			const double start = nowNanoseconds();
+			for (size_t r = 0; r < repeats; r++)
+			{
+				for (size_t i = 0; i < a.size(); i++)
+				{
+					sum += a[i] * b[i];
+				}
+				a[r % a.size()] = sum * 1e-9f;
+			}
+			const double elapsed = nowNanoseconds() - start;
+			calibrationSink = sum;
+			model.flopsPerNanosecond = 2.0*a.size()*repeats / std::max(elapsed, 1.0);
+		}
+		//streaming copy out of cache
+		{
+			std::vector<float> src(4 * 1024 * 1024, 1.0f);
+			std::vector<float> dst(src.size(), 0.0f);
+			const size_t repeats = 5;
+			const double start = nowNanoseconds();
+			for (size_t r = 0; r < repeats; r++)
+			{
+				std::copy(src.begin(), src.end(), dst.begin());
+				src[r] = dst[src.size() - 1 - r];
+			}
+			calibrationSink = dst[repeats];
+			const double elapsed = nowNanoseconds() - start;
+			model.bytesPerNanosecond = 2.0*sizeof(float)*src.size()*repeats / std::max(elapsed, 1.0);
+		}
+		//fork-join of 2 and of all threads
+		const size_t threads = get_parallel_threads();
+		if (threads > 1)
+		{
+			const double twoThreads = measureForkJoin(2);
+			const double allThreads = (threads > 2) ? measureForkJoin(threads) : twoThreads;
+			model.perThreadNanoseconds = (threads > 2) ? std::max((allThreads - twoThreads) / (threads - 2), 0.0) : 0.0;
+			model.forkJoinNanoseconds = std::max(twoThreads - 2.0*model.perThreadNanoseconds, 0.0);
+		}
+		costModel = model;
+		return model;
+	}
+	double get_serial_nanoseconds(const LayerCost& cost)
+	{
+		const ParallelCostModel& model = costModel;
+		return std::max(cost.flops / model.flopsPerNanosecond, cost.bytes / model.bytesPerNanosecond);
+	}
+	size_t get_parallel_threads_for(const LayerCost& cost)
+	{
+		const size_t threads = get_parallel_threads();
+		const ParallelCostModel& model = costModel;
+		const double serial = get_serial_nanoseconds(cost);
+		size_t best = 1;
+		double bestTime = serial;
+		for (size_t p = 2; p <= threads; p++)
+		{
+			const double time = serial / p + model.forkJoinNanoseconds + model.perThreadNanoseconds*p;
+			if (time < bestTime)
+			{
+				best = p;
+				bestTime = time;
+			}
+		}
+		return best;
+	}
+	size_t get_parallel_grain(std::initializer_list<size_t> dims, const LayerCost& cost)
+	{
+		size_t cells = 1;
+		for (const size_t dim : dims)
+		{
+			cells *= dim;
+		}
+		const size_t parts = std::min(get_parallel_threads_for(cost), cells);
+		if (parts <= 1)
+		{
+			return std::max<size_t>(cells, 1);
+		}
+		//whole inner blocks unless parts of outer are uneven by more than 1/4
+		size_t outer = 1;
+		for (const size_t dim : dims)
+		{
+			outer *= dim;
+			const size_t outerGrain = (outer + parts - 1) / parts;
+			if (outer >= parts && outerGrain*parts * 4 <= outer * 5)
+			{
+				return outerGrain * (cells / outer);
+			}
+		}
+		return (cells + parts - 1) / parts;
+	}
+}//namespace
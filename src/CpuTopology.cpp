@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include "EasyCNN/CpuTopology.h"
+#include "EasyCNN/EasyAssert.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace EasyCNN
+{
+	struct CpuTopology
+	{
+		std::vector<std::vector<size_t>> nodes;
+		//cpu => node
+		std::vector<size_t> cpuNodes;
+	};
+#ifdef __linux__
+	//"0-3,8-11" of /sys
+	static std::vector<size_t> parseCpuList(const std::string& line)
+	{
+		std::vector<size_t> cpus;
+		std::stringstream ss(line);
+		std::string range;
+		while (std::getline(ss, range, ','))
+		{
+			if (range.empty() || range[0] < '0' || range[0] > '9')
+			{
+				continue;
+			}
+			const size_t dash = range.find('-');
+			const size_t first = std::stoul(range.substr(0, dash));
+			const size_t last = (dash == std::string::npos) ? first : std::stoul(range.substr(dash + 1));
+			for (size_t cpu = first; cpu <= last; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		return cpus;
+	}
+#endif //__linux__
+	static CpuTopology readTopology()
+	{
+		CpuTopology topology;
+#ifdef __linux__
+		//node ids may have holes
+		for (size_t node = 0; node < 64; node++)
+		{
+			std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			std::string line;
+			if (!ifs.is_open() || !std::getline(ifs, line))
+			{
+				continue;
+			}
+			const std::vector<size_t> cpus = parseCpuList(line);
+			if (!cpus.empty())
+			{
+				topology.nodes.push_back(cpus);
+			}
+		}
+#elif defined(_WIN32)
+		//processor group 0 only
+		ULONG highestNode = 0;
+		if (GetNumaHighestNodeNumber(&highestNode))
+		{
+			for (ULONG node = 0; node <= highestNode; node++)
+			{
+				ULONGLONG mask = 0;
+				if (!GetNumaNodeProcessorMask((UCHAR)node, &mask))
+				{
+					continue;
+				}
+				std::vector<size_t> cpus;
+				for (size_t cpu = 0; cpu < 64; cpu++)
+				{
+					if (mask & (1ULL << cpu))
+					{
+						cpus.push_back(cpu);
+					}
+				}
+				if (!cpus.empty())
+				{
+					topology.nodes.push_back(cpus);
+				}
+			}
+		}
+#endif
+		if (topology.nodes.empty())
+		{
+			const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+			std::vector<size_t> cpus;
+			for (size_t cpu = 0; cpu < cores; cpu++)
+			{
+				cpus.push_back(cpu);
+			}
+			topology.nodes.push_back(cpus);
+		}
+		for (size_t node = 0; node < topology.nodes.size(); node++)
+		{
+			for (const size_t cpu : topology.nodes[node])
+			{
+				if (cpu >= topology.cpuNodes.size())
+				{
+					topology.cpuNodes.resize(cpu + 1, 0);
+				}
+				topology.cpuNodes[cpu] = node;
+			}
+		}
+		return topology;
+	}
+	static const CpuTopology& topology()
+	{
+		static const CpuTopology inst = readTopology();
+		return inst;
+	}
+
+	size_t get_numa_node_count()
+	{
+		return topology().nodes.size();
+	}
+	const std::vector<size_t>& get_numa_node_cpus(const size_t node)
+	{
+		easyAssert(node < get_numa_node_count(), "numa node is out of range.");
+		return topology().nodes[node];
+	}
+	size_t get_numa_node_of_cpu(const size_t cpu)
+	{
+		const std::vector<size_t>& cpuNodes = topology().cpuNodes;
+		return cpu < cpuNodes.size() ? cpuNodes[cpu] : 0;
+	}
+	size_t get_current_cpu()
+	{
+#ifdef __linux__
+		const int cpu = sched_getcpu();
+		return cpu < 0 ? 0 : (size_t)cpu;
+#elif defined(_WIN32)
+		return (size_t)GetCurrentProcessorNumber();
+#else
+		return 0;
+#endif
+	}
+#ifdef __linux__
+	//affinity of process before any thread was pinned (taskset, cgroup cpuset), unpin goes back to it
+	static const cpu_set_t& startupAffinity()
+	{
+		static const cpu_set_t inst = [](){
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0)
+			{
+				for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+				{
+					CPU_SET(cpu, &cpus);
+				}
+			}
+			return cpus;
+		}();
+		return inst;
+	}
+	//captured at load time by main thread
+	static const cpu_set_t& startupAffinityInit = startupAffinity();
+#endif //__linux__
+	bool pin_current_thread(const size_t cpu)
+	{
+#ifdef __linux__
+		if (cpu >= CPU_SETSIZE)
+		{
+			return false;
+		}
+		//in case pinning happens before static initialization of this file
+		startupAffinity();
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		//0 : calling thread, bionic has no pthread_setaffinity_np
+		return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#elif defined(_WIN32)
+		if (cpu >= 64)
+		{
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#else
+		return false;
+#endif
+	}
+	bool unpin_current_thread()
+	{
+#ifdef __linux__
+		cpu_set_t cpus = startupAffinity();
+		return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#elif defined(_WIN32)
+		DWORD_PTR processMask = 0;
+		DWORD_PTR systemMask = 0;
+		if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+		{
+			return false;
+		}
+		return SetThreadAffinityMask(GetCurrentThread(), processMask) != 0;
+#else
+		return false;
+#endif
+	}
+}//namespace
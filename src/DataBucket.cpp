@@ -1,11 +1,32 @@
 #include <algorithm>
+#include <cstring>
 #include "EasyCNN/DataBucket.h"
+#include "EasyCNN/ThreadPool.h"
 
 namespace EasyCNN
 {
 	DataBucket::DataBucket(const DataSize _size)
+		:DataBucket(_size, MemoryPool::defaultPool())
+	{
+
+	}
+	DataBucket::DataBucket(const DataSize _size, const std::shared_ptr<MemoryPool> _pool)
+		:size(_size),
+		capacity(MemoryPool::getSizeClass(sizeof(float)*_size.totalSize()) / sizeof(float)),
+		pool(_pool),
+		data(make_pooled_buffer(_pool, _size.totalSize()))
+	{
+		first_touch(data.get(), capacity);
+	}
+	DataBucket::DataBucket(const DataSize _size, const std::shared_ptr<float> _data)
 		:size(_size),
-		data(new float[size.totalSize()])
+		capacity(_size.totalSize()),
+		data(_data)
+	{
+		easyAssert(data.get() != nullptr, "data of view can't be null.");
+	}
+	DataBucket::DataBucket(const DataSize _size, float* _userData)
+		:DataBucket(_size, std::shared_ptr<float>(_userData, [](float*){}))
 	{
 
 	}
@@ -15,20 +36,71 @@ namespace EasyCNN
 	}
 	void DataBucket::fillData(const float item)
 	{
-		std::fill(data.get(), data.get() + getSize().totalSize(), item);
+		float* const items = data.get();
+		const size_t count = getSize().totalSize();
+		parallel_for(0, count, get_parallel_grain({ count }, LayerCost(0.0, sizeof(float)*count)), [items, item](const size_t start, const size_t stop){
+			std::fill(items + start, items + stop, item);
+		});
 	}
 	void DataBucket::cloneTo(DataBucket& target)
 	{
-		target.size = this->size;
+		target.reshape(this->size);
+		target.layout = this->layout;
 		const size_t dataSize = sizeof(float)*this->size.totalSize();
 		memcpy(target.data.get(), this->data.get(), dataSize);
 	}
+	void DataBucket::reshape(const DataSize _size)
+	{
+		if (_size.totalSize() > capacity)
+		{
+			easyAssert(pool.get() != nullptr, "storage of view can't grow.");
+			//release old block first, so it can be reused by this request
+			data.reset();
+			data = make_pooled_buffer(pool, _size.totalSize());
+			capacity = MemoryPool::getSizeClass(sizeof(float)*_size.totalSize()) / sizeof(float);
+			first_touch(data.get(), capacity);
+		}
+		size = _size;
+	}
+	void DataBucket::reserve(const size_t _capacity)
+	{
+		if (_capacity <= capacity)
+		{
+			return;
+		}
+		easyAssert(pool.get() != nullptr, "storage of view can't grow.");
+		std::shared_ptr<float> newData = make_pooled_buffer(pool, _capacity);
+		first_touch(newData.get(), MemoryPool::getSizeClass(sizeof(float)*_capacity) / sizeof(float));
+		memcpy(newData.get(), data.get(), sizeof(float)*size.totalSize());
+		data = newData;
+		capacity = MemoryPool::getSizeClass(sizeof(float)*_capacity) / sizeof(float);
+	}
+	size_t DataBucket::getCapacity() const
+	{
+		return capacity;
+	}
+	std::shared_ptr<MemoryPool> DataBucket::getMemoryPool() const
+	{
+		return pool;
+	}
 	std::shared_ptr<float> DataBucket::getData() const
 	{
 		return data;
 	}
+	TensorView DataBucket::getView() const
+	{
+		return TensorView(data.get(), size, layout);
+	}
 	DataSize DataBucket::getSize() const
 	{
 		return size;
 	}
+	Layout DataBucket::getLayout() const
+	{
+		return layout;
+	}
+	void DataBucket::setLayout(const Layout _layout)
+	{
+		layout = _layout;
+	}
 }//namespace
\ No newline at end of file
@@ -46,19 +46,24 @@ namespace EasyCNN
 	}
 	void DropoutLayer::solveInnerParams()
 	{
-		if (!mask.get())
+		if (getPhase() == Phase::Train && !mask.get())
 		{
 			ParamSize maskSize = getInputBucketSize();
 			maskSize.number = 1;
-			mask.reset(new ParamBucket(maskSize));
+			mask.reset(new ParamBucket(maskSize, getMemoryPool()));
 			const_distribution_init(mask->getData().get(), maskSize.totalSize(), 1.0f);
 		}
 		setOutpuBuckerSize(getInputBucketSize());
 	}
-	void DropoutLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void DropoutLayer::releaseTrainingState()
 	{
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
+		Layer::releaseTrainingState();
+		mask.reset();
+	}
+	void DropoutLayer::forward(const TensorView& prev, const TensorView& next)
+	{
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
 		easyAssert(prevSize == nextSize, "size must be equal!");
 
 		//init rand seed
@@ -75,51 +80,47 @@ namespace EasyCNN
 				maskData[i] = (float)(random_distribution(engine));
 			}
 
-			const float* prevData = prev->getData().get();
-			float* nextData = next->getData().get();
 			for (size_t i = 0; i < nextSize.number; i++)
 			{
+				const float* prevData = prev.getSampleData(i);
+				float* nextData = next.getSampleData(i);
 				for (size_t j = 0; j < nextSize._3DSize(); j++)
 				{
-					const int dataIdx = i*nextSize._3DSize() + j;
-					nextData[dataIdx] = prevData[dataIdx] * maskData[j] / rate;
+					nextData[j] = prevData[j] * maskData[j] / rate;
 				}
 			}
 		}
 		else
 		{
-			const float* prevData = prev->getData().get();
-			float* nextData = next->getData().get();
-			for (size_t i = 0; i < nextSize.totalSize(); i++)
+			//nothing to do when inplace
+			if (prev.getData() != next.getData())
 			{
-				nextData[i] = prevData[i];
+				copy(prev, next);
 			}
 		}
 	}
-	void DropoutLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void DropoutLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = nextDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = nextDiff.getSize();
+		const DataSize nextDiffSize = nextDiff.getSize();
 		easyAssert(prevSize == nextSize, "size must be equal!");
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 
 		//////////////////////////////////////////////////////////////////////////
-		//update prevDiff
-		prevDiff->fillData(0.0f);
+		//update prevDiff, every element is overwritten(prevDiff may be nextDiff when inplace)
 		const float* maskData = mask->getData().get();
-		const float* nextDiffData = nextDiff->getData().get();
-		float* prevDiffData = prevDiff->getData().get();
 		//calculate current inner diff && multiply next diff
 		for (size_t i = 0; i < nextSize.number; i++)
 		{
+			const float* nextDiffData = nextDiff.getSampleData(i);
+			float* prevDiffData = prevDiff.getSampleData(i);
 			for (size_t j = 0; j < nextSize._3DSize(); j++)
 			{
-				const int dataIdx = i*nextSize._3DSize() + j;
-				prevDiffData[dataIdx] = nextDiffData[dataIdx] * maskData[j] / rate;
+				prevDiffData[j] = nextDiffData[j] * maskData[j] / rate;
 			}
 		}
 	}
@@ -1,7 +1,7 @@
+#include <algorithm>
 #include "EasyCNN/FullconnectLayer.h"
 #include "EasyCNN/CommonTools.h"
 #include "EasyCNN/MathFunctions.h"
-#include "EasyCNN/ThreadPool.h"
 
 namespace EasyCNN
 {
@@ -100,7 +100,7 @@ namespace EasyCNN
 		easyAssert(outputSize.number > 0 && outputSize.channels > 0 && outputSize.width == 1 && outputSize.height == 1, "output size is invalidate.");
 		if (weight.get() == nullptr)
 		{
-			weight.reset(new ParamBucket(ParamSize(1, inputSize._3DSize()*outputSize._3DSize(), 1, 1)));
+			weight.reset(new ParamBucket(ParamSize(1, inputSize._3DSize()*outputSize._3DSize(), 1, 1), getMemoryPool()));
 			normal_distribution_init(weight->getData().get(), weight->getSize().totalSize(), 0.0f, 0.1f);
 			/*
 			const size_t fan_in = inputSize._3DSize();
@@ -108,21 +108,21 @@ namespace EasyCNN
 			xavier_init(weight->getData().get(), weight->getSize().totalSize(), fan_in, fan_out);
 			*/
 		}
-		if (weightGradient.get() == nullptr)
+		if (getPhase() == Phase::Train && weightGradient.get() == nullptr)
 		{
-			weightGradient.reset(new ParamBucket(weight->getSize()));
+			weightGradient.reset(new ParamBucket(weight->getSize(), getMemoryPool()));
 			const_distribution_init(weightGradient->getData().get(), weightGradient->getSize().totalSize(), 0.0f);
 		}
 		if (enabledBias)
 		{
 			if (bias.get() == nullptr)
 			{
-				bias.reset(new ParamBucket(ParamSize(1, outputSize.channels, 1, 1)));
+				bias.reset(new ParamBucket(ParamSize(1, outputSize.channels, 1, 1), getMemoryPool()));
 				const_distribution_init(bias->getData().get(), bias->getSize().totalSize(), 0.0f);
 			}
-			if (biasGradient.get() == nullptr)
+			if (getPhase() == Phase::Train && biasGradient.get() == nullptr)
 			{
-				biasGradient.reset(new ParamBucket(bias->getSize()));
+				biasGradient.reset(new ParamBucket(bias->getSize(), getMemoryPool()));
 				const_distribution_init(biasGradient->getData().get(), biasGradient->getSize().totalSize(), 0.0f);
 			}
 		}
@@ -134,101 +134,108 @@ namespace EasyCNN
 		gradients.clear();
 		gradients.push_back(weightGradient);
 		gradients.push_back(biasGradient);
+		//packing of sgemm in forward, prevDiff and weight gradient. batch is not known here, take a large one
+		const size_t anyBatch = 1024;
+		const size_t is = inputSize._3DSize();
+		const size_t os = outputSize._3DSize();
+		setWorkspaceSize(std::max(std::max(sgemm_workspace_size(anyBatch, os, is), sgemm_workspace_size(anyBatch, is, os)),
+			sgemm_workspace_size(os, is, anyBatch)));
 	}
-	void FullconnectLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void FullconnectLayer::releaseTrainingState()
 	{
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-
-		const float* prevData = prev->getData().get();
-		float* nextData = next->getData().get();		
-		const float* weightData = weight->getData().get();
-		const float* biasData = enabledBias ? bias->getData().get() : nullptr;
-		auto worker = [&](const size_t start, const size_t stop){
-			fullconnect(prevData + start * prevSize._3DSize(), weightData, biasData, nextData + start * nextSize._3DSize(), stop-start, prevSize._3DSize(), nextSize._3DSize());
-		};
-		dispatch_worker(worker,prevSize.number);
+		Layer::releaseTrainingState();
+		weightGradient.reset();
+		biasGradient.reset();
+	}
+	//backward regions(prevDiff, weight gradient) do the same multiply-adds each
+	LayerCost FullconnectLayer::getForwardCost(const size_t number) const
+	{
+		const double weights = (double)inputSize._3DSize()*outputSize._3DSize();
+		const double elements = (double)number*(inputSize._3DSize() + outputSize._3DSize()) + weights;
+		return LayerCost(2.0*number*weights, sizeof(float)*elements);
+	}
+	void FullconnectLayer::forward(const TensorView& prev, const TensorView& next)
+	{
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const size_t inputLength = prevSize._3DSize();
+		const size_t outputLength = nextSize._3DSize();
+		easyAssert(prev.isSampleDense() && next.isSampleDense(), "every sample must be dense.");
+		//next(n,os) = prev(n,is) * weight(os,is)^T, tiles over threads
+		parallel_sgemm(false, true, nextSize.number, outputLength, inputLength, 1.0f, prev.getData(), prev.numberStride,
+			weight->getData().get(), inputLength, 0.0f, next.getData(), next.numberStride);
+		if (enabledBias)
+		{
+			const float* biasData = bias->getData().get();
+			for (size_t nn = 0; nn < nextSize.number; nn++)
+			{
+				float* nextData = next.getSampleData(nn);
+				for (size_t nc = 0; nc < outputLength; nc++)
+				{
+					nextData[nc] += biasData[nc];
+				}
+			}
+		}
 	}
 
-	void FullconnectLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void FullconnectLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
+	{
+		backwardDiff(prev, next, prevDiff, nextDiff);
+		backwardGradient(prev, next, nextDiff);
+	}
+	void FullconnectLayer::backwardDiff(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
+		const DataSize nextDiffSize = nextDiff.getSize();
 		const ParamSize weightSize = weight->getSize();
-		const ParamSize biasSize = enabledBias ? bias->getSize() : ParamSize();
-		const float* prevData = prev->getData().get();
-		const float* nextData = next->getData().get();
-		float* prevDiffData = prevDiff->getData().get();
-		const float* nextDiffData = nextDiff->getData().get();
 		const float* weightData = weight->getData().get();
-		const float* biasData = enabledBias ? bias->getData().get() : nullptr;
 		easyAssert(nextSize.width == 1 && nextSize.height == 1, "use channel only!");
 		easyAssert(weightSize.totalSize() == prevSize._3DSize() * nextSize._3DSize(), "weight size is invalidate!");
+		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
+
+		//////////////////////////////////////////////////////////////////////////
+		//update prevDiff, every element is overwritten : prevDiff(n,is) = nextDiff(n,os) * weight(os,is)
+		easyAssert(prevDiff.isSampleDense() && nextDiff.isSampleDense(), "every sample must be dense.");
+		parallel_sgemm(false, false, prevSize.number, prevDiffSize._3DSize(), nextDiffSize.channels, 1.0f,
+			nextDiff.getData(), nextDiff.numberStride, weightData, prevSize._3DSize(), 0.0f, prevDiff.getData(), prevDiff.numberStride);
+	}
+	void FullconnectLayer::backwardGradient(const TensorView& prev, const TensorView& next, const TensorView& nextDiff)
+	{
+		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const ParamSize biasSize = enabledBias ? bias->getSize() : ParamSize();
 		if (enabledBias)
 		{
 			easyAssert(biasSize.totalSize() == nextSize._3DSize(), "bias size is invalidate!");
 		}
-		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
-
-		//////////////////////////////////////////////////////////////////////////
-		//update prevDiff
-		prevDiff->fillData(0.0f);		
-		//calculate current inner diff && multiply next diff
-		auto worker = [&](const size_t start, const size_t stop){
-			for (size_t pn = start; pn < stop; pn++)
-			{
-				for (size_t pidx = 0; pidx < prevDiffSize._3DSize(); pidx++)
-				{
-					const size_t prevDiffIdx = pn * prevDiffSize._3DSize() + pidx;
-					for (size_t nc = 0; nc < nextDiffSize.channels; nc++)
-					{
-						const size_t weightIdx = nc*prevSize._3DSize() + pidx;
-						const size_t nextDiffIdx = pn*nextDiffSize._3DSize() + nc;
-						prevDiffData[prevDiffIdx] += weightData[weightIdx] * nextDiffData[nextDiffIdx];
-					}
-				}
-			}
-		};
-		dispatch_worker(worker, prevSize.number);
 
 		//////////////////////////////////////////////////////////////////////////
 		//update this layer's param
-		//get weight gradient
-		weightGradient->fillData(0.0f);
-		float* weightGradientData = weightGradient->getData().get();
-		for (size_t pn = 0; pn < nextSize.number; pn++)
-		{
-			for (size_t nc = 0; nc < nextSize.channels; nc++)
-			{
-				const size_t nextDiffIdx = pn*nextDiffSize._3DSize() + nc;
-				for (size_t prevData3DIdx = 0; prevData3DIdx < prevSize._3DSize(); prevData3DIdx++)
-				{
-					const size_t weightGradientIdx = nc*prevDiffSize._3DSize() + prevData3DIdx;
-					const size_t prevDataIdx = pn*prevSize._3DSize() + prevData3DIdx;
-					weightGradientData[weightGradientIdx] += prevData[prevDataIdx] * nextDiffData[nextDiffIdx];
-				}
-			}
-		}
-		//div by batch size
-		div_inplace(weightGradientData, (float)nextSize.number, weightSize.totalSize());
+		//weight gradient, every element is overwritten : weightGradient(os,is) = nextDiff(n,os)^T * prev(n,is) / n
+		easyAssert(prev.isSampleDense() && nextDiff.isSampleDense(), "every sample must be dense.");
+		parallel_sgemm(true, false, nextSize._3DSize(), prevSize._3DSize(), nextSize.number, 1.0f / nextSize.number,
+			nextDiff.getData(), nextDiff.numberStride, prev.getData(), prev.numberStride, 0.0f, weightGradient->getData().get(), prevSize._3DSize());
 
 		//////////////////////////////////////////////////////////////////////////
 		//update bias
 		if (enabledBias)
 		{
-			//get bias diff		
-			biasGradient->fillData(0.0f);
+			//get bias diff, every element is overwritten
 			float* biasGradientData = biasGradient->getData().get();
-			for (size_t nn = 0; nn < nextSize.number; nn++)
+			for (size_t biasDiffIdx = 0; biasDiffIdx < biasSize._3DSize(); biasDiffIdx++)
 			{
-				for (size_t biasDiffIdx = 0; biasDiffIdx < biasSize._3DSize(); biasDiffIdx++)
+				float sum = 0.0f;
+				for (size_t nn = 0; nn < nextSize.number; nn++)
 				{
-					biasGradientData[biasDiffIdx] += 1.0f*nextDiffData[nn*biasSize._3DSize() + biasDiffIdx];
+					sum += 1.0f*nextDiff.getSampleData(nn)[biasDiffIdx];
 				}
+				biasGradientData[biasDiffIdx] = sum;
 			}
 			//div by batch size
 			div_inplace(biasGradientData, (float)nextSize.number, biasSize.totalSize());
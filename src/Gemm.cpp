@@ -0,0 +1,489 @@
+#include <algorithm>
+#include <atomic>
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/Workspace.h"
+#include "EasyCNN/CostModel.h"
+#include "EasyCNN/ThreadPool.h"
+#include "EasyCNN/EasyAssert.h"
+#include "EasyCNN/Simd.h"
+
+#if defined(EASYCNN_SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace EasyCNN
+{
+	//register block of microkernel : 6x16 of c is 12 ymm accumulators.
+	//cache blocks : kc x nr panel of b stays in l1, mc x kc block of a in l2, kc x nc block of b in l3.
+	static const size_t GEMM_MR = 6;
+	static const size_t GEMM_NR = 16;
+	static const size_t GEMM_MC = 144;
+	static const size_t GEMM_KC = 256;
+	static const size_t GEMM_NC = 2048;
+
+	//c(MR,NR) = a(MR,kc)*b(kc,NR) + beta*c, a and b are packed panels. beta 0 : c is not read
+	typedef void(*GemmKernel)(const size_t kc, const float* a, const float* b, float* c, const size_t ldc, const float beta);
+	//sum of x[i]*y[i]
+	typedef float(*DotKernel)(const float* x, const float* y, const size_t len);
+	//y += alpha*x
+	typedef void(*AxpyKernel)(const float alpha, const float* x, float* y, const size_t len);
+	struct GemmKernels
+	{
+		GemmKernel micro;
+		DotKernel dot;
+		AxpyKernel axpy;
+		const char* name;
+	};
+
+	static inline size_t round_up(const size_t value, const size_t step)
+	{
+		return (value + step - 1) / step * step;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//scalar kernels, compiler may vectorize them for its baseline
+	static void gemm_kernel_scalar(const size_t kc, const float* a, const float* b, float* c, const size_t ldc, const float beta)
+	{
+		float acc[GEMM_MR][GEMM_NR] = {};
+		for (size_t p = 0; p < kc; p++)
+		{
+			for (size_t r = 0; r < GEMM_MR; r++)
+			{
+				const float av = a[r];
+				for (size_t col = 0; col < GEMM_NR; col++)
+				{
+					acc[r][col] += av*b[col];
+				}
+			}
+			a += GEMM_MR;
+			b += GEMM_NR;
+		}
+		for (size_t r = 0; r < GEMM_MR; r++)
+		{
+			float* row = c + r*ldc;
+			for (size_t col = 0; col < GEMM_NR; col++)
+			{
+				row[col] = (beta == 0.0f) ? acc[r][col] : beta*row[col] + acc[r][col];
+			}
+		}
+	}
+	static float dot_scalar(const float* x, const float* y, const size_t len)
+	{
+		float sum = 0.0f;
+		for (size_t i = 0; i < len; i++)
+		{
+			sum += x[i] * y[i];
+		}
+		return sum;
+	}
+	static void axpy_scalar(const float alpha, const float* x, float* y, const size_t len)
+	{
+		for (size_t i = 0; i < len; i++)
+		{
+			y[i] += alpha*x[i];
+		}
+	}
+
+#ifdef EASYCNN_SIMD_X86
+	//////////////////////////////////////////////////////////////////////////
+	//avx2/fma kernels
+#define EASYCNN_GEMM_ROW(r) \
+	{ \
+		const __m256 av = _mm256_broadcast_ss(a + r); \
+		c##r##0 = _mm256_fmadd_ps(av, b0, c##r##0); \
+		c##r##1 = _mm256_fmadd_ps(av, b1, c##r##1); \
+	}
+#define EASYCNN_GEMM_STORE(r) \
+	if (beta == 0.0f) \
+	{ \
+		_mm256_storeu_ps(c + r*ldc, c##r##0); \
+		_mm256_storeu_ps(c + r*ldc + 8, c##r##1); \
+	} \
+	else \
+	{ \
+		_mm256_storeu_ps(c + r*ldc, _mm256_fmadd_ps(betav, _mm256_loadu_ps(c + r*ldc), c##r##0)); \
+		_mm256_storeu_ps(c + r*ldc + 8, _mm256_fmadd_ps(betav, _mm256_loadu_ps(c + r*ldc + 8), c##r##1)); \
+	}
+	EASYCNN_TARGET_AVX2
+	static void gemm_kernel_avx2(const size_t kc, const float* a, const float* b, float* c, const size_t ldc, const float beta)
+	{
+		__m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+		__m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+		__m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+		__m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+		__m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+		__m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+		for (size_t p = 0; p < kc; p++)
+		{
+			//rows of packed b are 64 bytes, aligned
+			const __m256 b0 = _mm256_load_ps(b);
+			const __m256 b1 = _mm256_load_ps(b + 8);
+			EASYCNN_GEMM_ROW(0);
+			EASYCNN_GEMM_ROW(1);
+			EASYCNN_GEMM_ROW(2);
+			EASYCNN_GEMM_ROW(3);
+			EASYCNN_GEMM_ROW(4);
+			EASYCNN_GEMM_ROW(5);
+			a += GEMM_MR;
+			b += GEMM_NR;
+		}
+		const __m256 betav = _mm256_set1_ps(beta);
+		EASYCNN_GEMM_STORE(0);
+		EASYCNN_GEMM_STORE(1);
+		EASYCNN_GEMM_STORE(2);
+		EASYCNN_GEMM_STORE(3);
+		EASYCNN_GEMM_STORE(4);
+		EASYCNN_GEMM_STORE(5);
+	}
+#undef EASYCNN_GEMM_ROW
+#undef EASYCNN_GEMM_STORE
+	EASYCNN_TARGET_AVX2
+	static float dot_avx2(const float* x, const float* y, const size_t len)
+	{
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		size_t i = 0;
+		for (; i + 16 <= len; i += 16)
+		{
+			sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i), sum0);
+			sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(x + i + 8), _mm256_loadu_ps(y + i + 8), sum1);
+		}
+		const __m256 sum = _mm256_add_ps(sum0, sum1);
+		__m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+		half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+		half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+		float result = _mm_cvtss_f32(half);
+		for (; i < len; i++)
+		{
+			result += x[i] * y[i];
+		}
+		return result;
+	}
+	EASYCNN_TARGET_AVX2
+	static void axpy_avx2(const float alpha, const float* x, float* y, const size_t len)
+	{
+		const __m256 alphav = _mm256_set1_ps(alpha);
+		size_t i = 0;
+		for (; i + 8 <= len; i += 8)
+		{
+			_mm256_storeu_ps(y + i, _mm256_fmadd_ps(alphav, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		}
+		//tail fused too : element's result doesn't depend on where a range starts
+		for (; i < len; i++)
+		{
+			y[i] = _mm_cvtss_f32(_mm_fmadd_ss(_mm_set_ss(alpha), _mm_set_ss(x[i]), _mm_set_ss(y[i])));
+		}
+	}
+	static bool cpu_supports_avx2_fma()
+	{
+#ifdef _MSC_VER
+		int info[4] = { 0 };
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+		__cpuid(info, 1);
+		const bool fma = (info[2] & (1 << 12)) != 0;
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		//os saves ymm registers
+		if (!fma || !osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+	}
+#endif
+
+	static const GemmKernels scalarKernels = { &gemm_kernel_scalar, &dot_scalar, &axpy_scalar, "scalar" };
+#ifdef EASYCNN_SIMD_X86
+	static const GemmKernels avx2Kernels = { &gemm_kernel_avx2, &dot_avx2, &axpy_avx2, "avx2/fma" };
+	static std::atomic<bool> simdEnabled(cpu_supports_avx2_fma());
+#else
+	static std::atomic<bool> simdEnabled(false);
+#endif
+	static const GemmKernels& gemm_kernels()
+	{
+#ifdef EASYCNN_SIMD_X86
+		if (simdEnabled.load(std::memory_order_relaxed))
+		{
+			return avx2Kernels;
+		}
+#endif
+		return scalarKernels;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//packing
+	//mc x kc block of alpha*op(a) into panels of MR rows : kc columns of MR values, missing rows are 0.
+	//a points to element(0,0) of block.
+	static void pack_a(const bool transA, const float* a, const size_t lda, const size_t mc, const size_t kc,
+		const float alpha, float* packed)
+	{
+		for (size_t i0 = 0; i0 < mc; i0 += GEMM_MR)
+		{
+			const size_t mr = std::min(GEMM_MR, mc - i0);
+			if (transA)
+			{
+				//columns of op(a) are contiguous
+				for (size_t p = 0; p < kc; p++)
+				{
+					const float* column = a + p*lda + i0;
+					float* dst = packed + p*GEMM_MR;
+					for (size_t r = 0; r < mr; r++)
+					{
+						dst[r] = alpha*column[r];
+					}
+					for (size_t r = mr; r < GEMM_MR; r++)
+					{
+						dst[r] = 0.0f;
+					}
+				}
+			}
+			else
+			{
+				//rows of a are contiguous : read them along, write panel with stride MR
+				for (size_t r = 0; r < GEMM_MR; r++)
+				{
+					if (r < mr)
+					{
+						const float* row = a + (i0 + r)*lda;
+						for (size_t p = 0; p < kc; p++)
+						{
+							packed[p*GEMM_MR + r] = alpha*row[p];
+						}
+					}
+					else
+					{
+						for (size_t p = 0; p < kc; p++)
+						{
+							packed[p*GEMM_MR + r] = 0.0f;
+						}
+					}
+				}
+			}
+			packed += kc*GEMM_MR;
+		}
+	}
+	//kc x nc block of op(b) into panels of NR columns : kc rows of NR values, missing columns are 0
+	static void pack_b(const bool transB, const float* b, const size_t ldb, const size_t kc, const size_t nc, float* packed)
+	{
+		for (size_t j0 = 0; j0 < nc; j0 += GEMM_NR)
+		{
+			const size_t nr = std::min(GEMM_NR, nc - j0);
+			if (transB)
+			{
+				//rows of b are contiguous : read them along, write panel with stride NR
+				for (size_t col = 0; col < GEMM_NR; col++)
+				{
+					if (col < nr)
+					{
+						const float* row = b + (j0 + col)*ldb;
+						for (size_t p = 0; p < kc; p++)
+						{
+							packed[p*GEMM_NR + col] = row[p];
+						}
+					}
+					else
+					{
+						for (size_t p = 0; p < kc; p++)
+						{
+							packed[p*GEMM_NR + col] = 0.0f;
+						}
+					}
+				}
+			}
+			else
+			{
+				for (size_t p = 0; p < kc; p++)
+				{
+					const float* row = b + p*ldb + j0;
+					float* dst = packed + p*GEMM_NR;
+					for (size_t col = 0; col < nr; col++)
+					{
+						dst[col] = row[col];
+					}
+					for (size_t col = nr; col < GEMM_NR; col++)
+					{
+						dst[col] = 0.0f;
+					}
+				}
+			}
+			packed += kc*GEMM_NR;
+		}
+	}
+
+	//few rows of op(a)(e.g. batch 1) : packing b would cost as much as multiplying, and
+	//padding rows to MR would multiply zeros. dot products or axpy straight on a and b.
+	static void gemm_few_rows(const GemmKernels& kernels, const bool transB, const size_t m, const size_t n, const size_t k,
+		const float alpha, const float* a, const size_t lda, const float* b, const size_t ldb,
+		const float beta, float* c, const size_t ldc)
+	{
+		for (size_t i = 0; i < m; i++)
+		{
+			const float* rowA = a + i*lda;
+			float* rowC = c + i*ldc;
+			if (transB)
+			{
+				for (size_t j = 0; j < n; j++)
+				{
+					const float value = alpha*kernels.dot(rowA, b + j*ldb, k);
+					rowC[j] = (beta == 0.0f) ? value : beta*rowC[j] + value;
+				}
+			}
+			else
+			{
+				for (size_t j = 0; j < n; j++)
+				{
+					rowC[j] = (beta == 0.0f) ? 0.0f : beta*rowC[j];
+				}
+				for (size_t p = 0; p < k; p++)
+				{
+					kernels.axpy(alpha*rowA[p], b + p*ldb, rowC, n);
+				}
+			}
+		}
+	}
+
+	size_t sgemm_workspace_size(const size_t m, const size_t n, const size_t k)
+	{
+		const size_t mc = round_up(std::min(m, GEMM_MC), GEMM_MR);
+		const size_t nc = round_up(std::min(n, GEMM_NC), GEMM_NR);
+		const size_t kc = std::min(k, GEMM_KC);
+		//packed b starts on a cache line
+		return (round_up(mc*kc, GEMM_NR) + kc*nc)*sizeof(float);
+	}
+	bool set_sgemm_simd(const bool enabled)
+	{
+#ifdef EASYCNN_SIMD_X86
+		simdEnabled = enabled && cpu_supports_avx2_fma();
+#endif
+		return simdEnabled.load();
+	}
+	bool simd_avx2_enabled()
+	{
+		return simdEnabled.load(std::memory_order_relaxed);
+	}
+	const char* get_sgemm_kernel()
+	{
+		return gemm_kernels().name;
+	}
+	//fewRows is chosen from whole c : tiles of parallel_sgemm take the same path as serial sgemm,
+	//so every element is summed in the same order whatever the threads
+	static void sgemm_tile(const bool fewRows, const bool transA, const bool transB, const size_t m, const size_t n, const size_t k,
+		const float alpha, const float* a, const size_t lda, const float* b, const size_t ldb,
+		const float beta, float* c, const size_t ldc)
+	{
+		if (m == 0 || n == 0)
+		{
+			return;
+		}
+		if (k == 0 || alpha == 0.0f)
+		{
+			for (size_t i = 0; i < m; i++)
+			{
+				float* rowC = c + i*ldc;
+				for (size_t j = 0; j < n; j++)
+				{
+					rowC[j] = (beta == 0.0f) ? 0.0f : beta*rowC[j];
+				}
+			}
+			return;
+		}
+		const GemmKernels& kernels = gemm_kernels();
+		if (fewRows)
+		{
+			gemm_few_rows(kernels, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+			return;
+		}
+		float* const packedA = get_workspace(sgemm_workspace_size(m, n, k));
+		float* const packedB = packedA + round_up(round_up(std::min(m, GEMM_MC), GEMM_MR)*std::min(k, GEMM_KC), GEMM_NR);
+		float tile[GEMM_MR*GEMM_NR];
+		for (size_t jc = 0; jc < n; jc += GEMM_NC)
+		{
+			const size_t nc = std::min(GEMM_NC, n - jc);
+			for (size_t pc = 0; pc < k; pc += GEMM_KC)
+			{
+				const size_t kc = std::min(GEMM_KC, k - pc);
+				//first block of k applies beta, others accumulate
+				const float blockBeta = (pc == 0) ? beta : 1.0f;
+				pack_b(transB, transB ? b + jc*ldb + pc : b + pc*ldb + jc, ldb, kc, nc, packedB);
+				for (size_t ic = 0; ic < m; ic += GEMM_MC)
+				{
+					const size_t mc = std::min(GEMM_MC, m - ic);
+					pack_a(transA, transA ? a + pc*lda + ic : a + ic*lda + pc, lda, mc, kc, alpha, packedA);
+					for (size_t jr = 0; jr < nc; jr += GEMM_NR)
+					{
+						const size_t nr = std::min(GEMM_NR, nc - jr);
+						for (size_t ir = 0; ir < mc; ir += GEMM_MR)
+						{
+							const size_t mr = std::min(GEMM_MR, mc - ir);
+							float* const blockC = c + (ic + ir)*ldc + jc + jr;
+							if (mr == GEMM_MR && nr == GEMM_NR)
+							{
+								kernels.micro(kc, packedA + ir*kc, packedB + jr*kc, blockC, ldc, blockBeta);
+								continue;
+							}
+							//edge of c : full tile aside, then its valid part
+							kernels.micro(kc, packedA + ir*kc, packedB + jr*kc, tile, GEMM_NR, 0.0f);
+							for (size_t r = 0; r < mr; r++)
+							{
+								float* rowC = blockC + r*ldc;
+								const float* rowTile = tile + r*GEMM_NR;
+								for (size_t col = 0; col < nr; col++)
+								{
+									rowC[col] = (blockBeta == 0.0f) ? rowTile[col] : blockBeta*rowC[col] + rowTile[col];
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+	void sgemm(const bool transA, const bool transB, const size_t m, const size_t n, const size_t k,
+		const float alpha, const float* a, const size_t lda, const float* b, const size_t ldb,
+		const float beta, float* c, const size_t ldc)
+	{
+		sgemm_tile(m < GEMM_MR && !transA, transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+	}
+	void parallel_sgemm(const bool transA, const bool transB, const size_t m, const size_t n, const size_t k,
+		const float alpha, const float* a, const size_t lda, const float* b, const size_t ldb,
+		const float beta, float* c, const size_t ldc)
+	{
+		const LayerCost cost(2.0*m*n*k, sizeof(float)*((double)m*k + (double)k*n + (double)m*n));
+		const size_t threads = get_parallel_threads_for(cost);
+		if (threads <= 1)
+		{
+			sgemm(transA, transB, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+			return;
+		}
+		//columns first : every tile packs only its own columns of b(e.g. rows of weight),
+		//rows of c are split too when there are fewer column panels than threads
+		const size_t colPanels = (n + GEMM_NR - 1) / GEMM_NR;
+		const size_t colParts = std::min(colPanels, threads);
+		const size_t rowPanels = (m + GEMM_MR - 1) / GEMM_MR;
+		const size_t rowParts = std::min(rowPanels, (threads + colParts - 1) / colParts);
+		const bool fewRows = m < GEMM_MR && !transA;
+		const size_t colStep = (colPanels + colParts - 1) / colParts * GEMM_NR;
+		const size_t rowStep = (rowPanels + rowParts - 1) / rowParts * GEMM_MR;
+		parallel_for_2d(rowParts, colParts, 1, [&](const size_t rowPart, const size_t colStart, const size_t colStop){
+			const size_t i0 = rowPart*rowStep;
+			const size_t i1 = std::min(m, i0 + rowStep);
+			const size_t j0 = colStart*colStep;
+			const size_t j1 = std::min(n, colStop*colStep);
+			if (i0 >= i1 || j0 >= j1)
+			{
+				return;
+			}
+			sgemm_tile(fewRows, transA, transB, i1 - i0, j1 - j0, k, alpha, transA ? a + i0 : a + i0*lda, lda,
+				transB ? b + j0*ldb : b + j0, ldb, beta, c + i0*ldc + j0, ldc);
+		});
+	}
+}//namespace
@@ -1,4 +1,5 @@
 #include "EasyCNN/InputLayer.h"
+#include "EasyCNN/MathFunctions.h"
 
 namespace EasyCNN
 {
@@ -45,12 +46,16 @@ namespace EasyCNN
 	{
 		return layerType;
 	}
-	void InputLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void InputLayer::forward(const TensorView& prev, const TensorView& next)
 	{
-		prev->cloneTo(*next);
+		//nop when inplace
+		if (prev.getData() != next.getData())
+		{
+			copy(prev, next);
+		}
 	}
-	void InputLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void InputLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		//data layer : nop
 	}
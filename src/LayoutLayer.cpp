@@ -0,0 +1,50 @@
+#include "EasyCNN/LayoutLayer.h"
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/ThreadPool.h"
+
+namespace EasyCNN
+{
+	LayoutLayer::LayoutLayer(const Direction _direction)
+		:direction(_direction)
+	{
+		//sizes are of NCHW tensor both, next is blocked when converting to it
+		blockedLayout = (direction == ToBlocked);
+	}
+	LayoutLayer::~LayoutLayer()
+	{
+
+	}
+	LayoutLayer::Direction LayoutLayer::getDirection() const
+	{
+		return direction;
+	}
+	DEFINE_LAYER_TYPE(LayoutLayer, "LayoutLayer");
+	std::string LayoutLayer::getLayerType() const
+	{
+		return layerType;
+	}
+	void LayoutLayer::forward(const TensorView& prev, const TensorView& next)
+	{
+		const size_t number = prev.getSize().number;
+		//split over samples
+		parallel_for(0, number, get_parallel_grain({ number }, getForwardCost(number)), [&](const size_t start, const size_t stop){
+			switch (direction)
+			{
+			case ToBlocked:
+				to_blocked(prev.slice(start, stop - start), next.slice(start, stop - start));
+				break;
+			case FromBlocked:
+				from_blocked(prev.slice(start, stop - start), next.slice(start, stop - start));
+				break;
+			case FromNHWC:
+				nhwc_to_nchw(prev.slice(start, stop - start), next.slice(start, stop - start));
+				break;
+			}
+		});
+	}
+	void LayoutLayer::backward(const TensorView& /*prev*/, const TensorView& /*next*/,
+		const TensorView& /*prevDiff*/, const TensorView& /*nextDiff*/)
+	{
+		easyAssert(false, "layout is converted in test phase only.");
+	}
+}//namespace
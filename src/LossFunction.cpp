@@ -26,7 +26,6 @@ namespace EasyCNN
 		const DataSize labelSize = labelDataBucket->getSize();
 		const DataSize outputSize = outputDataBucket->getSize();
 		const DataSize diffSize = diff->getSize();
-		diff->fillData(0.0f);
 		for (size_t on = 0; on < outputSize.number; on++)
 		{
 			const float* labelData = labelDataBucket->getData().get() + on*labelSize._3DSize();
@@ -35,7 +34,7 @@ namespace EasyCNN
 			for (size_t nextDiffIdx = 0; nextDiffIdx < diffSize._3DSize(); nextDiffIdx++)
 			{
 				const size_t dataIdx = nextDiffIdx;
-				diffData[nextDiffIdx] -= ((labelData[dataIdx] / (outputData[dataIdx])));
+				diffData[nextDiffIdx] = -((labelData[dataIdx] / (outputData[dataIdx])));
 			}
 		}
 	}
@@ -63,7 +62,6 @@ namespace EasyCNN
 		const DataSize labelSize = labelDataBucket->getSize();
 		const DataSize outputSize = outputDataBucket->getSize();
 		const DataSize diffSize = diff->getSize();
-		diff->fillData(0.0f);
 		for (size_t on = 0; on < outputSize.number; on++)
 		{
 			const float* labelData = labelDataBucket->getData().get() + on*labelSize._3DSize();
@@ -72,7 +70,7 @@ namespace EasyCNN
 			for (size_t nextDiffIdx = 0; nextDiffIdx < diffSize._3DSize(); nextDiffIdx++)
 			{
 				const size_t dataIdx = nextDiffIdx;
-				diffData[nextDiffIdx] += 2.0f*(outputData[dataIdx] - labelData[dataIdx]);
+				diffData[nextDiffIdx] = 2.0f*(outputData[dataIdx] - labelData[dataIdx]);
 			}
 		}
 	}
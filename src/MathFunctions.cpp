@@ -1,7 +1,9 @@
 #include <cmath>
+#include <cstring>
 #include <random>
 #include "MathFunctions.h"
 #include "DataBucket.h"
+#include "EasyAssert.h"
 
 namespace EasyCNN
 {
@@ -155,60 +157,132 @@ namespace EasyCNN
 		}
 	}
 
-	//
-	void fullconnect(const float* input, const float* weight, const float* bias, float* output,
-		const size_t n, const size_t is, const size_t os)
+	void sigmoid_backward(const float* y, const float* dy, float* dx, const size_t len)
 	{
-		if (bias)
+		for (size_t i = 0; i < len; i++)
 		{
-			for (size_t k = 0; k < n; k++)
-			{
-				const float* n_input = input + k*is;
-				float* n_output = output + k*os;
-				for (size_t i = 0; i < os; i++)
-				{
-					float sum = 0.0f;
-					for (size_t j = 0; j < is; j++)
-					{
-						sum += n_input[j] * weight[i*is + j];
-					}
-					sum += bias[i];
-					n_output[i] = sum;
-				}
-			}
+			dx[i] = df_sigmoid(y[i])*dy[i];
+		}
+	}
+	void tanh_backward(const float* y, const float* dy, float* dx, const size_t len)
+	{
+		for (size_t i = 0; i < len; i++)
+		{
+			dx[i] = df_tanh(y[i])*dy[i];
+		}
+	}
+	void relu_backward(const float* y, const float* dy, float* dx, const size_t len)
+	{
+		for (size_t i = 0; i < len; i++)
+		{
+			dx[i] = df_relu(y[i])*dy[i];
+		}
+	}
+
+	//run kernel on whole tensor when it is one block, otherwise sample by sample
+	template<typename Kernel>
+	static void unary_blocks(const TensorView& x, const TensorView& y, Kernel kernel)
+	{
+		const DataSize size = x.getSize();
+		//any layout, both in the same one
+		const Layout layout = x.getLayout();
+		easyAssert(size == y.getSize() && y.getLayout() == layout, "size and layout must be equal!");
+		if (x.isDense(layout) && y.isDense(layout))
+		{
+			kernel(x.getData(), y.getData(), size.totalSize());
+			return;
+		}
+		easyAssert(x.isSampleDense(layout) && y.isSampleDense(layout), "every sample must be dense.");
+		for (size_t nn = 0; nn < size.number; nn++)
+		{
+			kernel(x.getSampleData(nn), y.getSampleData(nn), size._3DSize());
+		}
+	}
+	template<typename Kernel>
+	static void binary_blocks(const TensorView& a, const TensorView& b, const TensorView& c, Kernel kernel)
+	{
+		const DataSize size = a.getSize();
+		const Layout layout = a.getLayout();
+		easyAssert(size == b.getSize() && size == c.getSize() && b.getLayout() == layout && c.getLayout() == layout, "size and layout must be equal!");
+		if (a.isDense(layout) && b.isDense(layout) && c.isDense(layout))
+		{
+			kernel(a.getData(), b.getData(), c.getData(), size.totalSize());
+			return;
 		}
-		else
+		easyAssert(a.isSampleDense(layout) && b.isSampleDense(layout) && c.isSampleDense(layout), "every sample must be dense.");
+		for (size_t nn = 0; nn < size.number; nn++)
+		{
+			kernel(a.getSampleData(nn), b.getSampleData(nn), c.getSampleData(nn), size._3DSize());
+		}
+	}
+	void copy(const TensorView& x, const TensorView& y)
+	{
+		unary_blocks(x, y, [](const float* src, float* dst, const size_t len){
+			memcpy(dst, src, sizeof(float)*len);
+		});
+	}
+	void sigmoid(const TensorView& x, const TensorView& y)
+	{
+		unary_blocks(x, y, [](const float* src, float* dst, const size_t len){ sigmoid(src, dst, len); });
+	}
+	void tanh(const TensorView& x, const TensorView& y)
+	{
+		unary_blocks(x, y, [](const float* src, float* dst, const size_t len){ tanh(src, dst, len); });
+	}
+	void relu(const TensorView& x, const TensorView& y)
+	{
+		unary_blocks(x, y, [](const float* src, float* dst, const size_t len){ relu(src, dst, len); });
+	}
+	void sigmoid_backward(const TensorView& y, const TensorView& dy, const TensorView& dx)
+	{
+		binary_blocks(y, dy, dx, [](const float* a, const float* b, float* c, const size_t len){ sigmoid_backward(a, b, c, len); });
+	}
+	void tanh_backward(const TensorView& y, const TensorView& dy, const TensorView& dx)
+	{
+		binary_blocks(y, dy, dx, [](const float* a, const float* b, float* c, const size_t len){ tanh_backward(a, b, c, len); });
+	}
+	void relu_backward(const TensorView& y, const TensorView& dy, const TensorView& dx)
+	{
+		binary_blocks(y, dy, dx, [](const float* a, const float* b, float* c, const size_t len){ relu_backward(a, b, c, len); });
+	}
+
+	//
+	void fullconnect(const TensorView& input, const float* weight, const float* bias, const TensorView& output)
+	{
+		const size_t n = input.getSize().number;
+		const size_t is = input.getSize()._3DSize();
+		const size_t os = output.getSize()._3DSize();
+		easyAssert(output.getSize().number == n, "number of input and output must be equal.");
+		easyAssert(input.isSampleDense() && output.isSampleDense(), "every sample must be dense.");
+		//rows are samples
+		sgemm(false, true, n, os, is, 1.0f, input.getData(), input.numberStride, weight, is, 0.0f, output.getData(), output.numberStride);
+		if (bias)
 		{
 			for (size_t k = 0; k < n; k++)
 			{
-				const float* n_input = input + k*is;
-				float* n_output = output + k*os;
+				float* n_output = output.getSampleData(k);
 				for (size_t i = 0; i < os; i++)
 				{
-					float sum = 0.0f;
-					for (size_t j = 0; j < is; j++)
-					{
-						sum += n_input[j] * weight[i*is + j];
-					}
-					n_output[i] = sum;
+					n_output[i] += bias[i];
 				}
 			}
 		}
 	}
 	
-	static void convolution2d_validate(const float* input, const float* kernel, const float* bias, float* output,
-		const size_t in, const size_t ic, const size_t iw, const size_t ih,
-		const size_t kn, const size_t kw, const size_t kh, const size_t kws, const size_t khs,
-		const size_t ow, const size_t oh)
-	{
-		const DataSize inputSize(in, ic, iw, ih);
-		const DataSize kernelSize(kn, ic, kw, kh);
-		const DataSize outputSize(in, kn, ow, oh);
-		for (size_t nn = 0; nn < in; nn++)
+	static void convolution2d_validate(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const size_t rowStart, const size_t rowStop)
+	{
+		const DataSize inputSize = input.getSize();
+		const DataSize kernelSize = kernel.getSize();
+		const DataSize outputSize = output.getSize();
+		const float* inputData = input.getData();
+		const float* kernelData = kernel.getData();
+		float* outputData = output.getData();
+		for (size_t nn = 0; nn < inputSize.number; nn++)
 		{
 			for (size_t nc = 0; nc < outputSize.channels; nc++)
 			{
-				for (size_t nh = 0; nh < outputSize.height; nh++)
+				for (size_t nh = rowStart; nh < rowStop; nh++)
 				{
 					for (size_t nw = 0; nw < outputSize.width; nw++)
 					{
@@ -221,9 +295,9 @@ namespace EasyCNN
 							{
 								for (size_t kw = 0; kw < kernelSize.width; kw++)
 								{
-									const size_t prevIdx = inputSize.getIndex(nn, kc, inStartY + kh, inStartX + kw);
-									const size_t kernelIdx = kernelSize.getIndex(nc, kc, kh, kw);
-									sum += input[prevIdx] * kernel[kernelIdx];
+									const size_t prevIdx = input.getIndex(nn, kc, inStartY + kh, inStartX + kw);
+									const size_t kernelIdx = kernel.getIndex(nc, kc, kh, kw);
+									sum += inputData[prevIdx] * kernelData[kernelIdx];
 								}
 							}
 						}
@@ -232,31 +306,32 @@ namespace EasyCNN
 							const size_t biasIdx = nc;
 							sum += bias[biasIdx];
 						}
-						const size_t nextIdx = outputSize.getIndex(nn, nc, nh, nw);
-						output[nextIdx] = sum;
+						const size_t nextIdx = output.getIndex(nn, nc, nh, nw);
+						outputData[nextIdx] = sum;
 					}
 				}
 			}
 		}
 	}
-	static void convolution2d_same(const float* input, const float* kernel, const float* bias, float* output,
-		const size_t in, const size_t ic, const size_t iw, const size_t ih,
-		const size_t kn, const size_t kw, const size_t kh, const size_t kws, const size_t khs,
-		const size_t ow, const size_t oh)
+	static void convolution2d_same(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const size_t rowStart, const size_t rowStop)
 	{
-		const DataSize inputSize(in, ic, iw, ih);
-		const DataSize kernelSize(kn, ic, kw, kh);
-		const DataSize outputSize(in, kn, ow, oh);
-		for (size_t nn = 0; nn < in; nn++)
+		const DataSize inputSize = input.getSize();
+		const DataSize kernelSize = kernel.getSize();
+		const DataSize outputSize = output.getSize();
+		const float* inputData = input.getData();
+		const float* kernelData = kernel.getData();
+		float* outputData = output.getData();
+		for (size_t nn = 0; nn < inputSize.number; nn++)
 		{
 			for (size_t nc = 0; nc < outputSize.channels; nc++)
 			{
-				for (size_t nh = 0; nh < outputSize.height; nh++)
+				for (size_t nh = rowStart; nh < rowStop; nh++)
 				{
 					for (size_t nw = 0; nw < outputSize.width; nw++)
 					{
-						const int inStartX = nw - kw/2;
-						const int inStartY = nh - kh / 2;
+						const int inStartX = (int)nw - (int)kernelSize.width / 2;
+						const int inStartY = (int)nh - (int)kernelSize.height / 2;
 						float sum = 0;
 						for (size_t kc = 0; kc < kernelSize.channels; kc++)
 						{
@@ -264,13 +339,13 @@ namespace EasyCNN
 							{
 								for (size_t kw = 0; kw < kernelSize.width; kw++)
 								{
-									const int inY = inStartY + kh;
-									const int inX = inStartX + kw;
+									const int inY = inStartY + (int)kh;
+									const int inX = inStartX + (int)kw;
 									if (inY >= 0 && inY<(int)inputSize.height && inX >= 0 && inX<(int)inputSize.width)
 									{
-										const size_t prevIdx = inputSize.getIndex(nn, kc, inY, inX);
-										const size_t kernelIdx = kernelSize.getIndex(nc, kc, kh, kw);
-										sum += input[prevIdx] * kernel[kernelIdx];
+										const size_t prevIdx = input.getIndex(nn, kc, inY, inX);
+										const size_t kernelIdx = kernel.getIndex(nc, kc, kh, kw);
+										sum += inputData[prevIdx] * kernelData[kernelIdx];
 									}									
 								}
 							}
@@ -280,25 +355,31 @@ namespace EasyCNN
 							const size_t biasIdx = nc;
 							sum += bias[biasIdx];
 						}
-						const size_t nextIdx = outputSize.getIndex(nn, nc, nh, nw);
-						output[nextIdx] = sum;
+						const size_t nextIdx = output.getIndex(nn, nc, nh, nw);
+						outputData[nextIdx] = sum;
 					}
 				}
 			}
 		}
 	}
-	void convolution2d(const float* input, const float* kernel, const float* bias, float* output,
-		const size_t in, const size_t ic, const size_t iw, const size_t ih,
-		const size_t kn, const size_t kw, const size_t kh, const size_t kws, const size_t khs,
-		const size_t ow, const size_t oh,
-		const int mode)
+	void convolution2d(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode)
+	{
+		convolution2d(input, kernel, bias, output, kws, khs, mode, 0, output.getSize().height);
+	}
+	void convolution2d(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop)
 	{
+		easyAssert(input.getSize().number == output.getSize().number, "number of input and output must be equal.");
+		easyAssert(input.getSize().channels == kernel.getSize().channels && output.getSize().channels == kernel.getSize().number,
+			"channels of kernel is invalidate.");
+		easyAssert(rowStart <= rowStop && rowStop <= output.getSize().height, "rows are out of output.");
 		if (mode == 0)
 		{
-			convolution2d_validate(input, kernel, bias, output, in, ic, iw, ih, kn, kw, kh, kws, khs, ow, oh);
+			convolution2d_validate(input, kernel, bias, output, kws, khs, rowStart, rowStop);
 		}else if (mode == 1)
 		{
-			convolution2d_same(input, kernel, bias, output, in, ic, iw, ih, kn, kw, kh, kws, khs, ow, oh);
+			convolution2d_same(input, kernel, bias, output, kws, khs, rowStart, rowStop);
 		}
 	}
-}//namespace
+}//namespace
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include <algorithm>
+#include "EasyCNN/MemoryPlanner.h"
+#include "EasyCNN/MemoryPool.h"
+#include "EasyCNN/EasyAssert.h"
+
+namespace EasyCNN
+{
+	size_t MemoryPlanner::addTensor(const size_t bytes, const int firstUse, const int lastUse)
+	{
+		easyAssert(firstUse <= lastUse, "live range is invalidate.");
+		TensorInfo info;
+		info.bytes = (bytes + MEMORY_ALIGNMENT - 1) / MEMORY_ALIGNMENT * MEMORY_ALIGNMENT;
+		info.firstUse = firstUse;
+		info.lastUse = lastUse;
+		info.offset = 0;
+		tensors.push_back(info);
+		return tensors.size() - 1;
+	}
+	size_t MemoryPlanner::solve()
+	{
+		//place big tensors first, each one goes to the lowest gap
+		//which is not used by any placed tensor alive at the same time.
+		std::vector<size_t> order(tensors.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [this](const size_t a, const size_t b){
+			return tensors[a].bytes > tensors[b].bytes;
+		});
+		slabSize = 0;
+		std::vector<size_t> placed;
+		for (const size_t id : order)
+		{
+			TensorInfo& cur = tensors[id];
+			std::vector<size_t> conflicts;
+			for (const size_t other : placed)
+			{
+				const TensorInfo& info = tensors[other];
+				if (info.firstUse <= cur.lastUse && cur.firstUse <= info.lastUse)
+				{
+					conflicts.push_back(other);
+				}
+			}
+			std::sort(conflicts.begin(), conflicts.end(), [this](const size_t a, const size_t b){
+				return tensors[a].offset < tensors[b].offset;
+			});
+			size_t candidate = 0;
+			for (const size_t other : conflicts)
+			{
+				const TensorInfo& info = tensors[other];
+				if (info.offset >= candidate + cur.bytes)
+				{
+					break;
+				}
+				candidate = std::max(candidate, info.offset + info.bytes);
+			}
+			cur.offset = candidate;
+			slabSize = std::max(slabSize, cur.offset + cur.bytes);
+			placed.push_back(id);
+		}
+		return slabSize;
+	}
+	size_t MemoryPlanner::getOffset(const size_t id) const
+	{
+		easyAssert(id < tensors.size(), "tensor id is out of range.");
+		return tensors[id].offset;
+	}
+	size_t MemoryPlanner::getSlabSize() const
+	{
+		return slabSize;
+	}
+	size_t MemoryPlanner::getNaiveSize() const
+	{
+		size_t result = 0;
+		for (const auto& info : tensors)
+		{
+			result += info.bytes;
+		}
+		return result;
+	}
+}//namespace
\ No newline at end of file
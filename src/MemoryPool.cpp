@@ -0,0 +1,241 @@
+#include <cstdlib>
+#include <algorithm>
+#include <new>
+#include "EasyCNN/MemoryPool.h"
+#include "EasyCNN/EasyAssert.h"
+
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace EasyCNN
+{
+	static void* alignedMalloc(const size_t bytes, const size_t alignment = MEMORY_ALIGNMENT)
+	{
+		void* ptr = nullptr;
+#ifdef _MSC_VER
+		ptr = _aligned_malloc(bytes, alignment);
+#else
+		if (posix_memalign(&ptr, alignment, bytes) != 0)
+		{
+			ptr = nullptr;
+		}
+#endif
+		return ptr;
+	}
+	static size_t roundToHugePage(const size_t bytes)
+	{
+		return (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+	}
+	static void alignedFree(void* ptr)
+	{
+#ifdef _MSC_VER
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+	MemoryPool::MemoryPool()
+	{
+
+	}
+	MemoryPool::~MemoryPool()
+	{
+		trim();
+	}
+	std::shared_ptr<MemoryPool> MemoryPool::defaultPool()
+	{
+		static std::shared_ptr<MemoryPool> inst = std::make_shared<MemoryPool>();
+		return inst;
+	}
+	//small blocks: multiple of alignment.
+	//large blocks: 4 classes per power of two, so waste is less than 25%.
+	size_t MemoryPool::getSizeClass(const size_t bytes)
+	{
+		const size_t smallLimit = 4096;
+		size_t result = (std::max)(bytes, MEMORY_ALIGNMENT);
+		result = (result + MEMORY_ALIGNMENT - 1) / MEMORY_ALIGNMENT * MEMORY_ALIGNMENT;
+		if (result <= smallLimit)
+		{
+			return result;
+		}
+		size_t base = smallLimit;
+		while (base * 2 <= result)
+		{
+			base *= 2;
+		}
+		const size_t step = base / 4;
+		return (result + step - 1) / step * step;
+	}
+	void* MemoryPool::allocate(const size_t bytes)
+	{
+		const size_t sizeClass = getSizeClass(bytes);
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			auto iter = freeBlocks.find(sizeClass);
+			if (iter != freeBlocks.end() && !iter->second.empty())
+			{
+				void* ptr = iter->second.back();
+				iter->second.pop_back();
+				cachedBytes -= sizeClass;
+				return ptr;
+			}
+			systemAllocCount++;
+		}
+		void* ptr = systemAllocate(sizeClass);
+		if (ptr == nullptr)
+		{
+			//out of memory, release cache and try again
+			trim();
+			ptr = systemAllocate(sizeClass);
+		}
+		easyAssert(ptr != nullptr, "out of memory, request %d bytes.", (int)sizeClass);
+		return ptr;
+	}
+	void* MemoryPool::systemAllocate(const size_t sizeClass)
+	{
+		HugePageMode mode = HugePageMode::Disabled;
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			if (sizeClass >= hugePageThreshold)
+			{
+				mode = hugePageMode;
+			}
+		}
+#ifdef __linux__
+		if (mode != HugePageMode::Disabled)
+		{
+			HugeBlock block;
+			block.length = roundToHugePage(sizeClass);
+			void* ptr = nullptr;
+#ifdef MAP_HUGETLB
+			if (mode == HugePageMode::Explicit)
+			{
+				ptr = mmap(nullptr, block.length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+				if (ptr == MAP_FAILED)
+				{
+					//no reserved huge page, try transparent one
+					ptr = nullptr;
+				}
+				else
+				{
+					block.mapped = true;
+					block.backed = true;
+				}
+			}
+#endif //MAP_HUGETLB
+			if (ptr == nullptr)
+			{
+				ptr = alignedMalloc(block.length, HUGE_PAGE_SIZE);
+#ifdef MADV_HUGEPAGE
+				if (ptr != nullptr)
+				{
+					//only a hint, kernel without THP rejects it and block stays on normal pages
+					block.backed = (madvise(ptr, block.length, MADV_HUGEPAGE) == 0);
+				}
+#endif //MADV_HUGEPAGE
+			}
+			if (ptr != nullptr)
+			{
+				std::lock_guard<std::mutex> lock(poolMutex);
+				hugeBlocks[ptr] = block;
+				if (block.backed)
+				{
+					hugePageBytes += block.length;
+				}
+				return ptr;
+			}
+		}
+#endif //__linux__
+		return alignedMalloc(sizeClass);
+	}
+	//caller holds poolMutex
+	void MemoryPool::systemFree(void* ptr)
+	{
+		auto iter = hugeBlocks.find(ptr);
+		if (iter == hugeBlocks.end())
+		{
+			alignedFree(ptr);
+			return;
+		}
+		const HugeBlock block = iter->second;
+		hugeBlocks.erase(iter);
+		if (block.backed)
+		{
+			hugePageBytes -= block.length;
+		}
+#ifdef __linux__
+		if (block.mapped)
+		{
+			munmap(ptr, block.length);
+			return;
+		}
+#endif //__linux__
+		alignedFree(ptr);
+	}
+	void MemoryPool::deallocate(void* ptr, const size_t bytes)
+	{
+		if (ptr == nullptr)
+		{
+			return;
+		}
+		const size_t sizeClass = getSizeClass(bytes);
+		std::lock_guard<std::mutex> lock(poolMutex);
+		freeBlocks[sizeClass].push_back(ptr);
+		cachedBytes += sizeClass;
+	}
+	void MemoryPool::trim()
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		for (auto& item : freeBlocks)
+		{
+			for (void* ptr : item.second)
+			{
+				systemFree(ptr);
+			}
+		}
+		freeBlocks.clear();
+		cachedBytes = 0;
+	}
+	void MemoryPool::setHugePagePolicy(const HugePageMode mode, const size_t thresholdBytes)
+	{
+		//cached blocks were allocated by old policy
+		trim();
+		std::lock_guard<std::mutex> lock(poolMutex);
+		hugePageMode = mode;
+		hugePageThreshold = (std::max)(thresholdBytes, MEMORY_ALIGNMENT);
+	}
+	HugePageMode MemoryPool::getHugePageMode() const
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return hugePageMode;
+	}
+	size_t MemoryPool::getCachedBytes() const
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return cachedBytes;
+	}
+	size_t MemoryPool::getSystemAllocCount() const
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return systemAllocCount;
+	}
+	size_t MemoryPool::getHugePageBytes() const
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		return hugePageBytes;
+	}
+
+	std::shared_ptr<float> make_pooled_buffer(const std::shared_ptr<MemoryPool>& pool, const size_t len)
+	{
+		const size_t bytes = sizeof(float)*len;
+		float* ptr = static_cast<float*>(pool->allocate(bytes));
+		//reference count comes from pool too, allocator in it keeps pool alive while deleter runs
+		MemoryPool* owner = pool.get();
+		return std::shared_ptr<float>(ptr, [owner, bytes](float* p){ owner->deallocate(p, bytes); }, PoolAllocator<float>(pool));
+	}
+}//namespace
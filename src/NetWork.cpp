@@ -14,8 +14,14 @@
 #include "EasyCNN/SoftmaxLayer.h"
 #include "EasyCNN/DropoutLayer.h"
 #include "EasyCNN/BatchNormalizationLayer.h"
+#include "EasyCNN/LayoutLayer.h"
 //network
 #include "EasyCNN/NetWork.h"
+#include "EasyCNN/MemoryPlanner.h"
+#include "EasyCNN/Workspace.h"
+#include "EasyCNN/ThreadPool.h"
+#include "EasyCNN/ParallelBackend.h"
+#include "EasyCNN/MathFunctions.h"
 
 namespace EasyCNN
 {
@@ -23,8 +29,43 @@ namespace EasyCNN
 	{
 		logVerbose("NetWork constructed.");
 	}
+	NetWork::NetWork(NetWork&& other)
+	{
+		//requests of other run on its layers, so they are done before layers move
+		other.stopAsync();
+		phase = other.phase;
+		layers = std::move(other.layers);
+		dataBuckets = std::move(other.dataBuckets);
+		diffBuckets = std::move(other.diffBuckets);
+		activationSlab = std::move(other.activationSlab);
+		memoryPlanned = other.memoryPlanned;
+		plannedBatch = other.plannedBatch;
+		reservedBatch = other.reservedBatch;
+		inferenceOnly = other.inferenceOnly;
+		blockedLayoutEnabled = other.blockedLayoutEnabled;
+		nhwcLayoutEnabled = other.nhwcLayoutEnabled;
+		inputLayout = other.inputLayout;
+		layoutPlanned = other.layoutPlanned;
+		convertedInput = std::move(other.convertedInput);
+		memoryPool = other.memoryPool;
+		scheduler = other.scheduler;
+		//nodes of backward graph bind other, it is rebuilt by next backward
+		backwardGraphLayers = 0;
+		lossFunctor = std::move(other.lossFunctor);
+		optimizer = std::move(other.optimizer);
+		//thread of other is joined, next submit starts one for this network
+		async.swap(other.async);
+		async->stop = false;
+		other.memoryPlanned = false;
+		other.layoutPlanned = false;
+		other.plannedBatch = 0;
+		other.backwardGraph.reset();
+		other.backwardGraphLayers = 0;
+		logVerbose("NetWork moved.");
+	}
 	NetWork::~NetWork()
 	{
+		stopAsync();
 		logVerbose("NetWork destructed.");
 	}
 
@@ -104,40 +145,112 @@ namespace EasyCNN
 		ss >> layerType;
 		return layerType;
 	}
-	std::shared_ptr<DataBucket> NetWork::forward(const std::shared_ptr<DataBucket> inputDataBucket)
+	std::shared_ptr<DataBucket> NetWork::forward(const std::shared_ptr<DataBucket> inputDataBucket,
+		const std::shared_ptr<DataBucket> outputDataBucket)
 	{
 		logVerbose("NetWork forward begin.");
 		easyAssert(layers.size() > 1, "layer count is less than 2.");
 		easyAssert(layers[0]->getLayerType() == InputLayer::layerType, "first layer is not input layer.");
 		easyAssert(dataBuckets.size() > 0, "data buckets is not ready.");
-		//copy data from inputDataBucket
+		easyAssert(inputDataBucket->getSize()._3DSize() == layers[0]->getInputBucketSize()._3DSize(), "input size is invalidate.");
+		//layers dispatch to scheduler of this network
+		const SchedulerScope schedulerScope(scheduler.get());
+		//train phase needs every activation for backward
+		if (phase == Phase::Train && memoryPlanned)
+		{
+			releaseMemoryPlan();
+		}
+		//layout of layers is planned for layout of input
+		if (memoryPlanned && inputDataBucket->getLayout() != inputLayout)
+		{
+			inputLayout = inputDataBucket->getLayout();
+			const size_t number = dataBuckets[dataBuckets.size() - 1]->getSize().number;
+			releaseLayout();
+			planMemory(number);
+		}
+		//layers run NCHW on NHWC input : it is converted into own bucket once
+		std::shared_ptr<DataBucket> boundInputDataBucket = inputDataBucket;
+		if (inputDataBucket->getLayout() != getActivationLayout(0))
+		{
+			easyAssert(inputDataBucket->getLayout() == Layout::NHWC, "layout of input is invalidate.");
+			if (!convertedInput)
+			{
+				convertedInput = std::make_shared<DataBucket>(inputDataBucket->getSize(), memoryPool);
+			}
+			convertedInput->reshape(inputDataBucket->getSize());
+			const TensorView src = inputDataBucket->getView();
+			const TensorView dst = convertedInput->getView();
+			const size_t number = src.getSize().number;
+			parallel_for(0, number, get_parallel_grain({ number }, LayerCost(0.0, 2.0*sizeof(float)*src.getSize().totalSize())),
+				[&](const size_t start, const size_t stop){
+				nhwc_to_nchw(src.slice(start, stop - start), dst.slice(start, stop - start));
+			});
+			boundInputDataBucket = convertedInput;
+		}
+		//bind input : caller's bucket is used directly(InputLayer is inplace), no copy.
+		//it is referenced until next forward.
+		const auto oldInputDataBucket = dataBuckets[0];
+		for (size_t i = 0; i < dataBuckets.size() && dataBuckets[i] == oldInputDataBucket; i++)
+		{
+			dataBuckets[i] = boundInputDataBucket;
+		}
 		//reshape data bucket
-		const auto oldNumber = dataBuckets[0]->getSize().number;
-		const auto newNumber = inputDataBucket->getSize().number;
+		const auto oldNumber = dataBuckets[dataBuckets.size() - 1]->getSize().number;
+		const auto newNumber = boundInputDataBucket->getSize().number;
 		if (newNumber != oldNumber)
 		{
-			for (size_t i = 0; i < dataBuckets.size(); i++)
+			if (memoryPlanned && newNumber > plannedBatch)
+			{
+				planMemory(newNumber);
+			}
+			else
 			{
-				auto newSize = dataBuckets[i]->getSize();
-				newSize.number = newNumber;
-				dataBuckets[i].reset(new DataBucket(newSize));
+				for (size_t i = 0; i < dataBuckets.size(); i++)
+				{
+					if (dataBuckets[i] == boundInputDataBucket)
+					{
+						continue;
+					}
+					auto newSize = dataBuckets[i]->getSize();
+					newSize.number = newNumber;
+					dataBuckets[i]->reshape(newSize);
+				}
+			}
+		}
+		//bind output : last layer(s) write to caller's bucket directly
+		const auto innerOutputDataBucket = dataBuckets[dataBuckets.size() - 1];
+		std::vector<size_t> boundOutputIdxes;
+		if (outputDataBucket)
+		{
+			easyAssert(outputDataBucket->getSize() == innerOutputDataBucket->getSize(), "output size is invalidate.");
+			outputDataBucket->setLayout(innerOutputDataBucket->getLayout());
+			for (size_t i = dataBuckets.size() - 1; i > 0 && dataBuckets[i] == innerOutputDataBucket; i--)
+			{
+				dataBuckets[i] = outputDataBucket;
+				boundOutputIdxes.push_back(i);
 			}
 		}
-		inputDataBucket->cloneTo(*dataBuckets[0]);
 
 		for (size_t i = 0; i < layers.size(); i++)
 		{
 			logVerbose("NetWork layer[%d](%s) forward begin.", i, layers[i]->getLayerType().c_str());
-			if (i < layers.size() - 1)
+			//clear only when layer accumulates to output, inplace layer always overwrites
+			if (layers[i]->getOutputWriteMode() == WriteMode::Accumulate && dataBuckets[i + 1] != dataBuckets[i])
 			{
 				dataBuckets[i + 1]->fillData(0.0f);
 			}
-			layers[i]->forward(dataBuckets[i], dataBuckets[i + 1]);
+			layers[i]->forward(dataBuckets[i]->getView(), dataBuckets[i + 1]->getView());
 			logVerbose("NetWork layer[%d](%s) forward end.", i, layers[i]->getLayerType().c_str());
 		}
 
+		//unbind output, caller's bucket is not referenced after return
+		for (const size_t idx : boundOutputIdxes)
+		{
+			dataBuckets[idx] = innerOutputDataBucket;
+		}
+
 		logVerbose("NetWork forward end.");
-		return dataBuckets[dataBuckets.size() - 1];
+		return outputDataBucket ? outputDataBucket : innerOutputDataBucket;
 	}
 	float NetWork::backward(const std::shared_ptr<DataBucket> labelDataBucket)
 	{
@@ -149,49 +262,116 @@ namespace EasyCNN
 
 		const auto lastOutputData = dataBuckets[dataBuckets.size() - 1];
 		easyAssert(lastOutputData->getSize() == labelDataBucket->getSize(), "last data bucket's size must be equals with label.");
+		const SchedulerScope schedulerScope(scheduler.get());
 
 		//get loss
 		const float loss = getLoss(labelDataBucket, lastOutputData);
 
 		//get diff
-		if (diffBuckets.size() != layers.size()+1)
+		//diff buckets are created lazily, and released by memory plan of test phase
+		while (diffBuckets.size() < dataBuckets.size())
 		{
-			diffBuckets.push_back(std::make_shared<DataBucket>(labelDataBucket->getSize()));
-		}
-		for (size_t i = 0; i < dataBuckets.size(); i++)
-		{
-			if (diffBuckets[i]->getSize() != dataBuckets[i]->getSize())
+			const size_t i = diffBuckets.size();
+			//diff of inplace layer is inplace too
+			if (i > 0 && dataBuckets[i] == dataBuckets[i - 1])
+			{
+				diffBuckets.push_back(diffBuckets[i - 1]);
+			}
+			else
 			{
-				diffBuckets[i].reset(new DataBucket(dataBuckets[i]->getSize()));
+				diffBuckets.push_back(std::make_shared<DataBucket>(dataBuckets[i]->getSize(), memoryPool));
+				diffBuckets[i]->reserve(reservedBatch*dataBuckets[i]->getSize()._3DSize());
 			}
 		}
-		if (diffBuckets[diffBuckets.size()-1]->getSize() != labelDataBucket->getSize())
+		for (size_t i = 0; i < dataBuckets.size(); i++)
 		{
-			diffBuckets[diffBuckets.size() - 1].reset(new DataBucket(labelDataBucket->getSize()));
+			diffBuckets[i]->reshape(dataBuckets[i]->getSize());
 		}
+		diffBuckets[diffBuckets.size() - 1]->reshape(labelDataBucket->getSize());
 
 		lossFunctor->getDiff(labelDataBucket, lastOutputData, diffBuckets[diffBuckets.size() - 1]);		
-		//other layer backward
-		for (int i = (int)(layers.size()) - 1; i >= 0; i--)
+		//other layer backward and update, weight grad of a layer runs beside input grad of layers below it
+		if (backwardGraphLayers != layers.size())
 		{
-			logVerbose("NetWork layer[%d](%s) backward begin.", i, layers[i]->getLayerType().c_str());
-			diffBuckets[i]->fillData(0.0f);
-			layers[i]->backward(dataBuckets[i], dataBuckets[i + 1], diffBuckets[i], diffBuckets[i+1]);
-			logVerbose("NetWork layer[%d](%s) backward end.", i, layers[i]->getLayerType().c_str());
+			buildBackwardGraph();
 		}
+		parallel_run_graph(*backwardGraph);
+
+		logVerbose("NetWork backward end.");
 
+		return loss;
+	}
 
-		//update parameters
+	void NetWork::buildBackwardGraph()
+	{
+		backwardGraph.reset(new TaskGraph());
+		//buckets and views are looked up when node runs, they change with batch
+		auto clearGradients = [this](const size_t i){
+			if (layers[i]->getGradientWriteMode() == WriteMode::Accumulate)
+			{
+				for (const auto& gradient : layers[i]->getDiffData())
+				{
+					if (gradient)
+					{
+						gradient->fillData(0.0f);
+					}
+				}
+			}
+		};
+		size_t prevInputGrad = 0;
+		size_t prevUpdate = 0;
 		for (int i = (int)(layers.size()) - 1; i >= 0; i--)
 		{
-			logVerbose("NetWork layer[%d](%s) backward begin.", i, layers[i]->getLayerType().c_str());
-			optimizer->update(layers[i]->getParamData(), layers[i]->getDiffData());
-			logVerbose("NetWork layer[%d](%s) backward end.", i, layers[i]->getLayerType().c_str());
+			const bool split = layers[i]->supportSplitBackward();
+			const size_t inputGrad = backwardGraph->addNode([this, i, split, clearGradients](){
+				logVerbose("NetWork layer[%d](%s) backward begin.", i, layers[i]->getLayerType().c_str());
+				//clear only when layer accumulates to prevDiff/gradients
+				if (layers[i]->getDiffWriteMode() == WriteMode::Accumulate && diffBuckets[i] != diffBuckets[i + 1])
+				{
+					diffBuckets[i]->fillData(0.0f);
+				}
+				if (split)
+				{
+					layers[i]->backwardDiff(dataBuckets[i]->getView(), dataBuckets[i + 1]->getView(),
+						diffBuckets[i]->getView(), diffBuckets[i + 1]->getView());
+				}
+				else
+				{
+					clearGradients(i);
+					layers[i]->backward(dataBuckets[i]->getView(), dataBuckets[i + 1]->getView(),
+						diffBuckets[i]->getView(), diffBuckets[i + 1]->getView());
+				}
+				logVerbose("NetWork layer[%d](%s) backward end.", i, layers[i]->getLayerType().c_str());
+			});
+			const size_t update = backwardGraph->addNode([this, i](){
+				optimizer->update(layers[i]->getParamData(), layers[i]->getDiffData());
+				layers[i]->onParamsChanged();
+			});
+			if (split)
+			{
+				const size_t weightGrad = backwardGraph->addNode([this, i, clearGradients](){
+					clearGradients(i);
+					layers[i]->backwardGradient(dataBuckets[i]->getView(), dataBuckets[i + 1]->getView(), diffBuckets[i + 1]->getView());
+				});
+				if (i + 1 < (int)layers.size())
+				{
+					backwardGraph->addEdge(prevInputGrad, weightGrad);
+				}
+				backwardGraph->addEdge(weightGrad, update);
+			}
+			//input grad is last successor, so it stays on the thread of layer above(critical path)
+			if (i + 1 < (int)layers.size())
+			{
+				backwardGraph->addEdge(prevInputGrad, inputGrad);
+				//optimizer keeps its state in order of layers
+				backwardGraph->addEdge(prevUpdate, update);
+			}
+			//input grad reads weights before they are updated
+			backwardGraph->addEdge(inputGrad, update);
+			prevInputGrad = inputGrad;
+			prevUpdate = update;
 		}
-
-		logVerbose("NetWork backward end.");
-
-		return loss;
+		backwardGraphLayers = layers.size();
 	}
 
 	//////////////////////////////////////////////////////////////////////////
@@ -213,6 +393,8 @@ namespace EasyCNN
 			easyAssert(layerType == InputLayer::layerType, "The first layer must be InputLayer!");
 			std::shared_ptr<Layer> layer = createLayerByType(layerType);
 			easyAssert(layer.get() != nullptr, "layer can't be null.");
+			layer->setPhase(phase);
+			layer->setMemoryPool(memoryPool);
 			layer->serializeFromString(line);
 			setInputSize(layer->getInputBucketSize());
 			addayer(layer);
@@ -234,17 +416,284 @@ namespace EasyCNN
 			easyAssert(prev.get() != nullptr, "previous bucket is null.");
 			const DataSize inputSize = prev->getSize();
 			layer->setInputBucketSize(inputSize);
+			layer->setPhase(phase);
+			layer->setMemoryPool(memoryPool);
 			layer->serializeFromString(line);
 			addayer(layer);
 		}
-		setPhase(Phase::Test);
+		finalize();
 		return true;
 	}
+	void NetWork::finalize()
+	{
+		logVerbose("NetWork finalize begin.");
+		easyAssert(layers.size() > 1, "layer count is less than 2.");
+		setPhase(Phase::Test);
+		planMemory(dataBuckets[0]->getSize().number);
+		logVerbose("NetWork finalize end.");
+	}
+	void NetWork::setInferenceOnly()
+	{
+		logVerbose("NetWork setInferenceOnly begin.");
+		inferenceOnly = true;
+		setPhase(Phase::Test);
+		for (const auto& layer : layers)
+		{
+			layer->releaseTrainingState();
+		}
+		diffBuckets.clear();
+		//momentum of params
+		optimizer.reset();
+		//activations of train phase are replaced by slab
+		if (layers.size() > 1 && !memoryPlanned)
+		{
+			planMemory(dataBuckets[0]->getSize().number);
+		}
+		logVerbose("NetWork setInferenceOnly end.");
+	}
+	void NetWork::setHugePagePolicy(const HugePageMode mode, const size_t thresholdBytes)
+	{
+		logVerbose("NetWork setHugePagePolicy begin.");
+		easyAssert(dataBuckets.empty() && layers.empty(), "huge page policy must be set before building network.");
+		//own pool, policy of others is untouched
+		memoryPool = std::make_shared<MemoryPool>();
+		memoryPool->setHugePagePolicy(mode, thresholdBytes);
+		logVerbose("NetWork setHugePagePolicy end.");
+	}
+	void NetWork::setBlockedLayout(const bool enabled)
+	{
+		logVerbose("NetWork setBlockedLayout begin.");
+		blockedLayoutEnabled = enabled;
+		//planned again at once
+		if (memoryPlanned)
+		{
+			const size_t number = dataBuckets[dataBuckets.size() - 1]->getSize().number;
+			releaseLayout();
+			planMemory(number);
+		}
+		logVerbose("NetWork setBlockedLayout end.");
+	}
+	void NetWork::setNHWCLayout(const bool enabled)
+	{
+		logVerbose("NetWork setNHWCLayout begin.");
+		nhwcLayoutEnabled = enabled;
+		//planned again at once
+		if (memoryPlanned)
+		{
+			const size_t number = dataBuckets[dataBuckets.size() - 1]->getSize().number;
+			releaseLayout();
+			planMemory(number);
+		}
+		logVerbose("NetWork setNHWCLayout end.");
+	}
+	void NetWork::setScheduler(std::shared_ptr<TaskScheduler> scheduler)
+	{
+		this->scheduler = scheduler;
+	}
+	std::shared_ptr<TaskScheduler> NetWork::getScheduler() const
+	{
+		return scheduler;
+	}
+	void NetWork::reserve(const size_t maxBatch)
+	{
+		logVerbose("NetWork reserve begin.");
+		easyAssert(layers.size() > 1, "layer count is less than 2.");
+		reservedBatch = std::max(reservedBatch, maxBatch);
+		//storage is first touched by threads which will process it
+		const SchedulerScope schedulerScope(scheduler.get());
+		for (const auto& layer : layers)
+		{
+			layer->reserve(reservedBatch);
+		}
+		if (memoryPlanned)
+		{
+			if (reservedBatch > plannedBatch)
+			{
+				planMemory(dataBuckets[dataBuckets.size() - 1]->getSize().number);
+			}
+		}
+		else
+		{
+			//input bucket(and its inplace aliases) may be caller's
+			for (size_t i = 0; i < dataBuckets.size(); i++)
+			{
+				if (dataBuckets[i] != dataBuckets[0])
+				{
+					dataBuckets[i]->reserve(reservedBatch*dataBuckets[i]->getSize()._3DSize());
+				}
+			}
+		}
+		for (const auto& diffBucket : diffBuckets)
+		{
+			diffBucket->reserve(reservedBatch*diffBucket->getSize()._3DSize());
+		}
+		//outputs dropped by callers
+		{
+			std::lock_guard<std::mutex> lock(async->outputs->mutex);
+			for (const auto& output : async->outputs->idle)
+			{
+				output->reserve(reservedBatch*output->getSize()._3DSize());
+			}
+		}
+		logVerbose("NetWork reserve end.");
+	}
 	//train phase may use this
 	std::shared_ptr<DataBucket> NetWork::testBatch(const std::shared_ptr<DataBucket> inputDataBucket)
 	{
+		const std::lock_guard<std::mutex> runLock(async->runMutex);
 		setPhase(Phase::Test);
-		return forward(inputDataBucket);
+		//inner output lives in planned slab, a request of submit would overwrite it while caller reads it
+		const std::shared_ptr<DataBucket> output = acquireOutput(inputDataBucket->getSize().number);
+		forward(inputDataBucket, output);
+		return output;
+	}
+	void NetWork::testBatch(const std::shared_ptr<DataBucket> inputDataBucket, std::shared_ptr<DataBucket> outputDataBucket)
+	{
+		easyAssert(outputDataBucket.get() != nullptr, "output bucket can't be null.");
+		const std::lock_guard<std::mutex> runLock(async->runMutex);
+		setPhase(Phase::Test);
+		forward(inputDataBucket, outputDataBucket);
+	}
+	std::future<std::shared_ptr<DataBucket>> NetWork::submit(const std::shared_ptr<DataBucket> inputDataBucket)
+	{
+		AsyncRequest request;
+		request.input = inputDataBucket;
+		request.promise = std::make_shared<std::promise<std::shared_ptr<DataBucket>>>();
+		std::future<std::shared_ptr<DataBucket>> result = request.promise->get_future();
+		enqueueRequest(std::move(request));
+		return result;
+	}
+	void NetWork::submit(const std::shared_ptr<DataBucket> inputDataBucket, std::function<void(std::shared_ptr<DataBucket>)> callback)
+	{
+		AsyncRequest request;
+		request.input = inputDataBucket;
+		request.callback = callback;
+		enqueueRequest(std::move(request));
+	}
+	void NetWork::setMaxPending(const size_t maxPending)
+	{
+		easyAssert(maxPending > 0, "parameter invalidate.");
+		{
+			std::lock_guard<std::mutex> lock(async->mutex);
+			async->maxPending = maxPending;
+		}
+		async->spaceCondition.notify_all();
+	}
+	size_t NetWork::getPendingCount() const
+	{
+		std::lock_guard<std::mutex> lock(async->mutex);
+		return async->pendingCount;
+	}
+	std::shared_ptr<DataBucket> NetWork::acquireOutput(const size_t number)
+	{
+		easyAssert(dataBuckets.size() > 0, "data buckets is not ready.");
+		DataSize outputSize = dataBuckets[dataBuckets.size() - 1]->getSize();
+		outputSize.number = number;
+		const std::shared_ptr<OutputCache> cache = async->outputs;
+		std::shared_ptr<DataBucket> bucket;
+		{
+			std::lock_guard<std::mutex> lock(cache->mutex);
+			if (!cache->idle.empty())
+			{
+				bucket = cache->idle.back();
+				cache->idle.pop_back();
+			}
+		}
+		if (bucket)
+		{
+			bucket->reshape(outputSize);
+		}
+		else
+		{
+			bucket = std::make_shared<DataBucket>(outputSize, memoryPool);
+			bucket->reserve(reservedBatch*outputSize._3DSize());
+		}
+		//bucket comes back to cache when caller drops output, reference count is taken from pool
+		return std::shared_ptr<DataBucket>(bucket.get(), [cache, bucket](DataBucket*){
+			std::lock_guard<std::mutex> lock(cache->mutex);
+			cache->idle.push_back(bucket);
+		}, PoolAllocator<DataBucket>(memoryPool));
+	}
+	void NetWork::enqueueRequest(AsyncRequest request)
+	{
+		easyAssert(request.input.get() != nullptr, "input bucket can't be null.");
+		{
+			std::unique_lock<std::mutex> lock(async->mutex);
+			async->spaceCondition.wait(lock, [this](){ return async->pendingCount < async->maxPending; });
+			if (!async->thread.joinable())
+			{
+				async->thread = std::thread(&NetWork::asyncLoop, this);
+			}
+			async->requests.push_back(std::move(request));
+			async->pendingCount++;
+		}
+		async->requestCondition.notify_one();
+	}
+	void NetWork::stopAsync()
+	{
+		{
+			std::lock_guard<std::mutex> lock(async->mutex);
+			async->stop = true;
+		}
+		async->requestCondition.notify_all();
+		if (async->thread.joinable())
+		{
+			async->thread.join();
+		}
+	}
+	void NetWork::asyncLoop()
+	{
+		prepare_workspace();
+		while (true)
+		{
+			AsyncRequest request;
+			{
+				std::unique_lock<std::mutex> lock(async->mutex);
+				async->requestCondition.wait(lock, [this](){ return async->stop || !async->requests.empty(); });
+				if (async->requests.empty())
+				{
+					return;
+				}
+				request = std::move(async->requests.front());
+				async->requests.pop_front();
+			}
+			//output of every request is its own, buckets dropped by callers are reused
+			std::shared_ptr<DataBucket> output;
+			std::exception_ptr error;
+			try
+			{
+				const std::lock_guard<std::mutex> runLock(async->runMutex);
+				setPhase(Phase::Test);
+				output = acquireOutput(request.input->getSize().number);
+				forward(request.input, output);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+				output.reset();
+			}
+			//room for next submit before caller sees output
+			{
+				std::lock_guard<std::mutex> lock(async->mutex);
+				async->pendingCount--;
+			}
+			async->spaceCondition.notify_one();
+			if (request.promise)
+			{
+				if (error)
+				{
+					request.promise->set_exception(error);
+				}
+				else
+				{
+					request.promise->set_value(output);
+				}
+			}
+			if (request.callback)
+			{
+				request.callback(output);
+			}
+		}
 	}
 
 	//////////////////////////////////////////////////////////////////////////
@@ -254,8 +703,8 @@ namespace EasyCNN
 		logVerbose("NetWork setInputSize begin.");
 		easyAssert(size.number > 0 && size.channels > 0 && size.width > 0 && size.height > 0, "parameter invalidate.");
 		easyAssert(dataBuckets.empty(), "dataBuckets must be empty now!");		
-		dataBuckets.push_back(std::make_shared<DataBucket>(size));
-		diffBuckets.push_back(std::make_shared<DataBucket>(size));
+		const SchedulerScope schedulerScope(scheduler.get());
+		dataBuckets.push_back(std::make_shared<DataBucket>(size, memoryPool));
 		logVerbose("NetWork setInputSize end.");
 	}
 	void NetWork::setLossFunctor(std::shared_ptr<LossFunctor> lossFunctor)
@@ -278,31 +727,305 @@ namespace EasyCNN
 	{
 		const auto layer_type = layer->getLayerType();
 		logVerbose("NetWork addayer begin , type : %s", layer_type.c_str());
+		if (memoryPlanned)
+		{
+			releaseMemoryPlan();
+		}
 		layers.push_back(layer);
 
 		easyAssert(dataBuckets.size() >= 1, "bucket count is less than 1.");
 		const std::shared_ptr<DataBucket> prev = dataBuckets[dataBuckets.size() - 1];
 		easyAssert(prev.get() != nullptr, "previous bucket is null.");
 		const DataSize inputSize = prev->getSize();
+		const SchedulerScope schedulerScope(scheduler.get());
 		layer->setPhase(phase);
+		layer->setMemoryPool(memoryPool);
 		layer->setInputBucketSize(inputSize);
 		layer->solveInnerParams();
 		const DataSize outputSize = layer->getOutputBucketSize();
 		//dataBucket setting params
-		dataBuckets.push_back(std::make_shared<DataBucket>(outputSize));
-		diffBuckets.push_back(std::make_shared<DataBucket>(outputSize));
+		//diff buckets are created by first backward
+		if (isInplaceLayer(layers.size() - 1, Phase::Train))
+		{
+			dataBuckets.push_back(dataBuckets[dataBuckets.size() - 1]);
+		}
+		else
+		{
+			dataBuckets.push_back(std::make_shared<DataBucket>(outputSize, memoryPool));
+			dataBuckets[dataBuckets.size() - 1]->reserve(reservedBatch*outputSize._3DSize());
+		}
+		layer->reserve(reservedBatch);
+		reserve_workspace(layer->getWorkspaceSize());
 		logVerbose("NetWork addayer end. add data bucket done.");
 	}
 	float NetWork::trainBatch(const std::shared_ptr<DataBucket> inputDataBucket,
 		const std::shared_ptr<DataBucket> labelDataBucket)
 	{
+		easyAssert(!inferenceOnly, "network is inference only.");
+		const std::lock_guard<std::mutex> runLock(async->runMutex);
 		setPhase(Phase::Train);
 		logVerbose("NetWork trainBatch begin.");
-		forward(inputDataBucket);
+		forward(inputDataBucket, nullptr);
 		const float loss = backward(labelDataBucket);
 		logVerbose("NetWork trainBatch end.");
 		return loss;
 	}
+	//output of layer may overwrite its input : layer is element-wise, in train phase
+	//the layer before doesn't read its output (which is our input) in backward,
+	//and the input is not caller's memory.
+	bool NetWork::isInplaceLayer(const size_t layerIdx, const Phase phase) const
+	{
+		if (!layers[layerIdx]->supportInplace())
+		{
+			return false;
+		}
+		if (phase == Phase::Train && layerIdx > 0 && layers[layerIdx - 1]->needOutputForBackward())
+		{
+			return false;
+		}
+		//never write to caller's input bucket, which is shared by the inplace layers at the beginning
+		if (layerIdx > 0)
+		{
+			bool readCallerInput = true;
+			for (size_t i = 0; i < layerIdx; i++)
+			{
+				if (!layers[i]->supportInplace())
+				{
+					readCallerInput = false;
+					break;
+				}
+			}
+			if (readCallerInput)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+	//activation i is written by layer i-1 and read by layer i, the last one is returned to caller.
+	//in test phase only two of them are alive at the same time, so all activations share one slab.
+	//activations of inplace layer are one tensor, input(and its inplace aliases) is caller's memory.
+	//slab is planned for the reserved batch, so smaller batches only reshape the views.
+	void NetWork::planMemory(const size_t number)
+	{
+		logVerbose("NetWork planMemory begin.");
+		easyAssert(phase == Phase::Test, "memory plan is for test phase only.");
+		const size_t capacityNumber = std::max(number, reservedBatch);
+		const SchedulerScope schedulerScope(scheduler.get());
+		if (!layoutPlanned)
+		{
+			planLayout();
+		}
+		const int lastStep = (int)layers.size();
+		std::vector<DataSize> sizes(dataBuckets.size());
+		std::vector<size_t> tensorIds(dataBuckets.size());
+		std::vector<int> firstUses, lastUses;
+		std::vector<size_t> bytes;
+		//input is caller's bucket, not in slab
+		const size_t callerInput = (size_t)-1;
+		for (size_t i = 0; i < dataBuckets.size(); i++)
+		{
+			if (i == 0)
+			{
+				sizes[i] = dataBuckets[i]->getSize();
+				sizes[i].number = capacityNumber;
+			}
+			else
+			{
+				sizes[i] = getActivationSize(i, capacityNumber);
+			}
+			const int firstUse = (i == 0) ? 0 : (int)i - 1;
+			const int lastUse = (i == dataBuckets.size() - 1) ? lastStep : (int)i;
+			if (i == 0)
+			{
+				tensorIds[i] = callerInput;
+			}
+			else if (isInplaceLayer(i - 1, Phase::Test))
+			{
+				tensorIds[i] = tensorIds[i - 1];
+				if (tensorIds[i] != callerInput)
+				{
+					lastUses[tensorIds[i]] = lastUse;
+				}
+			}
+			else
+			{
+				tensorIds[i] = bytes.size();
+				bytes.push_back(sizeof(float)*sizes[i].totalSize());
+				firstUses.push_back(firstUse);
+				lastUses.push_back(lastUse);
+			}
+		}
+		MemoryPlanner planner;
+		for (size_t i = 0; i < bytes.size(); i++)
+		{
+			planner.addTensor(bytes[i], firstUses[i], lastUses[i]);
+		}
+		const size_t slabSize = planner.solve();
+		activationSlab.reset();
+		activationSlab = make_pooled_buffer(memoryPool, slabSize / sizeof(float));
+		first_touch(activationSlab.get(), slabSize / sizeof(float));
+		for (size_t i = 1; i < dataBuckets.size(); i++)
+		{
+			if (tensorIds[i] == tensorIds[i - 1])
+			{
+				dataBuckets[i] = dataBuckets[i - 1];
+				continue;
+			}
+			const size_t offset = planner.getOffset(tensorIds[i]) / sizeof(float);
+			//view shares ownership of slab
+			const std::shared_ptr<float> view(activationSlab, activationSlab.get() + offset);
+			dataBuckets[i] = std::make_shared<DataBucket>(sizes[i], view);
+			dataBuckets[i]->setLayout(getActivationLayout(i));
+			DataSize size = sizes[i];
+			size.number = number;
+			dataBuckets[i]->reshape(size);
+		}
+		//no backward in test phase
+		diffBuckets.clear();
+		plannedBatch = capacityNumber;
+		memoryPlanned = true;
+		logVerbose("NetWork planMemory end. slab : %d bytes, without plan : %d bytes.",
+			(int)slabSize, (int)planner.getNaiveSize());
+	}
+	void NetWork::releaseMemoryPlan()
+	{
+		logVerbose("NetWork releaseMemoryPlan begin.");
+		const size_t number = dataBuckets[dataBuckets.size() - 1]->getSize().number;
+		if (layoutPlanned)
+		{
+			releaseLayout();
+		}
+		for (size_t i = 1; i < dataBuckets.size(); i++)
+		{
+			if (isInplaceLayer(i - 1, Phase::Train))
+			{
+				dataBuckets[i] = dataBuckets[i - 1];
+			}
+			else
+			{
+				dataBuckets[i] = std::make_shared<DataBucket>(getActivationSize(i, number), memoryPool);
+				dataBuckets[i]->reserve(reservedBatch*dataBuckets[i]->getSize()._3DSize());
+			}
+		}
+		activationSlab.reset();
+		memoryPlanned = false;
+		logVerbose("NetWork releaseMemoryPlan end.");
+	}
+	DataSize NetWork::getActivationSize(const size_t i, const size_t number) const
+	{
+		DataSize size = layers[i - 1]->getOutputBucketSize();
+		size.number = number;
+		return layers[i - 1]->isBlockedLayout() ? blocked_size(size) : size;
+	}
+	Layout NetWork::getActivationLayout(const size_t i) const
+	{
+		return layers[i == 0 ? 0 : i - 1]->isNHWCLayout() ? Layout::NHWC : Layout::NCHW;
+	}
+	//NHWC input stays NHWC through layers from input which work on it, then runs of layers which work on blocked layout
+	//around one which prefers it at least(element-wise ones inside of run only). conversion from NHWC is inserted after
+	//the first run, to blocked layout before every other run and back to NCHW after it.
+	void NetWork::planLayout()
+	{
+		logVerbose("NetWork planLayout begin.");
+		std::vector<bool> nhwc(layers.size(), false);
+		size_t nhwcStop = 0;
+		if (inputLayout == Layout::NHWC)
+		{
+			//input layer passes caller's bucket
+			nhwc[0] = true;
+			for (nhwcStop = 1; nhwcLayoutEnabled && nhwcStop < layers.size() &&
+				(layers[nhwcStop]->supportNHWCLayout() || layers[nhwcStop]->supportInplace()); nhwcStop++)
+			{
+				nhwc[nhwcStop] = true;
+			}
+		}
+		std::vector<bool> blocked(layers.size(), false);
+		auto supportBlocked = [this](const size_t i){ return layers[i]->supportBlockedLayout() || layers[i]->supportInplace(); };
+		//input layer is caller's bucket
+		for (size_t i = std::max<size_t>(1, nhwcStop); blockedLayoutEnabled && i < layers.size();)
+		{
+			if (!supportBlocked(i))
+			{
+				i++;
+				continue;
+			}
+			size_t first = i;
+			size_t last = i;
+			bool preferred = false;
+			for (; last < layers.size() && supportBlocked(last); last++)
+			{
+				preferred = preferred || layers[last]->preferBlockedLayout();
+			}
+			i = last;
+			while (first < last && !layers[first]->supportBlockedLayout())
+			{
+				first++;
+			}
+			while (last > first && !layers[last - 1]->supportBlockedLayout())
+			{
+				last--;
+			}
+			if (preferred)
+			{
+				std::fill(blocked.begin() + first, blocked.begin() + last, true);
+			}
+		}
+		auto createLayoutLayer = [this](const LayoutLayer::Direction direction, const DataSize size){
+			std::shared_ptr<Layer> layer = std::make_shared<LayoutLayer>(direction);
+			layer->setPhase(phase);
+			layer->setMemoryPool(memoryPool);
+			layer->setInputBucketSize(size);
+			layer->solveInnerParams();
+			return layer;
+		};
+		std::vector<std::shared_ptr<Layer>> plannedLayers;
+		for (size_t i = 0; i < layers.size(); i++)
+		{
+			if (i > 0 && nhwc[i - 1] && !nhwc[i])
+			{
+				plannedLayers.push_back(createLayoutLayer(LayoutLayer::FromNHWC, layers[i]->getInputBucketSize()));
+			}
+			if (blocked[i] && !blocked[i - 1])
+			{
+				plannedLayers.push_back(createLayoutLayer(LayoutLayer::ToBlocked, layers[i]->getInputBucketSize()));
+			}
+			layers[i]->setBlockedLayout(blocked[i]);
+			layers[i]->setNHWCLayout(nhwc[i]);
+			reserve_workspace(layers[i]->getWorkspaceSize());
+			plannedLayers.push_back(layers[i]);
+			if (blocked[i] && (i + 1 == layers.size() || !blocked[i + 1]))
+			{
+				plannedLayers.push_back(createLayoutLayer(LayoutLayer::FromBlocked, layers[i]->getOutputBucketSize()));
+			}
+		}
+		layers.swap(plannedLayers);
+		//activations are planned next, input stays
+		dataBuckets.resize(layers.size() + 1);
+		std::fill(dataBuckets.begin() + 1, dataBuckets.end(), nullptr);
+		layoutPlanned = true;
+		logVerbose("NetWork planLayout end. %d conversions of layout.", (int)(layers.size() - plannedLayers.size()));
+	}
+	void NetWork::releaseLayout()
+	{
+		logVerbose("NetWork releaseLayout begin.");
+		std::vector<std::shared_ptr<Layer>> addedLayers;
+		for (const auto& layer : layers)
+		{
+			if (layer->getLayerType() == LayoutLayer::layerType)
+			{
+				continue;
+			}
+			layer->setBlockedLayout(false);
+			layer->setNHWCLayout(false);
+			addedLayers.push_back(layer);
+		}
+		layers.swap(addedLayers);
+		//buckets are made by caller
+		dataBuckets.resize(layers.size() + 1);
+		layoutPlanned = false;
+		logVerbose("NetWork releaseLayout end.");
+	}
 	bool NetWork::saveModel(const std::string& modelFile)
 	{
 		std::ofstream ofs(modelFile);
@@ -313,6 +1036,11 @@ namespace EasyCNN
 		//layers' param
 		for (const auto& layer : layers)
 		{
+			//conversions of layout are planned again when model is loaded
+			if (layer->getLayerType() == LayoutLayer::layerType)
+			{
+				continue;
+			}
 			ofs << encrypt(layer->serializeToString()) + "\n";
 		}
 		return true;
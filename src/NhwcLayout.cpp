@@ -0,0 +1,263 @@
+#include <algorithm>
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/Workspace.h"
+#include "EasyCNN/EasyAssert.h"
+
+namespace EasyCNN
+{
+	//a tile of source rows and columns is transposed while both sides of it are in cache
+	static const size_t TRANSPOSE_TILE = 16;
+	//output pixels of one gemm at least(whole rows), so its shape never depends on how rows are split over threads
+	static const size_t NHWC_GEMM_PIXELS = 64;
+
+	//dst(cols,rows) = src(rows,cols)^T
+	static void transpose(const float* src, const size_t rows, const size_t cols, float* dst)
+	{
+		for (size_t r0 = 0; r0 < rows; r0 += TRANSPOSE_TILE)
+		{
+			const size_t rStop = std::min(rows, r0 + TRANSPOSE_TILE);
+			for (size_t c0 = 0; c0 < cols; c0 += TRANSPOSE_TILE)
+			{
+				const size_t cStop = std::min(cols, c0 + TRANSPOSE_TILE);
+				for (size_t c = c0; c < cStop; c++)
+				{
+					for (size_t r = r0; r < rStop; r++)
+					{
+						dst[c*rows + r] = src[r*cols + c];
+					}
+				}
+			}
+		}
+	}
+	void nchw_to_nhwc(const TensorView& input, const TensorView& output)
+	{
+		const DataSize size = input.getSize();
+		easyAssert(output.getSize() == size, "size of input and output must be equal.");
+		easyAssert(input.isSampleDense(Layout::NCHW) && output.isSampleDense(Layout::NHWC), "every sample must be dense in its layout.");
+		for (size_t nn = 0; nn < size.number; nn++)
+		{
+			transpose(input.getSampleData(nn), size.channels, size._2DSize(), output.getSampleData(nn));
+		}
+	}
+	void nhwc_to_nchw(const TensorView& input, const TensorView& output)
+	{
+		const DataSize size = input.getSize();
+		easyAssert(output.getSize() == size, "size of input and output must be equal.");
+		easyAssert(input.isSampleDense(Layout::NHWC) && output.isSampleDense(Layout::NCHW), "every sample must be dense in its layout.");
+		for (size_t nn = 0; nn < size.number; nn++)
+		{
+			transpose(input.getSampleData(nn), size._2DSize(), size.channels, output.getSampleData(nn));
+		}
+	}
+
+	//one sample of convolution2d on NHWC tensors, same mode keeps size and doesn't use steps(as convolution2d_same)
+	struct NhwcConvolutionShape
+	{
+		NhwcConvolutionShape(const DataSize& inputSize, const DataSize& kernelSize, const DataSize& outputSize,
+			const size_t kws, const size_t khs, const int mode)
+		{
+			ic = inputSize.channels;
+			ih = inputSize.height;
+			iw = inputSize.width;
+			oc = kernelSize.number;
+			kh = kernelSize.height;
+			kw = kernelSize.width;
+			oh = outputSize.height;
+			ow = outputSize.width;
+			const bool same = (mode == 1);
+			ws = same ? 1 : kws;
+			hs = same ? 1 : khs;
+			padTop = same ? kh / 2 : 0;
+			padLeft = same ? kw / 2 : 0;
+			//1x1 kernel of step 1 : input pixels are rows of gemm already
+			pointwise = (kh == 1 && kw == 1 && ws == 1 && hs == 1);
+		}
+		//k of gemm
+		size_t depth() const
+		{
+			return kh*kw*ic;
+		}
+		//m of gemm for output rows
+		size_t pixels(const size_t rows) const
+		{
+			return rows*ow;
+		}
+		//floats of scratch after sgemm's packing
+		size_t scratchFloats(const size_t rows) const
+		{
+			return pointwise ? 0 : pixels(rows)*depth();
+		}
+		size_t workspaceBytes(const size_t rows) const
+		{
+			return sgemm_workspace_size(pixels(rows), oc, depth()) + scratchFloats(rows)*sizeof(float);
+		}
+		size_t ic, ih, iw, oc, kh, kw, oh, ow;
+		size_t ws, hs, padTop, padLeft;
+		bool pointwise;
+	};
+
+	//pixels(rows*ow,kh*kw*ic) of output rows [rowStart,rowStop), padding is 0.
+	//taps of a kernel row inside of input are one copy, channels of a pixel are next to each other.
+	static void im2row(const NhwcConvolutionShape& shape, const float* input, const size_t rowStart, const size_t rowStop, float* pixels)
+	{
+		const size_t tapRow = shape.kw*shape.ic;
+		float* dst = pixels;
+		for (size_t oy = rowStart; oy < rowStop; oy++)
+		{
+			for (size_t ox = 0; ox < shape.ow; ox++)
+			{
+				const int ixStart = (int)(ox*shape.ws) - (int)shape.padLeft;
+				const bool inside = ixStart >= 0 && ixStart + shape.kw <= shape.iw;
+				for (size_t y = 0; y < shape.kh; y++, dst += tapRow)
+				{
+					const int iy = (int)(oy*shape.hs + y) - (int)shape.padTop;
+					if (iy < 0 || iy >= (int)shape.ih)
+					{
+						std::fill(dst, dst + tapRow, 0.0f);
+						continue;
+					}
+					const float* src = input + (iy*shape.iw)*shape.ic;
+					if (inside)
+					{
+						std::copy(src + ixStart*shape.ic, src + ixStart*shape.ic + tapRow, dst);
+						continue;
+					}
+					for (size_t x = 0; x < shape.kw; x++)
+					{
+						const int ix = ixStart + (int)x;
+						float* tap = dst + x*shape.ic;
+						if (ix < 0 || ix >= (int)shape.iw)
+						{
+							std::fill(tap, tap + shape.ic, 0.0f);
+						}
+						else
+						{
+							std::copy(src + ix*shape.ic, src + (ix + 1)*shape.ic, tap);
+						}
+					}
+				}
+			}
+		}
+	}
+	void convolution2d_nhwc(const TensorView& input, const TensorView& kernel, const float* bias, const TensorView& output,
+		const size_t kws, const size_t khs, const int mode, const size_t rowStart, const size_t rowStop)
+	{
+		easyAssert(input.getSize().number == output.getSize().number, "number of input and output must be equal.");
+		easyAssert(input.getSize().channels == kernel.getSize().channels && output.getSize().channels == kernel.getSize().number,
+			"channels of kernel is invalidate.");
+		const size_t outputHeight = output.getSize().height;
+		const size_t blockRows = convolution2d_nhwc_block_rows(output.getSize());
+		easyAssert(rowStart <= rowStop && rowStop <= outputHeight, "rows are out of output.");
+		easyAssert(input.isSampleDense(Layout::NHWC) && kernel.isSampleDense(Layout::NHWC) && output.isSampleDense(Layout::NHWC),
+			"every sample must be dense NHWC.");
+		if (rowStart == rowStop)
+		{
+			return;
+		}
+		easyAssert(rowStart % blockRows == 0 && (rowStop % blockRows == 0 || rowStop == outputHeight), "rows are not on blocks.");
+		const NhwcConvolutionShape shape(input.getSize(), kernel.getSize(), output.getSize(), kws, khs, mode);
+		const size_t maxRows = std::min(blockRows, outputHeight);
+		const size_t gemmBytes = sgemm_workspace_size(shape.pixels(maxRows), shape.oc, shape.depth());
+		//taken once at full size, sgemm finds it big enough and doesn't move it
+		float* const scratch = get_workspace(shape.workspaceBytes(maxRows)) + gemmBytes / sizeof(float);
+		const float* kernelData = kernel.getData();
+		for (size_t nn = 0; nn < input.getSize().number; nn++)
+		{
+			const float* inputData = input.getSampleData(nn);
+			for (size_t blockStart = rowStart; blockStart < rowStop; blockStart += blockRows)
+			{
+				const size_t blockStop = std::min(rowStop, blockStart + blockRows);
+				const size_t pixels = shape.pixels(blockStop - blockStart);
+				float* outputData = output.getSampleData(nn) + blockStart*shape.ow*shape.oc;
+				if (shape.pointwise)
+				{
+					sgemm(false, true, pixels, shape.oc, shape.ic, 1.0f, inputData + blockStart*shape.iw*shape.ic, shape.ic,
+						kernelData, kernel.numberStride, 0.0f, outputData, shape.oc);
+				}
+				else
+				{
+					im2row(shape, inputData, blockStart, blockStop, scratch);
+					sgemm(false, true, pixels, shape.oc, shape.depth(), 1.0f, scratch, shape.depth(),
+						kernelData, kernel.numberStride, 0.0f, outputData, shape.oc);
+				}
+				if (bias)
+				{
+					for (size_t p = 0; p < pixels; p++)
+					{
+						float* dst = outputData + p*shape.oc;
+						for (size_t o = 0; o < shape.oc; o++)
+						{
+							dst[o] += bias[o];
+						}
+					}
+				}
+			}
+		}
+	}
+	size_t convolution2d_nhwc_block_rows(const DataSize& outputSize)
+	{
+		return std::max<size_t>(1, (NHWC_GEMM_PIXELS + outputSize.width - 1) / outputSize.width);
+	}
+	size_t convolution2d_nhwc_workspace_size(const DataSize& inputSize, const DataSize& kernelSize, const DataSize& outputSize,
+		const size_t kws, const size_t khs, const int mode)
+	{
+		//one block of rows at a time
+		const NhwcConvolutionShape shape(inputSize, kernelSize, outputSize, kws, khs, mode);
+		return shape.workspaceBytes(std::min(convolution2d_nhwc_block_rows(outputSize), outputSize.height));
+	}
+
+	void pooling2d_nhwc(const TensorView& input, const TensorView& output, const int type,
+		const size_t kw, const size_t kh, const size_t ws, const size_t hs, const size_t rowStart, const size_t rowStop)
+	{
+		const DataSize inputSize = input.getSize();
+		const DataSize outputSize = output.getSize();
+		easyAssert(inputSize.number == outputSize.number && inputSize.channels == outputSize.channels, "size of input and output must be matched.");
+		easyAssert(rowStart <= rowStop && rowStop <= outputSize.height, "rows are out of output.");
+		easyAssert(input.isSampleDense(Layout::NHWC) && output.isSampleDense(Layout::NHWC), "every sample must be dense NHWC.");
+		const size_t channels = inputSize.channels;
+		//as PoolingLayer : window starts at ox*ws and is clipped, max starts from 0, mean divides by whole window
+		const float area = (float)(kw*kh);
+		for (size_t nn = 0; nn < inputSize.number; nn++)
+		{
+			const float* src = input.getSampleData(nn);
+			for (size_t oy = rowStart; oy < rowStop; oy++)
+			{
+				float* dst = output.getSampleData(nn) + oy*outputSize.width*channels;
+				const size_t yStop = std::min(oy*hs + kh, inputSize.height);
+				for (size_t ox = 0; ox < outputSize.width; ox++, dst += channels)
+				{
+					const size_t xStop = std::min(ox*ws + kw, inputSize.width);
+					std::fill(dst, dst + channels, 0.0f);
+					for (size_t iy = oy*hs; iy < yStop; iy++)
+					{
+						for (size_t ix = ox*ws; ix < xStop; ix++)
+						{
+							const float* pixel = src + (iy*inputSize.width + ix)*channels;
+							if (type == 0)
+							{
+								for (size_t c = 0; c < channels; c++)
+								{
+									dst[c] = std::max(dst[c], pixel[c]);
+								}
+							}
+							else
+							{
+								for (size_t c = 0; c < channels; c++)
+								{
+									dst[c] += pixel[c];
+								}
+							}
+						}
+					}
+					if (type != 0)
+					{
+						for (size_t c = 0; c < channels; c++)
+						{
+							dst[c] /= area;
+						}
+					}
+				}
+			}
+		}
+	}
+}//namespace
@@ -31,9 +31,16 @@ namespace EasyCNN
 		}
 		for (size_t i = 0; i < params.size(); i++)
 		{
-			if (prevM[i].get() == nullptr || prevM[i]->getSize() != params[i]->getSize())
+			if (prevM[i].get() == nullptr)
 			{
-				prevM[i].reset(new DataBucket(params[i]->getSize()));
+				//momentum lives beside its param
+				const auto pool = params[i]->getMemoryPool();
+				prevM[i] = std::make_shared<DataBucket>(params[i]->getSize(), pool ? pool : MemoryPool::defaultPool());
+				prevM[i]->fillData(0.0f);
+			}
+			else if (prevM[i]->getSize() != params[i]->getSize())
+			{
+				prevM[i]->reshape(params[i]->getSize());
 				prevM[i]->fillData(0.0f);
 			}
 			easyAssert(params[i]->getSize() == gradients[i]->getSize(), "size of param[i] and size of gradient[i] must be equals.");
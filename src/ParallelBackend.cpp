@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include "EasyCNN/ParallelBackend.h"
+#include "EasyCNN/EasyAssert.h"
+#include "EasyCNN/Workspace.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace EasyCNN
+{
+	static std::atomic<ParallelBackend> currentBackend(ParallelBackend::Native);
+	static ParallelExecutor customExecutor;
+	static size_t customThreads = 1;
+
+	//threads of foreign backends are not ours : scratch is prepared before every range
+	struct ForeignRange
+	{
+		TaskFunc func;
+		void* context;
+	};
+	static void runForeignRange(void* context, const size_t start, const size_t stop)
+	{
+		const ForeignRange* range = static_cast<const ForeignRange*>(context);
+		prepare_workspace();
+		range->func(range->context, start, stop);
+	}
+
+	bool is_parallel_backend_available(const ParallelBackend backend)
+	{
+		switch (backend)
+		{
+		case ParallelBackend::OpenMP:
+#ifdef _OPENMP
+			return true;
+#else
+			return false;
+#endif
+		case ParallelBackend::Custom:
+			return static_cast<bool>(customExecutor);
+		default:
+			return true;
+		}
+	}
+	bool set_parallel_backend(const ParallelBackend backend)
+	{
+		if (!is_parallel_backend_available(backend))
+		{
+			return false;
+		}
+		currentBackend = backend;
+		return true;
+	}
+	ParallelBackend get_parallel_backend()
+	{
+		return currentBackend.load();
+	}
+	void set_parallel_executor(ParallelExecutor executor, const size_t threads)
+	{
+		easyAssert(executor && threads > 0, "executor can't be empty and threads must be larger than 0.");
+		customExecutor = executor;
+		customThreads = threads;
+		currentBackend = ParallelBackend::Custom;
+	}
+	size_t get_parallel_threads()
+	{
+		switch (currentBackend.load(std::memory_order_relaxed))
+		{
+		case ParallelBackend::OpenMP:
+#ifdef _OPENMP
+			return (size_t)omp_get_max_threads();
+#else
+			return 1;
+#endif
+		case ParallelBackend::Serial:
+			return 1;
+		case ParallelBackend::Custom:
+			return customThreads;
+		default:
+			return TaskScheduler::current().size();
+		}
+	}
+	void parallel_run(const size_t begin, const size_t end, const size_t grain, TaskFunc func, void* context)
+	{
+		if (end <= begin)
+		{
+			return;
+		}
+		switch (currentBackend.load(std::memory_order_relaxed))
+		{
+		case ParallelBackend::OpenMP:
+		{
+#ifdef _OPENMP
+			//index of omp for is int on msvc
+			const size_t count = end - begin;
+			const size_t realGrain = std::max<size_t>(std::max<size_t>(grain, 1), count / INT_MAX + 1);
+			const int grains = (int)((count + realGrain - 1) / realGrain);
+			if (grains <= 1 || omp_in_parallel())
+			{
+				func(context, begin, end);
+				return;
+			}
+			const ForeignRange range = { func, context };
+			#pragma omp parallel for schedule(static)
+			for (int i = 0; i < grains; i++)
+			{
+				const size_t start = begin + (size_t)i*realGrain;
+				runForeignRange(const_cast<ForeignRange*>(&range), start, std::min(end, start + realGrain));
+			}
+#else
+			func(context, begin, end);
+#endif
+			break;
+		}
+		case ParallelBackend::Serial:
+			func(context, begin, end);
+			break;
+		case ParallelBackend::Custom:
+		{
+			ForeignRange range = { func, context };
+			customExecutor(begin, end, std::max<size_t>(grain, 1), &runForeignRange, &range);
+			break;
+		}
+		default:
+			TaskScheduler::current().parallel_for(begin, end, grain, func, context);
+			break;
+		}
+	}
+	void parallel_run_graph(TaskGraph& graph)
+	{
+		if (currentBackend.load(std::memory_order_relaxed) == ParallelBackend::Native)
+		{
+			TaskScheduler::current().run(graph);
+		}
+		else
+		{
+			graph.runSerially();
+		}
+	}
+}//namespace
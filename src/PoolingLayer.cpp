@@ -1,6 +1,8 @@
 #include <algorithm>
 #include <sstream>
 #include "EasyCNN/PoolingLayer.h"
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/ThreadPool.h"
 
 #if WITH_OPENCV_DEBUG
 #include "opencv2/opencv.hpp"
@@ -95,16 +97,33 @@ namespace EasyCNN
 
 		if (getPhase() == Phase::Train && poolingType == PoolingType::MaxPooling)
 		{
-			maxIdxes.reset(new ParamBucket(ParamSize(outputSize.number, outputSize.channels, outputSize.height, outputSize.width)));
+			maxIdxes.reset(new ParamBucket(ParamSize(outputSize.number, outputSize.channels, outputSize.height, outputSize.width), getMemoryPool()));
 		}
 	}
-	void PoolingLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void PoolingLayer::reserve(const size_t maxBatch)
 	{
-		const DataSize prevDataSize = prev->getSize();
-		const DataSize nextDataSize = next->getSize();
+		if (maxIdxes)
+		{
+			maxIdxes->reserve(maxBatch*maxIdxes->getSize()._3DSize());
+		}
+	}
+	void PoolingLayer::releaseTrainingState()
+	{
+		Layer::releaseTrainingState();
+		maxIdxes.reset();
+	}
+	LayerCost PoolingLayer::getForwardCost(const size_t number) const
+	{
+		const double outputs = (double)number*outputSize._3DSize();
+		return LayerCost(outputs*poolingKernelSize._2DSize(), sizeof(float)*number*(inputSize._3DSize() + outputSize._3DSize()));
+	}
+	void PoolingLayer::forward(const TensorView& prev, const TensorView& next)
+	{
+		const DataSize prevDataSize = prev.getSize();
+		const DataSize nextDataSize = next.getSize();
 
-		const float* prevData = prev->getData().get();
-		float* nextData = next->getData().get();
+		const float* prevData = prev.getData();
+		float* nextData = next.getData();
 		float* maxIdxesData = nullptr;
 		if (getPhase() == Phase::Train && poolingType == PoolingType::MaxPooling)
 		{
@@ -112,69 +131,92 @@ namespace EasyCNN
 			if (newSize.number != prevDataSize.number)
 			{
 				newSize.number = prevDataSize.number;
-				maxIdxes.reset(new ParamBucket(newSize));
+				maxIdxes->reshape(newSize);
 			}
 			maxIdxesData = maxIdxes->getData().get();
 		}
-		for (size_t nn = 0; nn < nextDataSize.number; nn++)
-		{
-			for (size_t nc = 0; nc < nextDataSize.channels; nc++)
+		//split over samples, channels and rows, so batch 1 still uses every thread
+		auto worker = [&](const size_t nn, const size_t nc, const size_t rowStart, const size_t rowStop){
+			for (size_t nh = rowStart; nh < rowStop; nh++)
 			{
-				for (size_t nh = 0; nh < nextDataSize.height; nh++)
+				for (size_t nw = 0; nw < nextDataSize.width; nw++)
 				{
-					for (size_t nw = 0; nw < nextDataSize.width; nw++)
+					const size_t inStartX = nw*widthStep;
+					const size_t inStartY = nh*heightStep;
+					const size_t nextDataIdx = next.getIndex(nn, nc, nh, nw);
+					const size_t maxIdxesIdx = nextDataSize.getIndex(nn, nc, nh, nw);
+					float result = 0;
+					size_t maxIdx = 0;
+					if (poolingType == PoolingType::MaxPooling)
 					{
-						const size_t inStartX = nw*widthStep;
-						const size_t inStartY = nh*heightStep;
-						const size_t nextDataIdx = nextDataSize.getIndex(nn, nc, nh, nw);
-						float result = 0;
-						size_t maxIdx = 0;
-						if (poolingType == PoolingType::MaxPooling)
+						for (size_t ph = 0; ph < poolingKernelSize.height; ph++)
 						{
-							for (size_t ph = 0; ph < poolingKernelSize.height; ph++)
+							for (size_t pw = 0; pw < poolingKernelSize.width; pw++)
 							{
-								for (size_t pw = 0; pw < poolingKernelSize.width; pw++)
+								const size_t inY = inStartY + ph;
+								const size_t inX = inStartX + pw;
+								if (inY >= 0 && inY<inputSize.height && inX >= 0 && inX<inputSize.width)
 								{
-									const size_t inY = inStartY + ph;
-									const size_t inX = inStartX + pw;
-									if (inY >= 0 && inY<inputSize.height && inX >= 0 && inX<inputSize.width)
+									const size_t prevDataIdx = prev.getIndex(nn, nc, inY, inX);
+									if (result < prevData[prevDataIdx])
 									{
-										const size_t prevDataIdx = prevDataSize.getIndex(nn, nc, inY, inX);
-										if (result < prevData[prevDataIdx])
-										{
-											result = prevData[prevDataIdx];
-											maxIdx = ph*poolingKernelSize.width + pw;
-										}
-									}									
-								}
-							}
-							if (maxIdxes)
-							{
-								maxIdxesData[nextDataIdx] = (float)maxIdx;
+										result = prevData[prevDataIdx];
+										maxIdx = ph*poolingKernelSize.width + pw;
+									}
+								}									
 							}
 						}
-						else if (poolingType == PoolingType::MeanPooling)
+						if (maxIdxesData)
 						{
-							for (size_t ph = 0; ph < poolingKernelSize.height; ph++)
+							maxIdxesData[maxIdxesIdx] = (float)maxIdx;
+						}
+					}
+					else if (poolingType == PoolingType::MeanPooling)
+					{
+						for (size_t ph = 0; ph < poolingKernelSize.height; ph++)
+						{
+							for (size_t pw = 0; pw < poolingKernelSize.width; pw++)
 							{
-								for (size_t pw = 0; pw < poolingKernelSize.width; pw++)
+								const size_t inY = inStartY + ph;
+								const size_t inX = inStartX + pw;
+								if (inY >= 0 && inY < inputSize.height && inX >= 0 && inX < inputSize.width)
 								{
-									const size_t inY = inStartY + ph;
-									const size_t inX = inStartX + pw;
-									if (inY >= 0 && inY < inputSize.height && inX >= 0 && inX < inputSize.width)
-									{
-										const size_t prevDataIdx = prevDataSize.getIndex(nc, inY, inX);
-										result += prevData[prevDataIdx];
-									}
+									const size_t prevDataIdx = prev.getIndex(nn, nc, inY, inX);
+									result += prevData[prevDataIdx];
 								}
 							}
-							result /= poolingKernelSize.width*poolingKernelSize.height;
 						}
-						nextData[nextDataIdx] = result;
-					}//ow
-				}//oh
-			}//oc
-		}//on
+						result /= poolingKernelSize.width*poolingKernelSize.height;
+					}
+					nextData[nextDataIdx] = result;
+				}//ow
+			}//oh
+		};
+		if (isBlockedLayout())
+		{
+			//split over samples, channel blocks and rows, a block is pooled as vectors
+			auto blockedWorker = [&](const size_t nn, const size_t nb, const size_t rowStart, const size_t rowStop){
+				pooling2d_blocked(prev.slice(nn, 1).sliceChannels(nb, 1), next.slice(nn, 1).sliceChannels(nb, 1), (int)poolingType,
+					poolingKernelSize.width, poolingKernelSize.height, widthStep, heightStep, rowStart, rowStop);
+			};
+			parallel_for_3d(nextDataSize.number, nextDataSize.channels, nextDataSize.height,
+				get_parallel_grain({ nextDataSize.number, nextDataSize.channels, nextDataSize.height }, getForwardCost(nextDataSize.number)), blockedWorker);
+		}
+		else if (isNHWCLayout())
+		{
+			//split over samples and rows, channels of a pixel are pooled as vectors
+			auto nhwcWorker = [&](const size_t nn, const size_t rowStart, const size_t rowStop){
+				pooling2d_nhwc(prev.slice(nn, 1), next.slice(nn, 1), (int)poolingType,
+					poolingKernelSize.width, poolingKernelSize.height, widthStep, heightStep, rowStart, rowStop);
+			};
+			parallel_for_2d(nextDataSize.number, nextDataSize.height,
+				get_parallel_grain({ nextDataSize.number, nextDataSize.height }, getForwardCost(nextDataSize.number)), nhwcWorker);
+		}
+		else
+		{
+			parallel_for_3d(nextDataSize.number, nextDataSize.channels, nextDataSize.height,
+				get_parallel_grain({ nextDataSize.number, nextDataSize.channels, nextDataSize.height }, getForwardCost(nextDataSize.number)), worker);
+		}
 
 #if WITH_OPENCV_DEBUG
 		//input image
@@ -215,14 +257,13 @@ namespace EasyCNN
 		cv::destroyAllWindows();
 #endif //WITH_OPENCV_DEBUG
 	}
-	void PoolingLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void PoolingLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 
 		//update prevDiff
@@ -232,16 +273,16 @@ namespace EasyCNN
 			easyAssert(maxIdxes->getSize()._3DSize() == nextSize._3DSize(), "idx size must equals with next data.");
 			maxIdxesData = maxIdxes->getData().get();
 		}
-		prevDiff->fillData(0.0f);
+		//prevDiff is cleared by network(accumulate mode)
 		//calculate current inner diff 
 		//none
 		//pass next layer's diff to previous layer
-		for (size_t nn = 0; nn < nextSize.number; nn++)
-		{
-			const float* nextDiffData = nextDiff->getData().get() + nn*nextDiffSize._3DSize();
-			float* prevDiffData = prevDiff->getData().get() + nn*prevDiffSize._3DSize();
+		//split over samples and channels, windows of neighbour rows may overlap in prevDiff
+		auto worker = [&](const size_t nn, const size_t channelStart, const size_t channelStop){
+			const float* nextDiffData = nextDiff.getSampleData(nn);
+			float* prevDiffData = prevDiff.getSampleData(nn);
 
-			for (size_t nc = 0; nc < nextSize.channels; nc++)
+			for (size_t nc = channelStart; nc < channelStop; nc++)
 			{
 				for (size_t nh = 0; nh < nextSize.height; nh++)
 				{
@@ -249,7 +290,8 @@ namespace EasyCNN
 					{
 						const size_t inStartX = nw*widthStep;
 						const size_t inStartY = nh*heightStep;
-						const size_t nextDataIdx = nextSize.getIndex(nc, nh, nw);
+						const size_t nextDataIdx = nextDiff.getIndex(nc, nh, nw);
+						const size_t maxIdxesIdx = nextSize.getIndex(nc, nh, nw);
 						if (poolingType == PoolingType::MaxPooling)
 						{
 							for (size_t ph = 0; ph < poolingKernelSize.height; ph++)
@@ -260,8 +302,8 @@ namespace EasyCNN
 									const size_t inX = inStartX + pw;
 									if (inY >= 0 && inY < inputSize.height && inX >= 0 && inX < inputSize.width)
 									{
-										const size_t prevDiffIdx = prevSize.getIndex(nc, inY, inX);
-										if (ph*poolingKernelSize.width + pw == maxIdxesData[nextDataIdx])
+										const size_t prevDiffIdx = prevDiff.getIndex(nc, inY, inX);
+										if (ph*poolingKernelSize.width + pw == maxIdxesData[maxIdxesIdx])
 										{
 											prevDiffData[prevDiffIdx] += nextDiffData[nextDataIdx];
 										}
@@ -280,7 +322,7 @@ namespace EasyCNN
 									const size_t inX = inStartX + pw;
 									if (inY >= 0 && inY < inputSize.height && inX >= 0 && inX < inputSize.width)
 									{
-										const size_t prevDiffIdx = prevSize.getIndex(nc, inY, inX);
+										const size_t prevDiffIdx = prevDiff.getIndex(nc, inY, inX);
 										prevDiffData[prevDiffIdx] += meanDiff;
 									}
 								}
@@ -289,7 +331,9 @@ namespace EasyCNN
 					}
 				}
 			}
-		}
+		};
+		parallel_for_2d(nextSize.number, nextSize.channels,
+			get_parallel_grain({ nextSize.number, nextSize.channels }, getBackwardCost(nextSize.number)), worker);
 
 		//update this layer's param
 		//nop
@@ -19,15 +19,15 @@ namespace EasyCNN
 	{
 		return layerType;
 	}
-	void SoftmaxLayer::forward(const std::shared_ptr<DataBucket> prev, std::shared_ptr<DataBucket> next)
+	void SoftmaxLayer::forward(const TensorView& prev, const TensorView& next)
 	{
-		const DataSize prevDataSize = prev->getSize();
-		const DataSize nextDataSize = next->getSize();
+		const DataSize prevDataSize = prev.getSize();
+		const DataSize nextDataSize = next.getSize();
 
 		for (size_t nn = 0; nn < nextDataSize.number; nn++)
 		{
-			const float* prevData = prev->getData().get() + nn*prevDataSize._3DSize();
-			float* nextData = next->getData().get() + nn*nextDataSize._3DSize();
+			const float* prevData = prev.getSampleData(nn);
+			float* nextData = next.getSampleData(nn);
 
 			//step1 : find max value
 			float maxVal = prevData[0];
@@ -49,40 +49,40 @@ namespace EasyCNN
 			}
 		}
 	}
-	void SoftmaxLayer::backward(std::shared_ptr<DataBucket> prev, const std::shared_ptr<DataBucket> next,
-		std::shared_ptr<DataBucket>& prevDiff, const std::shared_ptr<DataBucket>& nextDiff)
+	void SoftmaxLayer::backward(const TensorView& prev, const TensorView& next,
+		const TensorView& prevDiff, const TensorView& nextDiff)
 	{
 		easyAssert(getPhase() == Phase::Train, "backward only in train phase.")
-		const DataSize prevSize = prev->getSize();
-		const DataSize nextSize = next->getSize();
-		const DataSize prevDiffSize = prevDiff->getSize();
-		const DataSize nextDiffSize = nextDiff->getSize();
+		const DataSize prevSize = prev.getSize();
+		const DataSize nextSize = next.getSize();
+		const DataSize prevDiffSize = prevDiff.getSize();
+		const DataSize nextDiffSize = nextDiff.getSize();
 		easyAssert(prevSize == nextSize, "data size must be equal!");
 		easyAssert(nextDiffSize == nextSize, "next data's and diff's size must be equal! ");
 		easyAssert(prevDiffSize == prevSize, "size of prevDiff and size of prev must be equals");
 		easyAssert(prevDiffSize == nextDiffSize, "diff size must be equal!");
 		
-		//update prevDiff	
-		prevDiff->fillData(0.0f);
+		//update prevDiff, every element is overwritten
 		for (size_t pn = 0; pn < prevSize.number; pn++)
 		{
-			const float* prevData = prev->getData().get() + pn*prevSize._3DSize();
-			const float* nextData = next->getData().get() + pn*nextSize._3DSize();
-			const float* nextDiffData = nextDiff->getData().get() + pn*nextDiffSize._3DSize();
-			float* prevDiffData = prevDiff->getData().get() + pn*prevDiffSize._3DSize();
+			const float* nextData = next.getSampleData(pn);
+			const float* nextDiffData = nextDiff.getSampleData(pn);
+			float* prevDiffData = prevDiff.getSampleData(pn);
 			for (size_t prevDiffIdx = 0; prevDiffIdx < prevDiffSize._3DSize(); prevDiffIdx++)
 			{
+				float sum = 0.0f;
 				for (size_t nextDiffIdx = 0; nextDiffIdx < nextDiffSize._3DSize(); nextDiffIdx++)
 				{
 					if (nextDiffIdx == prevDiffIdx)
 					{
-						prevDiffData[prevDiffIdx] += nextData[prevDiffIdx] * (1.0f - nextData[prevDiffIdx]) * nextDiffData[nextDiffIdx];
+						sum += nextData[prevDiffIdx] * (1.0f - nextData[prevDiffIdx]) * nextDiffData[nextDiffIdx];
 					}
 					else
 					{
-						prevDiffData[prevDiffIdx] -= nextData[prevDiffIdx] * nextData[nextDiffIdx] * nextDiffData[nextDiffIdx];
+						sum -= nextData[prevDiffIdx] * nextData[nextDiffIdx] * nextDiffData[nextDiffIdx];
 					}
 				}
+				prevDiffData[prevDiffIdx] = sum;
 			}
 		}
 
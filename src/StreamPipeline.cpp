@@ -0,0 +1,384 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "EasyCNN/StreamPipeline.h"
+#include "EasyCNN/NetWork.h"
+#include "EasyCNN/LayoutLayer.h"
+#include "EasyCNN/EasyAssert.h"
+#include "EasyCNN/EasyLogger.h"
+#include "EasyCNN/CostModel.h"
+#include "EasyCNN/CpuTopology.h"
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/Workspace.h"
+
+namespace EasyCNN
+{
+	static const size_t NO_BOUNDARY = (size_t)-1;
+
+	//queues hold every frame, so only a slower neighbour makes a stage wait.
+	//yield a while(next frame is usually close), then sleep and leave the cores to others.
+	static void wait_backoff(const size_t rounds)
+	{
+		if (rounds < 1024)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+	template<typename T>
+	static void wait_push(BoundedQueue<T>& queue, const T& item)
+	{
+		for (size_t rounds = 0; !queue.tryPush(item); rounds++)
+		{
+			wait_backoff(rounds);
+		}
+	}
+	template<typename T>
+	static void wait_pop(BoundedQueue<T>& queue, T& item)
+	{
+		for (size_t rounds = 0; !queue.tryPop(item); rounds++)
+		{
+			wait_backoff(rounds);
+		}
+	}
+	//contiguous parts whose biggest cost is least, layer count of every part
+	static std::vector<size_t> split_by_cost(const std::vector<double>& costs, const size_t parts)
+	{
+		const size_t count = costs.size();
+		const size_t realParts = std::min(parts, count);
+		std::vector<double> prefix(count + 1, 0.0);
+		for (size_t i = 0; i < count; i++)
+		{
+			prefix[i + 1] = prefix[i] + costs[i];
+		}
+		//best[p][i] : biggest part of first i layers in p parts, from[p][i] : where last part begins
+		const double infinite = std::numeric_limits<double>::max();
+		std::vector<std::vector<double>> best(realParts + 1, std::vector<double>(count + 1, infinite));
+		std::vector<std::vector<size_t>> from(realParts + 1, std::vector<size_t>(count + 1, 0));
+		best[0][0] = 0.0;
+		for (size_t p = 1; p <= realParts; p++)
+		{
+			for (size_t i = p; i <= count; i++)
+			{
+				for (size_t j = p - 1; j < i; j++)
+				{
+					const double biggest = std::max(best[p - 1][j], prefix[i] - prefix[j]);
+					if (biggest < best[p][i])
+					{
+						best[p][i] = biggest;
+						from[p][i] = j;
+					}
+				}
+			}
+		}
+		std::vector<size_t> layers(realParts);
+		size_t end = count;
+		for (size_t p = realParts; p > 0; p--)
+		{
+			layers[p - 1] = end - from[p][end];
+			end = from[p][end];
+		}
+		return layers;
+	}
+
+	//layer counts of stages in layers network runs : a conversion of layout(finalized network) goes
+	//with the layer it converts for, that is the one after it(to blocked, from NHWC) or before it(from blocked)
+	static std::vector<size_t> count_planned_layers(const std::vector<std::shared_ptr<Layer>>& layers, const std::vector<size_t>& stageLayers)
+	{
+		auto isLayout = [&](const size_t i){
+			return dynamic_cast<const LayoutLayer*>(layers[i].get()) != nullptr;
+		};
+		auto isFromBlocked = [&](const size_t i){
+			const LayoutLayer* layout = dynamic_cast<const LayoutLayer*>(layers[i].get());
+			return layout != nullptr && layout->getDirection() == LayoutLayer::FromBlocked;
+		};
+		std::vector<size_t> plannedLayers;
+		size_t end = 0;
+		for (const size_t count : stageLayers)
+		{
+			easyAssert(count > 0, "stage has no layer.");
+			const size_t begin = end;
+			size_t added = 0;
+			for (; added < count && end < layers.size(); end++)
+			{
+				if (!isLayout(end))
+				{
+					added++;
+				}
+			}
+			easyAssert(added == count, "layers of stages must be all layers of network.");
+			while (end < layers.size() && isFromBlocked(end))
+			{
+				end++;
+			}
+			plannedLayers.push_back(end - begin);
+		}
+		//layers left over fail the check of build
+		return plannedLayers;
+	}
+
+	StreamPipeline::StreamPipeline(NetWork& network, const size_t microBatch, const size_t stageCount,
+		const size_t threadsPerStage, const size_t frameCount)
+		:network(network), microBatch(microBatch)
+	{
+		easyAssert(stageCount > 0 && microBatch > 0, "parameter invalidate.");
+		std::vector<double> costs;
+		for (const auto& layer : network.layers)
+		{
+			costs.push_back(get_serial_nanoseconds(layer->getForwardCost(microBatch)));
+		}
+		build(split_by_cost(costs, stageCount), threadsPerStage, frameCount);
+	}
+	StreamPipeline::StreamPipeline(NetWork& network, const size_t microBatch, const std::vector<size_t>& stageLayers,
+		const size_t threadsPerStage, const size_t frameCount)
+		:network(network), microBatch(microBatch)
+	{
+		easyAssert(!stageLayers.empty(), "parameter invalidate.");
+		build(count_planned_layers(network.layers, stageLayers), threadsPerStage, frameCount);
+	}
+	StreamPipeline::~StreamPipeline()
+	{
+		close();
+		for (const auto& stage : stages)
+		{
+			stage->thread.join();
+		}
+	}
+	void StreamPipeline::build(const std::vector<size_t>& stageLayers, const size_t threadsPerStage, const size_t frameCount)
+	{
+		logVerbose("StreamPipeline build begin.");
+		const auto& layers = network.layers;
+		const auto& dataBuckets = network.dataBuckets;
+		easyAssert(layers.size() > 1, "layer count is less than 2.");
+		easyAssert(microBatch > 0 && frameCount > 0 && !stageLayers.empty(), "parameter invalidate.");
+		std::vector<size_t> cuts(1, 0);
+		for (const size_t count : stageLayers)
+		{
+			easyAssert(count > 0, "stage has no layer.");
+			cuts.push_back(cuts.back() + count);
+		}
+		easyAssert(cuts.back() == layers.size(), "layers of stages must be all layers of network.");
+		network.setPhase(Phase::Test);
+
+		//activations which are one tensor in test phase(inplace layers)
+		std::vector<size_t> tensorIds(dataBuckets.size());
+		for (size_t i = 0; i < dataBuckets.size(); i++)
+		{
+			tensorIds[i] = (i > 0 && network.isInplaceLayer(i - 1, Phase::Test)) ? tensorIds[i - 1] : i;
+		}
+		auto sizeOf = [&](const size_t idx) -> DataSize {
+			DataSize size = dataBuckets[idx]->getSize();
+			size.number = microBatch;
+			return size;
+		};
+
+		//core groups : stage s on cpus [s*threads,(s+1)*threads), node after node.
+		//no pinning when there are not enough cpus.
+		std::vector<size_t> cpus;
+		for (size_t node = 0; node < get_numa_node_count(); node++)
+		{
+			const auto& nodeCpus = get_numa_node_cpus(node);
+			cpus.insert(cpus.end(), nodeCpus.begin(), nodeCpus.end());
+		}
+		const size_t stageCount = stageLayers.size();
+		const size_t threads = threadsPerStage > 0 ? threadsPerStage : std::max<size_t>(cpus.size() / stageCount, 1);
+		const bool pinned = stageCount*threads <= cpus.size();
+
+		for (size_t s = 0; s < stageCount; s++)
+		{
+			std::unique_ptr<Stage> stage(new Stage());
+			stage->firstLayer = cuts[s];
+			stage->lastLayer = cuts[s + 1];
+			stage->scheduler = std::make_shared<TaskScheduler>(threads);
+			if (pinned)
+			{
+				stage->cpus.assign(cpus.begin() + s*threads, cpus.begin() + (s + 1)*threads);
+				//first cpu is stage thread's
+				if (threads > 1)
+				{
+					stage->scheduler->setAffinity(std::vector<size_t>(stage->cpus.begin() + 1, stage->cpus.end()));
+				}
+			}
+			//activations inside stage are first touched by its threads
+			const SchedulerScope schedulerScope(stage->scheduler.get());
+			for (size_t k = stage->firstLayer; k <= stage->lastLayer; k++)
+			{
+				std::shared_ptr<DataBucket> bucket;
+				size_t boundary = NO_BOUNDARY;
+				if (tensorIds[k] == tensorIds[stage->firstLayer])
+				{
+					boundary = s;
+				}
+				else if (tensorIds[k] == tensorIds[stage->lastLayer])
+				{
+					boundary = s + 1;
+				}
+				else if (tensorIds[k] == tensorIds[k - 1])
+				{
+					bucket = stage->buckets.back();
+				}
+				else
+				{
+					bucket = std::make_shared<DataBucket>(sizeOf(k), network.memoryPool);
+					bucket->setLayout(network.getActivationLayout(k));
+				}
+				stage->buckets.push_back(bucket);
+				stage->boundaryOf.push_back(boundary);
+			}
+			stage->input.reset(new BoundedQueue<Frame*>(frameCount + 1));
+			stages.push_back(std::move(stage));
+		}
+
+		//frames plus end of stream fit in every queue
+		output.reset(new BoundedQueue<Frame*>(frameCount + 1));
+		freeFrames.reset(new BoundedQueue<Frame*>(frameCount));
+		for (size_t f = 0; f < frameCount; f++)
+		{
+			std::unique_ptr<Frame> frame(new Frame());
+			for (size_t j = 0; j < cuts.size(); j++)
+			{
+				if (j > 0 && tensorIds[cuts[j]] == tensorIds[cuts[j - 1]])
+				{
+					frame->boundaries.push_back(frame->boundaries.back());
+				}
+				else
+				{
+					frame->boundaries.push_back(std::make_shared<DataBucket>(sizeOf(cuts[j]), network.memoryPool));
+					frame->boundaries.back()->setLayout(network.getActivationLayout(cuts[j]));
+				}
+			}
+			freeFrames->tryPush(frame.get());
+			frames.push_back(std::move(frame));
+		}
+		for (size_t s = 0; s < stageCount; s++)
+		{
+			stages[s]->thread = std::thread(&StreamPipeline::stageLoop, this, s);
+		}
+		logVerbose("StreamPipeline build end. stages : %d, threads of stage : %d.", (int)stageCount, (int)threads);
+	}
+	void StreamPipeline::stageLoop(const size_t stageIdx)
+	{
+		Stage& stage = *stages[stageIdx];
+		if (!stage.cpus.empty())
+		{
+			pin_current_thread(stage.cpus[0]);
+		}
+		prepare_workspace();
+		const SchedulerScope schedulerScope(stage.scheduler.get());
+		BoundedQueue<Frame*>& next = (stageIdx + 1 < stages.size()) ? *stages[stageIdx + 1]->input : *output;
+		while (true)
+		{
+			Frame* frame = nullptr;
+			wait_pop(*stage.input, frame);
+			//end of stream is passed on too
+			if (frame)
+			{
+				runStage(stage, *frame);
+			}
+			wait_push(next, frame);
+			if (!frame)
+			{
+				break;
+			}
+		}
+	}
+	void StreamPipeline::runStage(Stage& stage, Frame& frame)
+	{
+		const size_t number = frame.boundaries[0]->getSize().number;
+		auto bucketOf = [&](const size_t k) -> DataBucket& {
+			const size_t idx = k - stage.firstLayer;
+			return stage.boundaryOf[idx] == NO_BOUNDARY ? *stage.buckets[idx] : *frame.boundaries[stage.boundaryOf[idx]];
+		};
+		for (const auto& bucket : stage.buckets)
+		{
+			if (bucket && bucket->getSize().number != number)
+			{
+				DataSize size = bucket->getSize();
+				size.number = number;
+				bucket->reshape(size);
+			}
+		}
+		for (size_t i = stage.firstLayer; i < stage.lastLayer; i++)
+		{
+			const auto& layer = network.layers[i];
+			DataBucket& prev = bucketOf(i);
+			DataBucket& next = bucketOf(i + 1);
+			//clear only when layer accumulates to output, inplace layer always overwrites
+			if (layer->getOutputWriteMode() == WriteMode::Accumulate && &next != &prev)
+			{
+				next.fillData(0.0f);
+			}
+			layer->forward(prev.getView(), next.getView());
+		}
+	}
+	void StreamPipeline::push(const std::shared_ptr<DataBucket> input)
+	{
+		easyAssert(!closed, "pipeline is closed.");
+		const DataSize inputSize = input->getSize();
+		DataSize expectSize = network.dataBuckets[0]->getSize();
+		expectSize.number = inputSize.number;
+		easyAssert(inputSize == expectSize && inputSize.number > 0 && inputSize.number <= microBatch, "input size is invalidate.");
+		easyAssert(input->getLayout() == network.getActivationLayout(0), "layout of input must be the one network is planned for.");
+		Frame* frame = nullptr;
+		wait_pop(*freeFrames, frame);
+		for (const auto& boundary : frame->boundaries)
+		{
+			DataSize size = boundary->getSize();
+			size.number = inputSize.number;
+			boundary->reshape(size);
+		}
+		copy(input->getView(), frame->boundaries[0]->getView());
+		wait_push(*stages[0]->input, frame);
+	}
+	bool StreamPipeline::pop(std::shared_ptr<DataBucket>& result)
+	{
+		if (finished)
+		{
+			return false;
+		}
+		Frame* frame = nullptr;
+		wait_pop(*output, frame);
+		if (!frame)
+		{
+			finished = true;
+			return false;
+		}
+		const auto& last = frame->boundaries.back();
+		if (result)
+		{
+			result->reshape(last->getSize());
+		}
+		else
+		{
+			result = std::make_shared<DataBucket>(last->getSize());
+		}
+		result->setLayout(network.getActivationLayout(network.layers.size()));
+		copy(last->getView(), result->getView());
+		wait_push(*freeFrames, frame);
+		return true;
+	}
+	void StreamPipeline::close()
+	{
+		if (!closed)
+		{
+			closed = true;
+			wait_push(*stages[0]->input, (Frame*)nullptr);
+		}
+	}
+	size_t StreamPipeline::getStageCount() const
+	{
+		return stages.size();
+	}
+	std::vector<size_t> StreamPipeline::getStageLayers() const
+	{
+		std::vector<size_t> result;
+		for (const auto& stage : stages)
+		{
+			result.push_back(stage->lastLayer - stage->firstLayer);
+		}
+		return result;
+	}
+}//namespace
@@ -0,0 +1,760 @@
+#include <algorithm>
+#include <chrono>
+#include "EasyCNN/TaskScheduler.h"
+#include "EasyCNN/EasyAssert.h"
+#include "EasyCNN/Workspace.h"
+#include "EasyCNN/CpuTopology.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EASYCNN_CPU_RELAX() _mm_pause()
+#else
+#define EASYCNN_CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace EasyCNN
+{
+	//deque owned by current thread
+	static thread_local TaskScheduler* currentScheduler = nullptr;
+	static thread_local size_t currentSlot = 0;
+	//scheduler bound by SchedulerScope
+	static thread_local TaskScheduler* boundScheduler = nullptr;
+
+	//////////////////////////////////////////////////////////////////////////
+	//WorkDeque
+	//a thief may read a slot the owner is rewriting only after top moved on, then its cas fails and the copy is dropped.
+	void WorkDeque::storeTask(const int64_t index, const Task& task)
+	{
+		TaskSlot& slot = tasks[index % CAPACITY];
+		slot.func.store(task.func, std::memory_order_relaxed);
+		slot.context.store(task.context, std::memory_order_relaxed);
+		slot.start.store(task.start, std::memory_order_relaxed);
+		slot.stop.store(task.stop, std::memory_order_relaxed);
+		slot.grain.store(task.grain, std::memory_order_relaxed);
+		slot.group.store(task.group, std::memory_order_relaxed);
+	}
+	void WorkDeque::loadTask(const int64_t index, Task& task) const
+	{
+		const TaskSlot& slot = tasks[index % CAPACITY];
+		task.func = slot.func.load(std::memory_order_relaxed);
+		task.context = slot.context.load(std::memory_order_relaxed);
+		task.start = slot.start.load(std::memory_order_relaxed);
+		task.stop = slot.stop.load(std::memory_order_relaxed);
+		task.grain = slot.grain.load(std::memory_order_relaxed);
+		task.group = slot.group.load(std::memory_order_relaxed);
+	}
+	bool WorkDeque::push(const Task& task)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed);
+		const int64_t t = top.load(std::memory_order_acquire);
+		if (b - t >= CAPACITY)
+		{
+			return false;
+		}
+		storeTask(b, task);
+		bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+	bool WorkDeque::pop(Task& task)
+	{
+		const int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t t = top.load(std::memory_order_relaxed);
+		if (t > b)
+		{
+			//empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+		loadTask(b, task);
+		if (t == b)
+		{
+			//last one, race with thieves
+			const bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+	bool WorkDeque::steal(Task& task)
+	{
+		int64_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+		{
+			return false;
+		}
+		loadTask(t, task);
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//TaskScheduler
+	TaskScheduler& TaskScheduler::instance()
+	{
+		static TaskScheduler inst(2);
+		return inst;
+	}
+	TaskScheduler& TaskScheduler::current()
+	{
+		if (boundScheduler)
+		{
+			return *boundScheduler;
+		}
+		if (currentScheduler)
+		{
+			return *currentScheduler;
+		}
+		return instance();
+	}
+	TaskScheduler::TaskScheduler(const size_t threads)
+	{
+		deques.reset(new std::atomic<WorkDeque*>[EXTERNAL_SLOTS + MAX_THREADS]);
+		for (size_t i = 0; i < EXTERNAL_SLOTS + MAX_THREADS; i++)
+		{
+			deques[i] = (i < EXTERNAL_SLOTS ? new WorkDeque() : nullptr);
+		}
+		dequeCount = EXTERNAL_SLOTS;
+		externalBusy.reset(new std::atomic<bool>[EXTERNAL_SLOTS]);
+		for (size_t i = 0; i < EXTERNAL_SLOTS; i++)
+		{
+			externalBusy[i] = false;
+		}
+		slotNodes.reset(new std::atomic<size_t>[EXTERNAL_SLOTS + MAX_THREADS]);
+		for (size_t i = 0; i < EXTERNAL_SLOTS + MAX_THREADS; i++)
+		{
+			slotNodes[i] = 0;
+		}
+		for (size_t i = 0; i < MAX_NUMA_NODES; i++)
+		{
+			nodeThreads[i] = 0;
+		}
+		resize(threads);
+	}
+	TaskScheduler::~TaskScheduler()
+	{
+		shutdown();
+		for (size_t i = 0; i < EXTERNAL_SLOTS + MAX_THREADS; i++)
+		{
+			delete deques[i].load();
+		}
+	}
+	size_t TaskScheduler::size() const
+	{
+		//caller is a thread too
+		return activeWorkers.load() + 1;
+	}
+	void TaskScheduler::resize(const size_t threads)
+	{
+		easyAssert(threads > 0 && threads <= MAX_THREADS, "number of thread must be in [1,256]");
+		easyAssert(currentScheduler != this, "can't resize scheduler from its own task");
+		std::lock_guard<std::mutex> resizeLock(resizeMutex);
+		const size_t workerCount = threads - 1;
+		const size_t cores = std::thread::hardware_concurrency();
+		oversubscribed = (cores > 0 && threads > cores);
+		if (workerCount > workers.size())
+		{
+			//deques of new workers must be visible to thieves before anything is pushed
+			for (size_t i = workers.size(); i < workerCount; i++)
+			{
+				if (!deques[EXTERNAL_SLOTS + i].load())
+				{
+					deques[EXTERNAL_SLOTS + i] = new WorkDeque();
+				}
+			}
+			dequeCount = std::max(dequeCount.load(), EXTERNAL_SLOTS + workerCount);
+			activeWorkers = workerCount;
+			for (size_t i = workers.size(); i < workerCount; i++)
+			{
+				workers.emplace_back([this, i]{ workerLoop(i); });
+			}
+		}
+		else if (workerCount < workers.size())
+		{
+			//retired workers leave once their deques are empty, others never stop
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex);
+				activeWorkers = workerCount;
+			}
+			sleepCondition.notify_all();
+			for (size_t i = workerCount; i < workers.size(); i++)
+			{
+				workers[i].join();
+			}
+			workers.resize(workerCount);
+		}
+		updateNodes();
+	}
+	void TaskScheduler::shutdown()
+	{
+		std::lock_guard<std::mutex> resizeLock(resizeMutex);
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stop = true;
+		}
+		sleepCondition.notify_all();
+		for (std::thread& worker : workers)
+		{
+			if (worker.joinable())
+			{
+				worker.join();
+			}
+		}
+		workers.clear();
+		activeWorkers = 0;
+	}
+	bool TaskScheduler::retired(const size_t worker) const
+	{
+		return stop.load() || worker >= activeWorkers.load();
+	}
+	void TaskScheduler::workerLoop(const size_t worker)
+	{
+		const size_t slot = EXTERNAL_SLOTS + worker;
+		currentScheduler = this;
+		currentSlot = slot;
+		size_t pinnedVersion = 0;
+		for (;;)
+		{
+			//move before touching any data
+			const size_t version = affinityVersion.load();
+			if (version != pinnedVersion)
+			{
+				applyAffinity(worker);
+				pinnedVersion = version;
+			}
+			const size_t seen = epoch.load();
+			Task task;
+			if (findTask(slot, task))
+			{
+				execute(slot, task);
+				continue;
+			}
+			//own deque is empty here and only its owner pushes, so nothing is left behind
+			if (retired(worker))
+			{
+				return;
+			}
+			//next layer usually forks within microseconds, waking from sleep costs much more
+			if (spinForWork(worker, seen))
+			{
+				continue;
+			}
+			//nothing pushed in spin time : sleep until something is pushed
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			sleepers++;
+			sleepCondition.wait(lock, [this, worker, seen]{ return retired(worker) || epoch.load() != seen; });
+			sleepers--;
+		}
+	}
+	bool TaskScheduler::spinForWork(const size_t worker, const size_t seenEpoch) const
+	{
+		const size_t microseconds = spinTime.load(std::memory_order_relaxed);
+		if (microseconds == 0 || oversubscribed)
+		{
+			return false;
+		}
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(microseconds);
+		for (size_t i = 1;; i++)
+		{
+			if (epoch.load(std::memory_order_relaxed) != seenEpoch || retired(worker))
+			{
+				return true;
+			}
+			EASYCNN_CPU_RELAX();
+			//clock is slower than a pause
+			if (i % 64 == 0 && std::chrono::steady_clock::now() >= deadline)
+			{
+				return false;
+			}
+		}
+	}
+	void TaskScheduler::setSpinTime(const size_t microseconds)
+	{
+		spinTime = microseconds;
+	}
+	size_t TaskScheduler::getSpinTime() const
+	{
+		return spinTime.load();
+	}
+	void TaskScheduler::setAffinity(const std::vector<size_t>& cpus)
+	{
+		std::lock_guard<std::mutex> resizeLock(resizeMutex);
+		{
+			std::lock_guard<std::mutex> lock(affinityMutex);
+			affinityCpus = cpus;
+		}
+		affinityVersion++;
+		updateNodes();
+	}
+	void TaskScheduler::setAffinity(const AffinityPolicy policy)
+	{
+		std::vector<size_t> cpus;
+		const size_t nodes = get_numa_node_count();
+		if (policy == AffinityPolicy::Compact)
+		{
+			for (size_t node = 0; node < nodes; node++)
+			{
+				const std::vector<size_t>& nodeCpus = get_numa_node_cpus(node);
+				cpus.insert(cpus.end(), nodeCpus.begin(), nodeCpus.end());
+			}
+		}
+		else if (policy == AffinityPolicy::Scatter)
+		{
+			for (size_t i = 0, added = 1; added > 0; i++)
+			{
+				added = 0;
+				for (size_t node = 0; node < nodes; node++)
+				{
+					const std::vector<size_t>& nodeCpus = get_numa_node_cpus(node);
+					if (i < nodeCpus.size())
+					{
+						cpus.push_back(nodeCpus[i]);
+						added++;
+					}
+				}
+			}
+		}
+		//caller usually runs on first cpu
+		if (cpus.size() > 1)
+		{
+			std::rotate(cpus.begin(), cpus.begin() + 1, cpus.end());
+		}
+		setAffinity(cpus);
+	}
+	std::vector<size_t> TaskScheduler::getAffinity() const
+	{
+		std::lock_guard<std::mutex> lock(affinityMutex);
+		return affinityCpus;
+	}
+	size_t TaskScheduler::getNodeCount() const
+	{
+		return nodeCount.load();
+	}
+	void TaskScheduler::applyAffinity(const size_t worker)
+	{
+		const std::vector<size_t> cpus = getAffinity();
+		if (cpus.empty())
+		{
+			unpin_current_thread();
+		}
+		else
+		{
+			pin_current_thread(cpus[worker % cpus.size()]);
+		}
+	}
+	//resizeMutex is held
+	void TaskScheduler::updateNodes()
+	{
+		const std::vector<size_t> cpus = getAffinity();
+		size_t threads[MAX_NUMA_NODES] = { 0 };
+		for (size_t i = 0; i < workers.size(); i++)
+		{
+			const size_t node = cpus.empty() ? 0 : std::min(get_numa_node_of_cpu(cpus[i % cpus.size()]), MAX_NUMA_NODES - 1);
+			slotNodes[EXTERNAL_SLOTS + i] = node;
+			threads[node]++;
+		}
+		size_t nodes = 0;
+		for (size_t node = 0; node < MAX_NUMA_NODES; node++)
+		{
+			nodeThreads[node] = threads[node];
+			nodes += (threads[node] > 0 ? 1 : 0);
+		}
+		nodeCount = std::max<size_t>(nodes, 1);
+	}
+	bool TaskScheduler::acquireSlot(size_t& slot)
+	{
+		for (size_t i = 0; i < EXTERNAL_SLOTS; i++)
+		{
+			bool expected = false;
+			if (externalBusy[i].compare_exchange_strong(expected, true))
+			{
+				slot = i;
+				if (nodeCount.load(std::memory_order_relaxed) > 1)
+				{
+					slotNodes[slot] = std::min(get_numa_node_of_cpu(get_current_cpu()), MAX_NUMA_NODES - 1);
+				}
+				return true;
+			}
+		}
+		return false;
+	}
+	void TaskScheduler::releaseSlot(const size_t slot)
+	{
+		externalBusy[slot] = false;
+	}
+	bool TaskScheduler::findTask(const size_t slot, Task& task)
+	{
+		if (deques[slot].load(std::memory_order_relaxed)->pop(task))
+		{
+			return true;
+		}
+		if (nodeCount.load(std::memory_order_relaxed) <= 1 && inboxTasks.load(std::memory_order_relaxed) == 0)
+		{
+			const size_t count = dequeCount.load(std::memory_order_acquire);
+			for (size_t i = 1; i < count; i++)
+			{
+				if (deques[(slot + i) % count].load(std::memory_order_acquire)->steal(task))
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+		//nearest work first : own node, then other nodes
+		const size_t node = slotNodes[slot].load(std::memory_order_relaxed);
+		if (takeInbox(node, task) || stealByNode(slot, node, true, task))
+		{
+			return true;
+		}
+		for (size_t i = 0; i < MAX_NUMA_NODES; i++)
+		{
+			if (i != node && takeInbox(i, task))
+			{
+				return true;
+			}
+		}
+		return stealByNode(slot, node, false, task);
+	}
+	bool TaskScheduler::takeInbox(const size_t node, Task& task)
+	{
+		if (inboxTasks.load(std::memory_order_relaxed) == 0)
+		{
+			return false;
+		}
+		NodeInbox& inbox = inboxes[node];
+		std::lock_guard<std::mutex> lock(inbox.mutex);
+		if (inbox.tasks.empty())
+		{
+			return false;
+		}
+		task = inbox.tasks.back();
+		inbox.tasks.pop_back();
+		inboxTasks--;
+		return true;
+	}
+	bool TaskScheduler::stealByNode(const size_t slot, const size_t node, const bool sameNode, Task& task)
+	{
+		const size_t count = dequeCount.load(std::memory_order_acquire);
+		for (size_t i = 1; i < count; i++)
+		{
+			const size_t victim = (slot + i) % count;
+			if ((slotNodes[victim].load(std::memory_order_relaxed) == node) != sameNode)
+			{
+				continue;
+			}
+			if (deques[victim].load(std::memory_order_acquire)->steal(task))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	//one part per node by its threads(caller counted on its node), caller keeps its own node's part.
+	//parts of other nodes wait in their inboxes for local workers.
+	void TaskScheduler::splitByNode(const size_t slot, Task& root)
+	{
+		const size_t callerNode = slotNodes[slot].load(std::memory_order_relaxed);
+		size_t weights[MAX_NUMA_NODES];
+		size_t total = 0;
+		for (size_t node = 0; node < MAX_NUMA_NODES; node++)
+		{
+			weights[node] = nodeThreads[node].load(std::memory_order_relaxed) + (node == callerNode ? 1 : 0);
+			total += weights[node];
+		}
+		const size_t grains = (root.stop - root.start + root.grain - 1) / root.grain;
+		if (grains < nodeCount.load(std::memory_order_relaxed))
+		{
+			return;
+		}
+		Task local = root;
+		local.stop = local.start;
+		size_t before = 0;
+		for (size_t node = 0; node < MAX_NUMA_NODES; node++)
+		{
+			if (weights[node] == 0)
+			{
+				continue;
+			}
+			const size_t firstGrain = before * grains / total;
+			before += weights[node];
+			const size_t lastGrain = before * grains / total;
+			Task part = root;
+			part.start = root.start + firstGrain * root.grain;
+			part.stop = std::min(root.stop, root.start + lastGrain * root.grain);
+			if (part.start >= part.stop)
+			{
+				continue;
+			}
+			if (node == callerNode)
+			{
+				local = part;
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(inboxes[node].mutex);
+			inboxes[node].tasks.push_back(part);
+			inboxTasks++;
+		}
+		epoch++;
+		if (sleepers.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sleepCondition.notify_all();
+		}
+		root = local;
+	}
+	void TaskScheduler::notifyWork()
+	{
+		epoch++;
+		if (sleepers.load() > 0)
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			sleepCondition.notify_one();
+		}
+	}
+	//keep first half of grains, publish the rest to be stolen, until one grain is left
+	void TaskScheduler::execute(const size_t slot, Task task)
+	{
+		while (task.stop - task.start > task.grain)
+		{
+			const size_t grains = (task.stop - task.start + task.grain - 1) / task.grain;
+			const size_t middle = task.start + grains / 2 * task.grain;
+			Task right = task;
+			right.start = middle;
+			if (!deques[slot].load(std::memory_order_relaxed)->push(right))
+			{
+				break;
+			}
+			notifyWork();
+			task.stop = middle;
+		}
+		//scratch grows out of kernels
+		prepare_workspace();
+		task.func(task.context, task.start, task.stop);
+		task.group->pending.fetch_sub(task.stop - task.start, std::memory_order_acq_rel);
+	}
+	bool TaskScheduler::enter(size_t& slot, TaskScheduler*& prevScheduler, size_t& prevSlot)
+	{
+		prevScheduler = currentScheduler;
+		prevSlot = currentSlot;
+		//worker(or caller already inside) uses its own deque
+		if (currentScheduler == this)
+		{
+			slot = currentSlot;
+			return true;
+		}
+		if (!acquireSlot(slot))
+		{
+			return false;
+		}
+		currentScheduler = this;
+		currentSlot = slot;
+		return true;
+	}
+	void TaskScheduler::leave(const size_t slot, TaskScheduler* prevScheduler, const size_t prevSlot)
+	{
+		if (prevScheduler != this)
+		{
+			releaseSlot(slot);
+			currentScheduler = prevScheduler;
+			currentSlot = prevSlot;
+		}
+	}
+	//help until every range of this group is done, stolen ranges finish soon so caller never sleeps
+	void TaskScheduler::waitGroup(const size_t slot, TaskGroup& group)
+	{
+		size_t idleRounds = 0;
+		while (group.pending.load(std::memory_order_acquire) != 0)
+		{
+			Task task;
+			if (findTask(slot, task))
+			{
+				execute(slot, task);
+				idleRounds = 0;
+			}
+			else if (oversubscribed || ++idleRounds % 64 == 0)
+			{
+				std::this_thread::yield();
+			}
+			else
+			{
+				EASYCNN_CPU_RELAX();
+			}
+		}
+	}
+	void TaskScheduler::parallel_for(const size_t begin, const size_t end, const size_t grain, TaskFunc func, void* context)
+	{
+		if (end <= begin)
+		{
+			return;
+		}
+		const size_t count = end - begin;
+		const size_t realGrain = std::max<size_t>(grain, 1);
+		if (activeWorkers.load(std::memory_order_relaxed) == 0 || count <= realGrain)
+		{
+			func(context, begin, end);
+			return;
+		}
+		size_t slot = 0;
+		TaskScheduler* prevScheduler = nullptr;
+		size_t prevSlot = 0;
+		if (!enter(slot, prevScheduler, prevSlot))
+		{
+			func(context, begin, end);
+			return;
+		}
+		TaskGroup group;
+		group.pending = count;
+		Task root;
+		root.func = func;
+		root.context = context;
+		root.start = begin;
+		root.stop = end;
+		root.grain = realGrain;
+		root.group = &group;
+		if (nodeCount.load(std::memory_order_relaxed) > 1)
+		{
+			splitByNode(slot, root);
+		}
+		if (root.start < root.stop)
+		{
+			execute(slot, root);
+		}
+		waitGroup(slot, group);
+		leave(slot, prevScheduler, prevSlot);
+	}
+	void TaskScheduler::run(TaskGraph& graph)
+	{
+		const size_t count = graph.size();
+		if (count == 0)
+		{
+			return;
+		}
+		size_t slot = 0;
+		TaskScheduler* prevScheduler = nullptr;
+		size_t prevSlot = 0;
+		if (activeWorkers.load(std::memory_order_relaxed) == 0 || !enter(slot, prevScheduler, prevSlot))
+		{
+			graph.runSerially();
+			return;
+		}
+		TaskGroup group;
+		group.pending = count;
+		graph.scheduler = this;
+		graph.group = &group;
+		for (const auto& node : graph.nodes)
+		{
+			node->remaining = node->dependencies;
+		}
+		//first root is popped first
+		for (size_t i = count; i > 0; i--)
+		{
+			if (graph.nodes[i - 1]->dependencies == 0)
+			{
+				pushGraphNode(graph, i - 1);
+			}
+		}
+		waitGroup(slot, group);
+		graph.scheduler = nullptr;
+		graph.group = nullptr;
+		leave(slot, prevScheduler, prevSlot);
+	}
+	//node as a range of one item, successors whose last dependency this is are pushed to the running thread
+	void TaskScheduler::runGraphNode(void* context, const size_t start, const size_t)
+	{
+		TaskGraph& graph = *static_cast<TaskGraph*>(context);
+		const TaskGraph::Node& node = *graph.nodes[start];
+		node.func();
+		for (const size_t successor : node.successors)
+		{
+			if (graph.nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				graph.scheduler->pushGraphNode(graph, successor);
+			}
+		}
+	}
+	void TaskScheduler::pushGraphNode(TaskGraph& graph, const size_t node)
+	{
+		Task task;
+		task.func = &runGraphNode;
+		task.context = &graph;
+		task.start = node;
+		task.stop = node + 1;
+		task.grain = 1;
+		task.group = graph.group;
+		if (!deques[currentSlot].load(std::memory_order_relaxed)->push(task))
+		{
+			execute(currentSlot, task);
+			return;
+		}
+		notifyWork();
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//TaskGraph
+	size_t TaskGraph::addNode(NodeFunc func)
+	{
+		nodes.emplace_back(new Node());
+		nodes.back()->func = func;
+		return nodes.size() - 1;
+	}
+	void TaskGraph::addEdge(const size_t before, const size_t after)
+	{
+		easyAssert(before < nodes.size() && after < nodes.size() && before != after, "edge of task graph is invalidate.");
+		nodes[before]->successors.push_back(after);
+		nodes[after]->dependencies++;
+	}
+	size_t TaskGraph::size() const
+	{
+		return nodes.size();
+	}
+	void TaskGraph::clear()
+	{
+		nodes.clear();
+	}
+	void TaskGraph::runSerially()
+	{
+		std::vector<size_t> remaining(nodes.size());
+		std::vector<size_t> ready;
+		for (size_t i = nodes.size(); i > 0; i--)
+		{
+			remaining[i - 1] = nodes[i - 1]->dependencies;
+			if (remaining[i - 1] == 0)
+			{
+				ready.push_back(i - 1);
+			}
+		}
+		size_t done = 0;
+		while (!ready.empty())
+		{
+			const size_t i = ready.back();
+			ready.pop_back();
+			nodes[i]->func();
+			done++;
+			for (const size_t successor : nodes[i]->successors)
+			{
+				if (--remaining[successor] == 0)
+				{
+					ready.push_back(successor);
+				}
+			}
+		}
+		easyAssert(done == nodes.size(), "task graph has a cycle.");
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//SchedulerScope
+	SchedulerScope::SchedulerScope(TaskScheduler* scheduler)
+		:prevScheduler(boundScheduler)
+	{
+		if (scheduler)
+		{
+			boundScheduler = scheduler;
+		}
+	}
+	SchedulerScope::~SchedulerScope()
+	{
+		boundScheduler = prevScheduler;
+	}
+}//namespace
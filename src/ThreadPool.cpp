@@ -1,6 +1,7 @@
 #include <algorithm>
 #include "EasyCNN/ThreadPool.h"
 #include "EasyCNN/EasyAssert.h"
+#include "EasyCNN/Workspace.h"
 
 namespace EasyCNN
 {
@@ -56,13 +57,14 @@ namespace EasyCNN
 					task = std::move(this->tasks.front());
 					this->tasks.pop();
 				}
-
+				//scratch grows out of kernels
+				prepare_workspace();
 				task();
 			}
 		}
 		);
 	}
-	inline size_t ThreadPool::size() const
+	size_t ThreadPool::size() const
 	{
 		return workers.size();
 	}
@@ -78,56 +80,38 @@ namespace EasyCNN
 	//APIs
 	size_t get_thread_num()
 	{
-		return ThreadPool::instance().size();
+		return TaskScheduler::instance().size();
 	}
 	size_t set_thread_num(const size_t num)
 	{
 		easyAssert(num > 0, "number of thread must be larger than 0");
 		if (num != get_thread_num())
 		{
-			ThreadPool::instance().resize(num);
+			TaskScheduler::instance().resize(num);
 		}
 		return get_thread_num();
 	}
+	void set_spin_time(const size_t microseconds)
+	{
+		TaskScheduler::instance().setSpinTime(microseconds);
+	}
 	void dispatch_worker(std::function<void(const size_t, const size_t)> func, const size_t number)
 	{
 		if (number <= 0)
 		{
 			return;
 		}
-		const size_t threads_of_pool = ThreadPool::instance().size();
-		if (threads_of_pool <= 1 || number <= 1)
-		{
-			func(0, number);
-		}
-		else
+		//one even share per thread, like 1/4 2/4 4/4 5/4
+		parallel_for(0, number, 0, func);
+	}
+	void first_touch(float* data, const size_t count)
+	{
+		if (get_parallel_backend() != ParallelBackend::Native || TaskScheduler::current().getNodeCount() <= 1)
 		{
-			easyAssert(threads_of_pool > 1, "thread must be larger than 1");
-			// 1/4 2/4 /4/4 5/4 => all ok!
-			const size_t payload_per_thread = number / threads_of_pool;
-			const size_t remainder_payload = number - payload_per_thread*threads_of_pool;
-			const size_t remainder_proc_last_idx = remainder_payload;
-
-			size_t start = 0;
-			std::vector<std::future<void>> futures;
-			for (size_t i = 0; i < threads_of_pool; i++)
-			{
-				size_t stop = start + payload_per_thread;
-				if (i < remainder_proc_last_idx)
-				{
-					stop = stop + 1;
-				}
-				futures.push_back(ThreadPool::instance().enqueue(func, start, stop));
-				start = stop;
-				if (stop >= number)
-				{
-					break;
-				}
-			}
-			for (size_t i = 0; i < futures.size(); i++)
-			{
-				futures[i].wait();
-			}
+			return;
 		}
+		parallel_for(0, count, get_parallel_grain({ count }, LayerCost(0.0, sizeof(float)*count)), [data](const size_t start, const size_t stop){
+			std::fill(data + start, data + stop, 0.0f);
+		});
 	}
 }//namespace
\ No newline at end of file
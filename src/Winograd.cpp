@@ -0,0 +1,288 @@
+#include <algorithm>
+#include "EasyCNN/MathFunctions.h"
+#include "EasyCNN/Workspace.h"
+#include "EasyCNN/EasyAssert.h"
+
+namespace EasyCNN
+{
+	//winograd F(m x m, 3x3) : y = A^T[(G g G^T) .* (B^T d B)]A on tiles of t = m+2 inputs.
+	//every 2d transform is its 1d transform on columns then on rows, x/xs is input, y/ys is output(with strides).
+	//F(2x2,3x3) : 16 multiplies for 4 outputs instead of 36
+	struct Winograd2x2
+	{
+		static const size_t M = 2;
+		static const size_t T = 4;
+		//B^T
+		static inline void input(const float* x, const size_t xs, float* y, const size_t ys)
+		{
+			const float d0 = x[0], d1 = x[xs], d2 = x[2 * xs], d3 = x[3 * xs];
+			y[0] = d0 - d2;
+			y[ys] = d1 + d2;
+			y[2 * ys] = d2 - d1;
+			y[3 * ys] = d1 - d3;
+		}
+		//G
+		static inline void kernel(const float* x, const size_t xs, float* y, const size_t ys)
+		{
+			const float g0 = x[0], g1 = x[xs], g2 = x[2 * xs];
+			y[0] = g0;
+			y[ys] = 0.5f*(g0 + g1 + g2);
+			y[2 * ys] = 0.5f*(g0 - g1 + g2);
+			y[3 * ys] = g2;
+		}
+		//A^T
+		static inline void output(const float* x, const size_t xs, float* y, const size_t ys)
+		{
+			const float m0 = x[0], m1 = x[xs], m2 = x[2 * xs], m3 = x[3 * xs];
+			y[0] = m0 + m1 + m2;
+			y[ys] = m1 - m2 - m3;
+		}
+	};
+	//F(4x4,3x3) : 36 multiplies for 16 outputs instead of 144, a little less accurate
+	struct Winograd4x4
+	{
+		static const size_t M = 4;
+		static const size_t T = 6;
+		static inline void input(const float* x, const size_t xs, float* y, const size_t ys)
+		{
+			const float d0 = x[0], d1 = x[xs], d2 = x[2 * xs], d3 = x[3 * xs], d4 = x[4 * xs], d5 = x[5 * xs];
+			y[0] = 4.0f*d0 - 5.0f*d2 + d4;
+			y[ys] = -4.0f*(d1 + d2) + d3 + d4;
+			y[2 * ys] = 4.0f*(d1 - d2) - d3 + d4;
+			y[3 * ys] = 2.0f*(d3 - d1) - d2 + d4;
+			y[4 * ys] = 2.0f*(d1 - d3) - d2 + d4;
+			y[5 * ys] = 4.0f*d1 - 5.0f*d3 + d5;
+		}
+		static inline void kernel(const float* x, const size_t xs, float* y, const size_t ys)
+		{
+			const float g0 = x[0], g1 = x[xs], g2 = x[2 * xs];
+			y[0] = g0 / 4.0f;
+			y[ys] = -(g0 + g1 + g2) / 6.0f;
+			y[2 * ys] = -(g0 - g1 + g2) / 6.0f;
+			y[3 * ys] = g0 / 24.0f + g1 / 12.0f + g2 / 6.0f;
+			y[4 * ys] = g0 / 24.0f - g1 / 12.0f + g2 / 6.0f;
+			y[5 * ys] = g2;
+		}
+		static inline void output(const float* x, const size_t xs, float* y, const size_t ys)
+		{
+			const float m0 = x[0], m1 = x[xs], m2 = x[2 * xs], m3 = x[3 * xs], m4 = x[4 * xs], m5 = x[5 * xs];
+			y[0] = m0 + m1 + m2 + m3 + m4;
+			y[ys] = m1 - m2 + 2.0f*(m3 - m4);
+			y[2 * ys] = m1 + m2 + 4.0f*(m3 + m4);
+			y[3 * ys] = m1 - m2 + 8.0f*(m3 - m4) + m5;
+		}
+	};
+
+	//tiles transformed and multiplied together : their transformed input and products stay in l2
+	static const size_t WINOGRAD_BLOCK_BYTES = 1024 * 1024;
+	static size_t winograd_tile_block(const size_t t, const size_t inputChannels, const size_t outputChannels, const size_t tiles)
+	{
+		const size_t block = WINOGRAD_BLOCK_BYTES / (t*t*(inputChannels + outputChannels)*sizeof(float));
+		//some columns for gemm at least
+		return std::min(tiles, std::max<size_t>(16, block / 16 * 16));
+	}
+	static size_t winograd_workspace_size(const size_t t, const size_t inputChannels, const size_t outputChannels, const size_t block)
+	{
+		return sgemm_workspace_size(outputChannels, block, inputChannels) + t*t*(inputChannels + outputChannels)*block*sizeof(float);
+	}
+
+	//u(t*t,kn,ic) : (G g G^T) of every kernel
+	template<typename W>
+	static void winograd_transform_kernel(const TensorView& kernel, float* transformed)
+	{
+		const size_t kn = kernel.getSize().number;
+		const size_t ic = kernel.getSize().channels;
+		for (size_t o = 0; o < kn; o++)
+		{
+			for (size_t c = 0; c < ic; c++)
+			{
+				const float* g = kernel.getData() + kernel.getIndex(o, c, 0, 0);
+				float columns[W::T][3];
+				float u[W::T][W::T];
+				for (size_t x = 0; x < 3; x++)
+				{
+					W::kernel(g + x, 3, &columns[0][x], 3);
+				}
+				for (size_t y = 0; y < W::T; y++)
+				{
+					W::kernel(columns[y], 1, u[y], 1);
+				}
+				for (size_t xi = 0; xi < W::T*W::T; xi++)
+				{
+					transformed[(xi*kn + o)*ic + c] = u[xi / W::T][xi % W::T];
+				}
+			}
+		}
+	}
+	//output rows [rowStart,rowStop) of every sample
+	template<typename W>
+	static void convolution2d_winograd(const TensorView& input, const float* transformedKernel, const float* bias,
+		const TensorView& output, const int mode, const size_t rowStart, const size_t rowStop)
+	{
+		const size_t T = W::T;
+		const size_t M = W::M;
+		const DataSize inputSize = input.getSize();
+		const DataSize outputSize = output.getSize();
+		const size_t ic = inputSize.channels;
+		const size_t oc = outputSize.channels;
+		const int pad = (mode == 1) ? 1 : 0;
+		const size_t tileCols = (outputSize.width + M - 1) / M;
+		const size_t firstTileRow = rowStart / M;
+		const size_t tiles = ((rowStop + M - 1) / M - firstTileRow)*tileCols;
+		const size_t block = winograd_tile_block(T, ic, oc, tiles);
+		const size_t gemmBytes = sgemm_workspace_size(oc, block, ic);
+		//taken once at full size, sgemm finds it big enough and doesn't move it
+		float* const transformedInput = get_workspace(winograd_workspace_size(T, ic, oc, block)) + gemmBytes / sizeof(float);
+		float* const products = transformedInput + T*T*ic*block;
+		for (size_t nn = 0; nn < inputSize.number; nn++)
+		{
+			const float* inputData = input.getSampleData(nn);
+			float* outputData = output.getSampleData(nn);
+			for (size_t tileStart = 0; tileStart < tiles; tileStart += block)
+			{
+				const size_t count = std::min(block, tiles - tileStart);
+				//B^T d B of every tile and channel, as (t*t,ic,count)
+				for (size_t c = 0; c < ic; c++)
+				{
+					const float* channel = inputData + c*input.channelStride;
+					for (size_t b = 0; b < count; b++)
+					{
+						const size_t tile = tileStart + b;
+						const int iy0 = (int)((firstTileRow + tile / tileCols)*M) - pad;
+						const int ix0 = (int)((tile % tileCols)*M) - pad;
+						float d[T][T];
+						if (iy0 >= 0 && ix0 >= 0 && iy0 + (int)T <= (int)inputSize.height && ix0 + (int)T <= (int)inputSize.width)
+						{
+							for (size_t y = 0; y < T; y++)
+							{
+								std::copy(channel + (iy0 + y)*inputSize.width + ix0, channel + (iy0 + y)*inputSize.width + ix0 + T, d[y]);
+							}
+						}
+						else
+						{
+							//border tile, outside of input is 0
+							for (size_t y = 0; y < T; y++)
+							{
+								const int iy = iy0 + (int)y;
+								for (size_t x = 0; x < T; x++)
+								{
+									const int ix = ix0 + (int)x;
+									d[y][x] = (iy >= 0 && iy < (int)inputSize.height && ix >= 0 && ix < (int)inputSize.width) ?
+										channel[iy*inputSize.width + ix] : 0.0f;
+								}
+							}
+						}
+						float columns[T][T];
+						float v[T][T];
+						for (size_t x = 0; x < T; x++)
+						{
+							W::input(&d[0][x], T, &columns[0][x], T);
+						}
+						for (size_t y = 0; y < T; y++)
+						{
+							W::input(columns[y], 1, v[y], 1);
+						}
+						for (size_t xi = 0; xi < T*T; xi++)
+						{
+							transformedInput[(xi*ic + c)*count + b] = v[xi / T][xi % T];
+						}
+					}
+				}
+				//one gemm per position of tile : (kn,ic) * (ic,count)
+				for (size_t xi = 0; xi < T*T; xi++)
+				{
+					sgemm(false, false, oc, count, ic, 1.0f, transformedKernel + xi*oc*ic, ic,
+						transformedInput + xi*ic*count, count, 0.0f, products + xi*oc*count, count);
+				}
+				//A^T m A of every tile and output channel, outputs beyond size are dropped
+				for (size_t o = 0; o < oc; o++)
+				{
+					float* channel = outputData + o*output.channelStride;
+					const float biasValue = bias ? bias[o] : 0.0f;
+					for (size_t b = 0; b < count; b++)
+					{
+						const size_t tile = tileStart + b;
+						const size_t oy0 = (firstTileRow + tile / tileCols)*M;
+						const size_t ox0 = (tile % tileCols)*M;
+						float m[T][T];
+						for (size_t xi = 0; xi < T*T; xi++)
+						{
+							m[xi / T][xi % T] = products[(xi*oc + o)*count + b];
+						}
+						float columns[M][T];
+						float y[M][M];
+						for (size_t x = 0; x < T; x++)
+						{
+							W::output(&m[0][x], T, &columns[0][x], T);
+						}
+						for (size_t r = 0; r < M; r++)
+						{
+							W::output(columns[r], 1, y[r], 1);
+						}
+						const size_t rows = std::min(M, rowStop - oy0);
+						const size_t cols = std::min(M, outputSize.width - ox0);
+						for (size_t r = 0; r < rows; r++)
+						{
+							for (size_t x = 0; x < cols; x++)
+							{
+								channel[(oy0 + r)*outputSize.width + ox0 + x] = y[r][x] + biasValue;
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	size_t winograd_kernel_size(const size_t m, const DataSize& kernelSize)
+	{
+		easyAssert(m == 2 || m == 4, "winograd tile must be 2 or 4.");
+		return (m + 2)*(m + 2)*kernelSize.number*kernelSize.channels;
+	}
+	void winograd_transform_kernel(const size_t m, const TensorView& kernel, float* transformedKernel)
+	{
+		easyAssert(kernel.getSize().width == 3 && kernel.getSize().height == 3, "winograd kernel must be 3x3.");
+		easyAssert(kernel.isSampleDense(), "every kernel must be dense.");
+		easyAssert(m == 2 || m == 4, "winograd tile must be 2 or 4.");
+		if (m == 2)
+		{
+			winograd_transform_kernel<Winograd2x2>(kernel, transformedKernel);
+		}
+		else
+		{
+			winograd_transform_kernel<Winograd4x4>(kernel, transformedKernel);
+		}
+	}
+	void convolution2d_winograd(const size_t m, const TensorView& input, const float* transformedKernel, const float* bias,
+		const TensorView& output, const int mode, const size_t rowStart, const size_t rowStop)
+	{
+		const DataSize inputSize = input.getSize();
+		const DataSize outputSize = output.getSize();
+		easyAssert(inputSize.number == outputSize.number, "number of input and output must be equal.");
+		easyAssert(m == 2 || m == 4, "winograd tile must be 2 or 4.");
+		easyAssert(rowStart <= rowStop && rowStop <= outputSize.height && rowStart % m == 0, "rows are out of output or tiles.");
+		easyAssert(input.isSampleDense() && output.isSampleDense(), "every sample must be dense.");
+		easyAssert((mode == 1) ? (outputSize.height == inputSize.height && outputSize.width == inputSize.width) :
+			(outputSize.height + 2 == inputSize.height && outputSize.width + 2 == inputSize.width), "output size of 3x3 kernel is invalidate.");
+		if (rowStart == rowStop)
+		{
+			return;
+		}
+		if (m == 2)
+		{
+			convolution2d_winograd<Winograd2x2>(input, transformedKernel, bias, output, mode, rowStart, rowStop);
+		}
+		else
+		{
+			convolution2d_winograd<Winograd4x4>(input, transformedKernel, bias, output, mode, rowStart, rowStop);
+		}
+	}
+	size_t convolution2d_winograd_workspace_size(const size_t m, const DataSize& inputSize, const DataSize& outputSize)
+	{
+		//a range has all rows of a sample at most
+		const size_t t = m + 2;
+		const size_t tiles = ((outputSize.height + m - 1) / m)*((outputSize.width + m - 1) / m);
+		const size_t block = winograd_tile_block(t, inputSize.channels, outputSize.channels, tiles);
+		return winograd_workspace_size(t, inputSize.channels, outputSize.channels, block);
+	}
+}//namespace
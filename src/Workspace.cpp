@@ -0,0 +1,61 @@
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include "EasyCNN/Workspace.h"
+#include "EasyCNN/MemoryPool.h"
+#include "EasyCNN/EasyLogger.h"
+
+namespace EasyCNN
+{
+	static std::atomic<size_t> reservedWorkspaceSize(0);
+	struct ThreadWorkspace
+	{
+		std::shared_ptr<float> data;
+		size_t bytes = 0;
+	};
+	static ThreadWorkspace& thread_workspace()
+	{
+		static thread_local ThreadWorkspace workspace;
+		return workspace;
+	}
+	static void grow_workspace(ThreadWorkspace& workspace, const size_t bytes)
+	{
+		if (bytes <= workspace.bytes)
+		{
+			return;
+		}
+		workspace.data.reset();
+		workspace.data = make_pooled_buffer(MemoryPool::defaultPool(), (bytes + sizeof(float) - 1) / sizeof(float));
+		workspace.bytes = bytes;
+	}
+
+	void reserve_workspace(const size_t bytes)
+	{
+		size_t current = reservedWorkspaceSize.load();
+		while (current < bytes && !reservedWorkspaceSize.compare_exchange_weak(current, bytes))
+		{
+			//retry
+		}
+		//caller runs kernels too
+		prepare_workspace();
+	}
+	size_t get_workspace_size()
+	{
+		return reservedWorkspaceSize.load();
+	}
+	void prepare_workspace()
+	{
+		grow_workspace(thread_workspace(), reservedWorkspaceSize.load());
+	}
+	float* get_workspace(const size_t bytes)
+	{
+		ThreadWorkspace& workspace = thread_workspace();
+		if (bytes > workspace.bytes)
+		{
+			//layer didn't report its scratch
+			logVerbose("workspace grows in kernel : %d bytes.", (int)bytes);
+			grow_workspace(workspace, std::max(bytes, reservedWorkspaceSize.load()));
+		}
+		return workspace.data.get();
+	}
+}//namespace